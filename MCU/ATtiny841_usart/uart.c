@@ -391,6 +391,11 @@ static volatile unsigned char UART1_LastRxError;
 
 
 
+void __attribute__((weak)) uart_rx_hook(void)
+{
+}/* uart_rx_hook */
+
+
 ISR (UART0_RECEIVE_INTERRUPT)	
 /*************************************************************************
 Function: UART Receive Complete interrupt
@@ -429,6 +434,9 @@ Purpose:  called when the UART has received a character
         UART_RxHead = tmphead;
         /* store received data in buffer */
         UART_RxBuf[tmphead] = data;
+
+        /* once for every byte uart_getc() will return */
+        uart_rx_hook();
     }
     UART_LastRxError |= lastRxError;   
 }
@@ -146,6 +146,19 @@ extern void uart_init(unsigned int baudrate);
 extern unsigned int uart_getc(void);
 
 
+/**
+ *  @brief   Called from the receive interrupt for every byte stored in the ringbuffer
+ *
+ *  Empty weak default, define your own uart_rx_hook() to react to incoming
+ *  bytes before uart_getc() takes them from the ringbuffer (e.g. to restart
+ *  an inter-byte timeout). A byte lost to a buffer overflow is not reported.
+ *  Runs in interrupt context, keep it short.
+ *
+ *  @return  none
+ */
+extern void uart_rx_hook(void);
+
+
 /**
  *  @brief   Put byte to ringbuffer for transmitting via UART
  *  @param   data byte to be transmitted
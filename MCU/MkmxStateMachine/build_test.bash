@@ -1 +1,2 @@
-gcc -o test.out mkmx_state_machine.c test.c
+gcc -o test.out mkmx_state_machine.c crc8_ccitt.c test.c
+gcc -DMKMX_INLINE_CRC -o test_inline_crc.out mkmx_state_machine.c crc8_ccitt.c test.c
@@ -0,0 +1,13 @@
+#ifndef CRC8_CCITT_H_INCLUDED
+#define CRC8_CCITT_H_INCLUDED
+
+#include <stdint.h>
+
+// table driven CRC8-CCITT (poly 0x07, init 0x00), same results as _crc8_ccitt_update
+// from avr-libc <util/crc16.h> and from utils/crctools on the PC side
+// on AVR the table is kept in flash (PROGMEM), elsewhere it is a plain const array
+
+uint8_t crc8_ccitt_update(uint8_t inCrc, uint8_t inData);
+uint8_t crc8_ccitt_block(uint8_t inCrc, const uint8_t *data, uint16_t len);
+
+#endif // CRC8_CCITT_H_INCLUDED
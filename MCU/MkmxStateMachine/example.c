@@ -1,19 +1,34 @@
 // przyklad uzycia
 #include <util/crc16.h>
 #include "uart.h"
+#include <avr/interrupt.h>
 #include "mkmx_state_machine.h"
 
+// opcjonalnie: przerwanie timera mniej wiecej co czas jednego znaku (konfiguracja timera pominieta)
+// niedokonczona ramka jest porzucana, gdy przez 3 takie przerwania nie przyjdzie zaden bajt
+ISR(TIMER0_COMPA_vect){
+    MkmxTick();
+}
+
+// wywolywane przez biblioteke uart z przerwania odbiornika dla kazdego bajtu,
+// bajty czekajace w buforze uart_getc() nie sa wiec liczone jako cisza na linii
+void uart_rx_hook(void){
+    MkmxByteArrived();
+}
+
 int main(void){
 	
 	// inicjalizuje maszyne stanow na odbior ramek o adresie 0x42
     MkmxInit(0x42, _crc8_ccitt_update);
+    MkmxSetTimeout(3);
 
     while(1){
 		// pobiera bajt
         uint16_t tmp = uart_getc();
 		
-		// sprawdza bajt i wrzuca go do maszyny
-        if ((tmp & 0xFF00) == 0) MkmxUpdate((uint8_t) tmp);
+		// wrzuca bajt do maszyny, takze bajt z bledem (ramke odrzuci CRC):
+		// maszyna musi dostac kazdy bajt policzony przez MkmxByteArrived()
+        if (!(tmp & UART_NO_DATA)) MkmxUpdate((uint8_t) tmp);
 		
 		// sprawdza czy odebrano nowa ramke
         if(MkmxIsReady()){
@@ -1,101 +1,178 @@
 #include "mkmx_state_machine.h"
+
+// the CRC is folded in byte by byte, either through crcFunction or called directly
+#ifdef MKMX_INLINE_CRC
+    #ifndef MKMX_CRC_UPDATE
+        #ifdef __AVR__
+            #include <util/crc16.h>
+            #define MKMX_CRC_UPDATE(crc, data)  _crc8_ccitt_update((crc), (data))
+        #else
+            #include "crc8_ccitt.h"
+            #define MKMX_CRC_UPDATE(crc, data)  crc8_ccitt_update((crc), (data))
+        #endif
+    #endif
+    #define MKMX_CRC(m, crc, data)  MKMX_CRC_UPDATE((crc), (data))
+#else
+    #define MKMX_CRC(m, crc, data)  ((m)->crcFunction((crc), (data)))
+#endif
+
 static MkmxMachine_t MkmxMachine;
+MkmxFrame_t MkmxFrame;
 
-void MkmxInit(uint8_t address, uint8_t(*_crc)(uint8_t, uint8_t)){
+void MkmxMachineInit(MkmxMachine_t *m, MkmxFrame_t *frame, uint8_t address, uint8_t(*_crc)(uint8_t, uint8_t)){
     // all fields are initialised to provide platform for automated testing
-    MkmxMachine.state = MKMX_IDLE;
-    MkmxMachine.deviceAddress = address;
-    MkmxMachine.command = 0;
-    MkmxMachine.payloadLength = 0;
-    MkmxMachine.payloadPosition = 0;
-    MkmxMachine.crc_received = 0;
-    MkmxMachine.crcFunction = _crc;
-    MkmxMachine.isFrameReady = 0;
+    m->state = MKMX_IDLE;
+    m->deviceAddress = address;
+    m->command = 0;
+    m->payloadLength = 0;
+    m->payloadPosition = 0;
+    m->crc_received = 0;
+    m->crc_calculated = 0;
+    m->crcFunction = _crc;
+    m->isFrameReady = 0;
+    m->frame = frame;
+    m->timeoutTicks = 0;
+    m->updateCount = 0;
+    m->silentTicks = 0;
+    m->timedOut = 0;
+    m->timeoutMark = 0;
+    m->rxCount = 0;
+    m->rxCounted = 0;
 
     for(uint8_t i=0; i<MKMX_MAX_INPUT_PAYLOAD_SIZE; ++i){
-        MkmxMachine.payload[i]=0;
+        m->payload[i]=0;
     }
 }
-MkmxState_t MkmxUpdate(uint8_t _rx){
-    uint8_t checksum;
-    switch(MkmxMachine.state){
+MkmxState_t MkmxMachineUpdate(MkmxMachine_t *m, uint8_t _rx){
+    // at most one CRC update per byte, the CRC byte only compares; the payload is copied to the frame once accepted
+    // without MkmxMachineByteArrived() taking a byte restarts the count, before looking at the flag,
+    // so a tick in between starts a new interval
+    if(!m->rxCounted) m->silentTicks = 0;
+    ++m->updateCount;
+    // bytes up to the mark came before the silence, the first one after it abandons the frame
+    if(m->timedOut && (int8_t)(m->updateCount - m->timeoutMark) > 0){
+        m->timedOut = 0;
+                                m->state = MKMX_IDLE;
+    }
+    switch(m->state){
         case MKMX_IDLE:
-            if(_rx == 0x5A)     MkmxMachine.state = MKMX_SOF1;
-            else                MkmxMachine.state = MKMX_IDLE;
+            if(_rx == 0x5A)     m->state = MKMX_SOF1;
+            else                m->state = MKMX_IDLE;
             break;
         case MKMX_SOF1:
-            if(_rx == 0xA5)     MkmxMachine.state = MKMX_SOF2;
-            else                MkmxMachine.state = MKMX_IDLE;
+            if(_rx == 0xA5)     m->state = MKMX_SOF2;
+            else                m->state = MKMX_IDLE;
             break;
         case MKMX_SOF2:
-            if(_rx == MkmxMachine.deviceAddress)  MkmxMachine.state = MKMX_ADDR;
-            else                MkmxMachine.state = MKMX_XADDR;
+            if(_rx == m->deviceAddress){
+                m->crc_calculated = MKMX_CRC(m, 0, _rx);
+                                m->state = MKMX_ADDR;
+            }
+            else                m->state = MKMX_XADDR;
             break;
         case MKMX_ADDR:
-            MkmxMachine.command = _rx;
-                                MkmxMachine.state = MKMX_CMD;
+            m->command = _rx;
+            m->crc_calculated = MKMX_CRC(m, m->crc_calculated, _rx);
+                                m->state = MKMX_CMD;
             break;
         case MKMX_CMD:
-            MkmxMachine.payloadPosition = 0;
-            MkmxMachine.payloadLength = _rx;
-            if(MkmxMachine.payloadLength == 0)
-                                MkmxMachine.state = MKMX_PLCPL;
-            if(MkmxMachine.payloadLength > MKMX_MAX_INPUT_PAYLOAD_SIZE)
-                MkmxMachine.payloadLength = MKMX_MAX_INPUT_PAYLOAD_SIZE;
-                                MkmxMachine.state = MKMX_PLRX;
+            m->payloadPosition = 0;
+            m->payloadLength = _rx;
+            m->crc_calculated = MKMX_CRC(m, m->crc_calculated, _rx);
+            if(m->payloadLength == 0)
+                                m->state = MKMX_PLCPL;
+            else if(m->payloadLength > MKMX_MAX_INPUT_PAYLOAD_SIZE)
+                                m->state = MKMX_XPLRX;  // can not be accepted, skip it whole
+            else                m->state = MKMX_PLRX;
             break;
         case MKMX_PLRX:
-            MkmxMachine.payload[MkmxMachine.payloadPosition++] = _rx;
-            if(MkmxMachine.payloadPosition >= MkmxMachine.payloadLength)
-                                MkmxMachine.state = MKMX_PLCPL;
+            m->payload[m->payloadPosition++] = _rx;
+            m->crc_calculated = MKMX_CRC(m, m->crc_calculated, _rx);
+            if(m->payloadPosition >= m->payloadLength)
+                                m->state = MKMX_PLCPL;
             break;
         case MKMX_PLCPL:
-            // calculate checksum
-            checksum = 0;
-            checksum = MkmxMachine.crcFunction(checksum, MkmxMachine.deviceAddress);
-            checksum = MkmxMachine.crcFunction(checksum, MkmxMachine.command);
-            checksum = MkmxMachine.crcFunction(checksum, MkmxMachine.payloadLength);
-            for(uint8_t i=0; i<MkmxMachine.payloadLength; ++i){
-                checksum = MkmxMachine.crcFunction(checksum, MkmxMachine.payload[i]);
-            }
-            if(checksum == _rx && MkmxMachine.isFrameReady == 0){
+            m->crc_received = _rx;
+            if(m->crc_calculated == _rx && m->isFrameReady == 0){
                 // checksum valid, buffer empty
-                MkmxFrame.command = MkmxMachine.command;
-                MkmxFrame.payloadLength = MkmxMachine.payloadLength;
-                for(uint8_t i=0; i<MkmxMachine.payloadLength; ++i){
-                    MkmxFrame.payload[i] = MkmxMachine.payload[i];
+                m->frame->command = m->command;
+                m->frame->payloadLength = m->payloadLength;
+                for(uint8_t i=0; i<m->payloadLength; ++i){
+                    m->frame->payload[i] = m->payload[i];
                 }
-                MkmxMachine.isFrameReady = 1;
+                m->isFrameReady = 1;
             }
-                                MkmxMachine.state = MKMX_IDLE;
+                                m->state = MKMX_IDLE;
             break;
         case MKMX_XADDR:
-                                MkmxMachine.state = MKMX_XCMD;
+                                m->state = MKMX_XCMD;
             break;
         case MKMX_XCMD:
-            MkmxMachine.payloadPosition = 0;
-            MkmxMachine.payloadLength = _rx;
-            if(MkmxMachine.payloadLength == 0)
-                                MkmxMachine.state = MKMX_XPLCPL;
-            else                MkmxMachine.state = MKMX_XPLRX;
+            m->payloadPosition = 0;
+            m->payloadLength = _rx;
+            if(m->payloadLength == 0)
+                                m->state = MKMX_XPLCPL;
+            else                m->state = MKMX_XPLRX;
             break;
         case MKMX_XPLRX:
-            ++MkmxMachine.payloadPosition;
-            if(MkmxMachine.payloadPosition >= MkmxMachine.payloadLength)
-                                MkmxMachine.state = MKMX_XPLCPL;
+            ++m->payloadPosition;
+            if(m->payloadPosition >= m->payloadLength)
+                                m->state = MKMX_XPLCPL;
             break;
         case MKMX_XPLCPL:
-                                MkmxMachine.state = MKMX_IDLE;
+                                m->state = MKMX_IDLE;
             break;
         default:
             // this place is nver reached
             break;
     }
-    return MkmxMachine.state;
+    return m->state;
+}
+uint8_t MkmxMachineIsReady(const MkmxMachine_t *m){
+    return m->isFrameReady;
+}
+void MkmxMachineDiscardFrame(MkmxMachine_t *m){
+    m->isFrameReady = 0;
+}
+void MkmxMachineSetTimeout(MkmxMachine_t *m, uint8_t ticks){
+    m->timeoutTicks = ticks;
+    m->silentTicks = 0;
+    m->timedOut = 0;
+}
+void MkmxMachineTick(MkmxMachine_t *m){
+    // called from an ISR: only counts and raises the flag, the state belongs to MkmxMachineUpdate()
+    if(m->timeoutTicks != 0 && m->silentTicks < m->timeoutTicks){
+        if(++m->silentTicks >= m->timeoutTicks){
+            m->timeoutMark = m->rxCounted ? m->rxCount : m->updateCount;
+            m->timedOut = 1;
+        }
+    }
+}
+void MkmxMachineByteArrived(MkmxMachine_t *m){
+    m->silentTicks = 0;
+    ++m->rxCount;
+    m->rxCounted = 1;
+}
+
+// single device API, one machine writing to MkmxFrame
+void MkmxInit(uint8_t address, uint8_t(*_crc)(uint8_t, uint8_t)){
+    MkmxMachineInit(&MkmxMachine, &MkmxFrame, address, _crc);
+}
+MkmxState_t MkmxUpdate(uint8_t _rx){
+    return MkmxMachineUpdate(&MkmxMachine, _rx);
 }
 uint8_t MkmxIsReady(void){
-    return MkmxMachine.isFrameReady;
+    return MkmxMachineIsReady(&MkmxMachine);
 }
 void MkmxDiscardFrame(void){
-    MkmxMachine.isFrameReady = 0;
+    MkmxMachineDiscardFrame(&MkmxMachine);
+}
+void MkmxSetTimeout(uint8_t ticks){
+    MkmxMachineSetTimeout(&MkmxMachine, ticks);
+}
+void MkmxTick(void){
+    MkmxMachineTick(&MkmxMachine);
+}
+void MkmxByteArrived(void){
+    MkmxMachineByteArrived(&MkmxMachine);
 }
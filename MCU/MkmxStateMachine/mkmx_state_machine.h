@@ -5,8 +5,13 @@
 
 // maximum size of payload hat can be accepted by the state machine
 // applicable for *this address* only, other payloads can be 255 bytes long
+// (longer frames for this address are skipped like frames for other addresses)
 #define MKMX_MAX_INPUT_PAYLOAD_SIZE     32
 
+// Define MKMX_INLINE_CRC (e.g. -DMKMX_INLINE_CRC) to call the CRC update directly instead of through
+// the function pointer given to MkmxInit(): _crc8_ccitt_update() from <util/crc16.h> on AVR,
+// crc8_ccitt_update() elsewhere, or your own MKMX_CRC_UPDATE(crc, data) macro.
+
 // possible states
 typedef enum {  MKMX_IDLE,   // wait for SOF1
                 MKMX_SOF1,   // acquired SOF1 = 0x5A
@@ -21,6 +26,13 @@ typedef enum {  MKMX_IDLE,   // wait for SOF1
                 MKMX_PLCPL,  // payload acquisition complete, awaiting crc
                 } MkmxState_t;
 
+// communication with user
+typedef struct {
+    uint8_t command;
+    uint8_t payloadLength;
+    uint8_t payload[MKMX_MAX_INPUT_PAYLOAD_SIZE];
+} MkmxFrame_t;
+
 // internal data exchange of the state machine
 typedef struct {
     MkmxState_t state;
@@ -30,20 +42,48 @@ typedef struct {
     uint8_t payloadPosition;
     uint8_t payload[MKMX_MAX_INPUT_PAYLOAD_SIZE];
     uint8_t crc_received;
-    uint8_t (*crcFunction)(uint8_t, uint8_t);
+    uint8_t crc_calculated; // over address, command, length and payload received so far
+    uint8_t (*crcFunction)(uint8_t, uint8_t);   // not used with MKMX_INLINE_CRC
     uint8_t isFrameReady;
+    MkmxFrame_t *frame;     // accepted frames are copied here
+    uint8_t timeoutTicks;   // silent ticks that abort a frame, 0 = never
+    // shared with interrupts: single bytes, so every access is atomic on AVR
+    volatile uint8_t updateCount;   // bytes taken by MkmxMachineUpdate(), wraps
+    volatile uint8_t silentTicks;   // ticks since the last byte
+    volatile uint8_t timedOut;      // set by the tick, the update of the first byte after timeoutMark abandons the frame
+    volatile uint8_t timeoutMark;   // byte count when the silence was detected
+    volatile uint8_t rxCount;       // bytes seen by MkmxMachineByteArrived(), wraps
+    volatile uint8_t rxCounted;     // MkmxMachineByteArrived() is in use
 
 } MkmxMachine_t;
 
-// communication with user
-struct {
-    uint8_t command;
-    uint8_t payloadLength;
-    uint8_t payload[MKMX_MAX_INPUT_PAYLOAD_SIZE];
-} MkmxFrame;
+extern MkmxFrame_t MkmxFrame;
 
+// single device API (one static machine, frames delivered in MkmxFrame)
 void MkmxInit(uint8_t address, uint8_t(*_crc)(uint8_t, uint8_t));
 MkmxState_t MkmxUpdate(uint8_t _rx);
 uint8_t MkmxIsReady(void);
 void MkmxDiscardFrame(void);
+
+// optional inter-byte timeout: call MkmxTick() at a fixed period (e.g. from a timer ISR, about one
+// character time) and MkmxByteArrived() from the UART receive ISR (e.g. from uart_rx_hook()).
+// After `ticks` ticks without a byte the tick only raises a flag and notes how many bytes came so far,
+// the state is touched by MkmxUpdate() alone: the first byte received after the silence starts from SOF
+// and a partly received frame is abandoned. Bytes received before the silence but still waiting in
+// a software buffer are taken as usual, so a complete frame in the buffer is not lost.
+// With MkmxByteArrived() every received byte has to reach MkmxUpdate() (also bytes with a UART error)
+// and at most 127 bytes may wait in the buffer. Without it the count restarts only when MkmxUpdate()
+// takes a byte, so bytes waiting in a software buffer count as silence.
+void MkmxSetTimeout(uint8_t ticks);
+void MkmxTick(void);
+void MkmxByteArrived(void);
+
+// instance API, for several devices in one program (e.g. the host side slave farm)
+void MkmxMachineInit(MkmxMachine_t *m, MkmxFrame_t *frame, uint8_t address, uint8_t(*_crc)(uint8_t, uint8_t));
+MkmxState_t MkmxMachineUpdate(MkmxMachine_t *m, uint8_t _rx);
+uint8_t MkmxMachineIsReady(const MkmxMachine_t *m);
+void MkmxMachineDiscardFrame(MkmxMachine_t *m);
+void MkmxMachineSetTimeout(MkmxMachine_t *m, uint8_t ticks);
+void MkmxMachineTick(MkmxMachine_t *m);
+void MkmxMachineByteArrived(MkmxMachine_t *m);
 #endif // MKMXSTATEMACHINE_H_INCLUDED
@@ -0,0 +1,2 @@
+gcc -O2 -Wall -o mkmx_sim.out mkmx_sim.c uart_pty.c ../mkmx_state_machine.c ../crc8_ccitt.c
+gcc -O2 -Wall -o mkmx_farm.out mkmx_farm.c uart_pty.c ../mkmx_state_machine.c ../crc8_ccitt.c
@@ -0,0 +1,279 @@
+// Virtual slave farm: up to 255 independent MKMX state machines on one simulated RS485 bus behind a pty.
+// Every byte written by the master reaches all slaves, the addressed one answers after its own latency.
+// The bus is modelled half-duplex: an answer starts no earlier than the end of the request plus the
+// slave latency and the driver turnaround, and never while another transmission holds the bus.
+// On exit the farm reports request rate, bus utilisation and master bytes sent while a slave was talking.
+//
+// usage: mkmx_farm [-n slaves] [-f first_address] [-l latency_us] [-j jitter_us] [-b baudrate] [-t turnaround_us] [-v]
+//   -n  number of slaves, default 16 (1..255)
+//   -f  address of the first slave, the others follow, default 0x01
+//   -l  base answer latency of every slave in microseconds, default 0
+//   -j  extra latency per slave, fixed pseudo-random value 0..jitter_us, default 0
+//   -b  bus baud rate, default 0 = no wire time (utilisation is not reported)
+//   -t  RS485 driver turnaround in microseconds, default 2 bit times
+//   -v  print per-slave counters on exit
+//
+// commands understood by every slave:
+//   0x00 ping   answers an empty payload
+//   0x01 read   answers payload[0] bytes of the slave registers
+//   0x02 write  stores the payload in the registers, answers an empty payload
+//   others      echoed back
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uart.h"
+#include "../mkmx_state_machine.h"
+#include "../crc8_ccitt.h"
+
+#define FARM_MAX_SLAVES     255
+#define FARM_COMMANDS       16
+#define FARM_NO_ANSWER      (-1)
+
+#define FARM_CMD_PING       0x00
+#define FARM_CMD_READ       0x01
+#define FARM_CMD_WRITE      0x02
+
+typedef struct FarmSlave FarmSlave_t;
+
+// fills the answer payload, returns its length or FARM_NO_ANSWER
+typedef int (*FarmHandler_t)(FarmSlave_t *slave, const MkmxFrame_t *request, uint8_t *answer);
+
+struct FarmSlave {
+    MkmxMachine_t machine;
+    MkmxFrame_t frame;
+    uint8_t address;
+    uint32_t latencyUs;
+    FarmHandler_t handlers[FARM_COMMANDS];  // by command, commands above use defaultHandler
+    FarmHandler_t defaultHandler;
+    uint8_t registers[MKMX_MAX_INPUT_PAYLOAD_SIZE];
+    uint32_t requests;
+    uint32_t answers;
+};
+
+typedef struct {
+    uint64_t byteNs;            // wire time of one byte, 8N1
+    uint64_t turnaroundNs;
+    uint64_t masterEndNs;       // end of the last master byte on the bus
+    uint64_t slaveEndNs;        // end of the last slave answer (driver still enabled)
+    uint64_t busFreeNs;         // slave driver released
+    uint64_t dataNs;            // bus time carrying bytes
+    uint64_t turnaroundTotalNs;
+    uint32_t collisions;        // master bytes put on the bus while a slave was transmitting
+} FarmBus_t;
+
+static FarmSlave_t farmSlaves[FARM_MAX_SLAVES];
+static uint16_t farmSlavesCount;
+static FarmBus_t farmBus;
+
+static volatile sig_atomic_t farmRunning = 1;
+
+static void farmStop(int sig){
+    (void)sig;
+    farmRunning = 0;
+}
+
+static uint64_t farmNowNs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void farmSleepUntil(uint64_t ns){
+    struct timespec ts = { (time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull) };
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && farmRunning);
+}
+
+static int farmPing(FarmSlave_t *slave, const MkmxFrame_t *request, uint8_t *answer){
+    (void)slave; (void)request; (void)answer;
+    return 0;
+}
+
+static int farmRead(FarmSlave_t *slave, const MkmxFrame_t *request, uint8_t *answer){
+    uint8_t len = request->payloadLength ? request->payload[0] : 0;
+    if(len > MKMX_MAX_INPUT_PAYLOAD_SIZE) len = MKMX_MAX_INPUT_PAYLOAD_SIZE;
+    memcpy(answer, slave->registers, len);
+    return len;
+}
+
+static int farmWrite(FarmSlave_t *slave, const MkmxFrame_t *request, uint8_t *answer){
+    (void)answer;
+    memcpy(slave->registers, request->payload, request->payloadLength);
+    return 0;
+}
+
+static int farmEcho(FarmSlave_t *slave, const MkmxFrame_t *request, uint8_t *answer){
+    (void)slave;
+    memcpy(answer, request->payload, request->payloadLength);
+    return request->payloadLength;
+}
+
+static void farmAddSlave(uint8_t address, uint32_t latencyUs){
+    FarmSlave_t *slave = &farmSlaves[farmSlavesCount++];
+
+    memset(slave, 0, sizeof(*slave));
+    MkmxMachineInit(&slave->machine, &slave->frame, address, crc8_ccitt_update);
+    slave->address = address;
+    slave->latencyUs = latencyUs;
+    slave->handlers[FARM_CMD_PING] = farmPing;
+    slave->handlers[FARM_CMD_READ] = farmRead;
+    slave->handlers[FARM_CMD_WRITE] = farmWrite;
+    slave->defaultHandler = farmEcho;
+    for(uint8_t i=0; i<MKMX_MAX_INPUT_PAYLOAD_SIZE; ++i){
+        slave->registers[i] = (uint8_t)(address + i);
+    }
+}
+
+static void farmAnswer(FarmSlave_t *slave){
+    const MkmxFrame_t *request = &slave->frame;
+    FarmHandler_t handler = request->command < FARM_COMMANDS ? slave->handlers[request->command] : NULL;
+    uint8_t payload[MKMX_MAX_INPUT_PAYLOAD_SIZE];
+    int len;
+
+    ++slave->requests;
+    if(handler == NULL) handler = slave->defaultHandler;
+    len = handler(slave, request, payload);
+    if(len == FARM_NO_ANSWER) return;
+    ++slave->answers;
+
+    // half-duplex: wait for the request to end, the slave to react and the bus to be released
+    uint64_t startNs = farmBus.masterEndNs + (uint64_t)slave->latencyUs * 1000u + farmBus.turnaroundNs;
+    if(startNs < farmBus.busFreeNs) startNs = farmBus.busFreeNs;
+    farmSleepUntil(startNs);
+
+    uint8_t crc = 0;
+    crc = crc8_ccitt_update(crc, slave->address);
+    crc = crc8_ccitt_update(crc, request->command);
+    crc = crc8_ccitt_update(crc, (uint8_t)len);
+    crc = crc8_ccitt_block(crc, payload, (uint16_t)len);
+
+    uart_putc(0x5A);
+    uart_putc(0xA5);
+    uart_putc(slave->address);
+    uart_putc(request->command);
+    uart_putc((uint8_t)len);
+    for(int i=0; i<len; ++i){
+        uart_putc(payload[i]);
+    }
+    uart_putc(crc);
+    // with a baud rate set this also takes the wire time of the answer
+    uart_sim_flush();
+
+    uint64_t wireNs = (uint64_t)(len + 6) * farmBus.byteNs;
+    farmBus.slaveEndNs = startNs + wireNs;
+    farmBus.busFreeNs = farmBus.slaveEndNs + farmBus.turnaroundNs;
+    farmBus.dataNs += wireNs;
+    farmBus.turnaroundTotalNs += 2 * farmBus.turnaroundNs;
+}
+
+static void farmRx(uint8_t rx){
+    uint64_t arrivalNs = uart_sim_rx_time_ns();
+
+    if(arrivalNs < farmBus.masterEndNs) arrivalNs = farmBus.masterEndNs;
+    if(arrivalNs < farmBus.slaveEndNs) ++farmBus.collisions;
+    farmBus.masterEndNs = arrivalNs + farmBus.byteNs;
+    farmBus.dataNs += farmBus.byteNs;
+
+    for(uint16_t i=0; i<farmSlavesCount; ++i){
+        FarmSlave_t *slave = &farmSlaves[i];
+
+        MkmxMachineUpdate(&slave->machine, rx);
+        if(MkmxMachineIsReady(&slave->machine)){
+            farmAnswer(slave);
+            MkmxMachineDiscardFrame(&slave->machine);
+        }
+    }
+}
+
+int main(int argc, char *argv[]){
+    unsigned int count = 16;
+    unsigned int firstAddress = 0x01;
+    uint32_t latencyUs = 0;
+    uint32_t jitterUs = 0;
+    unsigned int baudrate = 0;
+    long turnaroundUs = -1;
+    int verbose = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:f:l:j:b:t:v")) != -1){
+        switch(opt){
+            case 'n': count = (unsigned int)strtoul(optarg, NULL, 0); break;
+            case 'f': firstAddress = (unsigned int)strtoul(optarg, NULL, 0); break;
+            case 'l': latencyUs = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'j': jitterUs = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'b': baudrate = (unsigned int)strtoul(optarg, NULL, 0); break;
+            case 't': turnaroundUs = strtol(optarg, NULL, 0); break;
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-n slaves] [-f first_address] [-l latency_us] [-j jitter_us] "
+                                "[-b baudrate] [-t turnaround_us] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(count == 0 || count > FARM_MAX_SLAVES || firstAddress + count - 1 > 0xFF){
+        fprintf(stderr, "mkmx_farm: slaves must fit in addresses 0x00..0xFF\n");
+        return 1;
+    }
+
+    // fixed seed, the same command line always gives the same timing
+    srand(1);
+    for(unsigned int i=0; i<count; ++i){
+        farmAddSlave((uint8_t)(firstAddress + i), latencyUs + (jitterUs ? (uint32_t)rand() % (jitterUs + 1) : 0));
+    }
+
+    farmBus.byteNs = baudrate ? 10ull * 1000000000ull / baudrate : 0;
+    farmBus.turnaroundNs = turnaroundUs >= 0 ? (uint64_t)turnaroundUs * 1000u : farmBus.byteNs / 5;
+
+    const char *ptyName = uart_sim_open();
+    if(ptyName == NULL){
+        perror("mkmx_farm: can't create pseudo-terminal");
+        return 1;
+    }
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = farmStop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    uart_init(baudrate);
+
+    printf("%s\n", ptyName);
+    fflush(stdout);
+    fprintf(stderr, "mkmx_farm: %u slaves at 0x%02X..0x%02X, latency %u+%u us, baudrate %u, turnaround %llu us\n",
+            count, firstAddress, firstAddress + count - 1, latencyUs, jitterUs, baudrate,
+            (unsigned long long)(farmBus.turnaroundNs / 1000u));
+
+    uint64_t startNs = farmNowNs();
+
+    while(farmRunning){
+        unsigned int tmp = uart_getc();
+        if(!(tmp & UART_NO_DATA)) farmRx((uint8_t)tmp);
+    }
+
+    uint64_t elapsedNs = farmNowNs() - startNs;
+    double seconds = (double)elapsedNs / 1e9;
+    uint32_t requests = 0, answers = 0;
+
+    for(uint16_t i=0; i<farmSlavesCount; ++i){
+        requests += farmSlaves[i].requests;
+        answers += farmSlaves[i].answers;
+        if(verbose){
+            fprintf(stderr, "  0x%02X latency %6u us requests %8u answers %8u\n", farmSlaves[i].address,
+                    farmSlaves[i].latencyUs, farmSlaves[i].requests, farmSlaves[i].answers);
+        }
+    }
+
+    fprintf(stderr, "mkmx_farm: %u requests, %u answers in %.3f s (%.1f requests/s), rx %u bytes, tx %u bytes\n",
+            requests, answers, seconds, seconds > 0 ? requests / seconds : 0.0, uart_sim_rx_bytes(), uart_sim_tx_bytes());
+    if(farmBus.byteNs != 0 && elapsedNs != 0){
+        fprintf(stderr, "mkmx_farm: bus utilisation %.1f %% data, %.1f %% turnaround, %u colliding master bytes\n",
+                100.0 * (double)farmBus.dataNs / (double)elapsedNs,
+                100.0 * (double)farmBus.turnaroundTotalNs / (double)elapsedNs, farmBus.collisions);
+    }
+    return 0;
+}
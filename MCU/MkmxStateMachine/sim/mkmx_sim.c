@@ -0,0 +1,130 @@
+// Host simulator of an MKMX slave: the real state machine fed from a pseudo-terminal.
+// Every frame addressed to the device is answered with the same command and payload
+// after the configured latency, so MKMX_TestApp can be measured end to end without hardware.
+//
+// usage: mkmx_sim [-a address] [-l latency_us] [-b baudrate] [-t timeout_ms] [-q]
+//   -a  device address, default 0x42
+//   -l  delay between the CRC byte and the answer in microseconds, default 0
+//   -b  emulate the wire time of the answer at this baud rate, default 0 (full speed)
+//   -t  abandon a partial frame after this many milliseconds without a byte (MkmxTick), default 0 (never)
+//   -q  do not answer, only count frames
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uart.h"
+#include "../mkmx_state_machine.h"
+#include "../crc8_ccitt.h"
+
+static volatile sig_atomic_t simRunning = 1;
+
+static void simStop(int sig){
+    (void)sig;
+    simRunning = 0;
+}
+
+static uint64_t simNowNs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void simSleepUs(uint32_t us){
+    struct timespec ts = { (time_t)(us / 1000000u), (long)(us % 1000000u) * 1000l };
+    while(nanosleep(&ts, &ts) != 0 && errno == EINTR && simRunning);
+}
+
+static void simAnswer(uint8_t address, const MkmxFrame_t *frame){
+    uint8_t crc = 0;
+    crc = crc8_ccitt_update(crc, address);
+    crc = crc8_ccitt_update(crc, frame->command);
+    crc = crc8_ccitt_update(crc, frame->payloadLength);
+    crc = crc8_ccitt_block(crc, frame->payload, frame->payloadLength);
+
+    uart_putc(0x5A);
+    uart_putc(0xA5);
+    uart_putc(address);
+    uart_putc(frame->command);
+    uart_putc(frame->payloadLength);
+    for(uint8_t i=0; i<frame->payloadLength; ++i){
+        uart_putc(frame->payload[i]);
+    }
+    uart_putc(crc);
+    uart_sim_flush();
+}
+
+int main(int argc, char *argv[]){
+    uint8_t address = 0x42;
+    uint32_t latencyUs = 0;
+    unsigned int baudrate = 0;
+    int timeoutMs = 0;
+    int quiet = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "a:l:b:t:q")) != -1){
+        switch(opt){
+            case 'a': address = (uint8_t)strtoul(optarg, NULL, 0); break;
+            case 'l': latencyUs = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'b': baudrate = (unsigned int)strtoul(optarg, NULL, 0); break;
+            case 't': timeoutMs = (int)strtol(optarg, NULL, 0); break;
+            case 'q': quiet = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-a address] [-l latency_us] [-b baudrate] [-t timeout_ms] [-q]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    const char *ptyName = uart_sim_open();
+    if(ptyName == NULL){
+        perror("mkmx_sim: can't create pseudo-terminal");
+        return 1;
+    }
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = simStop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    uart_init(baudrate);
+    MkmxInit(address, crc8_ccitt_update);
+    if(timeoutMs > 0){
+        // uart_getc() gives up after timeoutMs of silence, one tick per such wait
+        uart_sim_set_poll_timeout(timeoutMs);
+        MkmxSetTimeout(1);
+    }
+
+    // the path goes to stdout alone so scripts can pick it up, everything else to stderr
+    printf("%s\n", ptyName);
+    fflush(stdout);
+    fprintf(stderr, "mkmx_sim: address 0x%02X, latency %u us, baudrate %u%s\n",
+            address, latencyUs, baudrate, quiet ? ", not answering" : "");
+
+    uint32_t frames = 0;
+    uint64_t startNs = simNowNs();
+
+    // same loop as example.c on the target
+    while(simRunning){
+        unsigned int tmp = uart_getc();
+
+        if(!(tmp & UART_NO_DATA)) MkmxUpdate((uint8_t)tmp);
+        else if(timeoutMs > 0 && tmp == UART_NO_DATA) MkmxTick();
+
+        if(MkmxIsReady()){
+            ++frames;
+            if(!quiet){
+                if(latencyUs != 0) simSleepUs(latencyUs);
+                simAnswer(address, &MkmxFrame);
+            }
+            MkmxDiscardFrame();
+        }
+    }
+
+    double seconds = (double)(simNowNs() - startNs) / 1e9;
+    fprintf(stderr, "mkmx_sim: %u frames in %.3f s (%.1f frames/s), rx %u bytes, tx %u bytes\n",
+            frames, seconds, seconds > 0 ? frames / seconds : 0.0, uart_sim_rx_bytes(), uart_sim_tx_bytes());
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef UART_H
+#define UART_H
+
+// Host replacement of the AVR uart library (MCU/ATtiny841_usart/uart.h) backed by a Linux pseudo-terminal.
+// Same calls and return codes, so device code built against it behaves like on the target.
+
+#include <stdint.h>
+
+#define UART_FRAME_ERROR      0x1000
+#define UART_OVERRUN_ERROR    0x0800
+#define UART_PARITY_ERROR     0x0400
+#define UART_BUFFER_OVERFLOW  0x0200
+#define UART_NO_DATA          0x0100
+
+// the baud rate is only used to emulate the wire time of transmitted bytes, 0 = send at full speed
+extern void uart_init(unsigned int baudrate);
+extern unsigned int uart_getc(void);
+extern void uart_putc(unsigned char data);
+extern void uart_puts(const char *s);
+
+// simulator only
+// creates the pty, returns the path the master application has to open or NULL on error
+extern const char *uart_sim_open(void);
+// flushes bytes collected by uart_putc() (uart_putc() buffers until uart_getc() runs out of data)
+extern void uart_sim_flush(void);
+// longest time uart_getc() waits for data before returning UART_NO_DATA
+extern void uart_sim_set_poll_timeout(int timeoutMs);
+
+// CLOCK_MONOTONIC time (ns) at which the byte last returned by uart_getc() was read from the pty
+extern uint64_t uart_sim_rx_time_ns(void);
+
+extern uint32_t uart_sim_rx_bytes(void);
+extern uint32_t uart_sim_tx_bytes(void);
+
+#endif // UART_H
@@ -0,0 +1,119 @@
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include "uart.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UART_SIM_RX_BUFFER_SIZE 4096
+#define UART_SIM_TX_BUFFER_SIZE 4096
+
+static int uartFd = -1;
+static int uartSlaveFd = -1;
+static unsigned int uartBaudrate;
+static int uartPollTimeout = 100;
+
+static uint8_t rxBuffer[UART_SIM_RX_BUFFER_SIZE];
+static uint32_t rxHead, rxTail;
+static uint64_t rxTimeNs;
+static uint8_t txBuffer[UART_SIM_TX_BUFFER_SIZE];
+static uint32_t txLength;
+
+static uint32_t rxBytes, txBytes;
+
+const char *uart_sim_open(void){
+    struct termios tio;
+    const char *slaveName;
+
+    uartFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(uartFd < 0 || grantpt(uartFd) != 0 || unlockpt(uartFd) != 0) return NULL;
+
+    slaveName = ptsname(uartFd);
+    if(slaveName == NULL) return NULL;
+
+    // keep the slave open ourselves, otherwise reads fail with EIO until the application opens it
+    // and again every time it closes the port
+    uartSlaveFd = open(slaveName, O_RDWR | O_NOCTTY);
+    if(uartSlaveFd >= 0 && tcgetattr(uartSlaveFd, &tio) == 0){
+        cfmakeraw(&tio);
+        tcsetattr(uartSlaveFd, TCSANOW, &tio);
+    }
+    return slaveName;
+}
+
+void uart_init(unsigned int baudrate){
+    uartBaudrate = baudrate;
+}
+
+void uart_sim_set_poll_timeout(int timeoutMs){
+    uartPollTimeout = timeoutMs;
+}
+
+void uart_sim_flush(void){
+    uint32_t written = 0;
+    while(written < txLength){
+        ssize_t n = write(uartFd, txBuffer + written, txLength - written);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            break;
+        }
+        written += n;
+    }
+    txBytes += written;
+
+    if(uartBaudrate != 0 && written != 0){
+        // 8N1: 10 bit times per byte
+        uint64_t ns = (uint64_t)written * 10u * 1000000000ull / uartBaudrate;
+        struct timespec ts = { (time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull) };
+        while(nanosleep(&ts, &ts) != 0 && errno == EINTR);
+    }
+    txLength = 0;
+}
+
+unsigned int uart_getc(void){
+    if(rxHead == rxTail){
+        struct pollfd pfd = { uartFd, POLLIN, 0 };
+        struct timespec now;
+        ssize_t n;
+
+        // nothing more to read, answers collected so far leave now
+        uart_sim_flush();
+
+        if(poll(&pfd, 1, uartPollTimeout) <= 0) return UART_NO_DATA;
+        n = read(uartFd, rxBuffer, UART_SIM_RX_BUFFER_SIZE);
+        if(n <= 0) return UART_NO_DATA;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        rxTimeNs = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+        rxHead = 0;
+        rxTail = (uint32_t)n;
+        rxBytes += (uint32_t)n;
+    }
+    return rxBuffer[rxHead++];
+}
+
+void uart_putc(unsigned char data){
+    if(txLength == UART_SIM_TX_BUFFER_SIZE) uart_sim_flush();
+    txBuffer[txLength++] = data;
+}
+
+void uart_puts(const char *s){
+    while(*s) uart_putc((unsigned char)*s++);
+}
+
+uint64_t uart_sim_rx_time_ns(void){
+    return rxTimeNs;
+}
+
+uint32_t uart_sim_rx_bytes(void){
+    return rxBytes;
+}
+
+uint32_t uart_sim_tx_bytes(void){
+    return txBytes;
+}
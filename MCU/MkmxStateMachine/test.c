@@ -2,8 +2,10 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "mkmx_state_machine.h"
+#include "crc8_ccitt.h"
 
-uint8_t _crc8_ccitt_update (uint8_t inCrc, uint8_t inData)
+// bitwise reference used to verify the table driven implementation
+uint8_t crc8_reference (uint8_t inCrc, uint8_t inData)
 {
     uint8_t   i;
     uint8_t   data;
@@ -20,8 +22,13 @@ uint8_t _crc8_ccitt_update (uint8_t inCrc, uint8_t inData)
     }
     return data;
 }
+static uint16_t crcCalls;
+uint8_t crc8_counting(uint8_t inCrc, uint8_t inData){
+    ++crcCalls;
+    return crc8_ccitt_update(inCrc, inData);
+}
 void Test_begin(void){
-    MkmxInit(0x42, _crc8_ccitt_update);
+    MkmxInit(0x42, crc8_ccitt_update);
     MkmxFrame.command = 0;
     MkmxFrame.payloadLength = 0;
     for(uint8_t i=0; i<MKMX_MAX_INPUT_PAYLOAD_SIZE; ++i){
@@ -30,6 +37,15 @@ void Test_begin(void){
 }
 int main()
 {
+    // TEST: crc table matches bitwise reference
+    for(uint16_t c=0; c<256; ++c){
+        for(uint16_t d=0; d<256; ++d){
+            assert(crc8_ccitt_update((uint8_t)c, (uint8_t)d) == crc8_reference((uint8_t)c, (uint8_t)d));
+        }
+    }
+    assert(crc8_ccitt_block(0, (const uint8_t *)"123456789", 9) == 0xF4);
+
+
     // TEST: waiting for SOF
     Test_begin();
     for(uint16_t i=0; i<256; ++i){
@@ -117,6 +133,280 @@ int main()
     assert(!MkmxIsReady());
 
 
+    // TEST: independent instances, only the addressed one gets the frame
+    MkmxMachine_t machineA, machineB;
+    MkmxFrame_t frameA, frameB;
+    MkmxMachineInit(&machineA, &frameA, 0x42, crc8_ccitt_update);
+    MkmxMachineInit(&machineB, &frameB, 0x43, crc8_ccitt_update);
+    const uint8_t transaction[] = {0x5A, 0xA5, 0x42, 0x99, 0x01, 0xDE, 0x25};
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxMachineUpdate(&machineA, transaction[i]);
+        MkmxMachineUpdate(&machineB, transaction[i]);
+    }
+    assert(MkmxMachineIsReady(&machineA));
+    assert(!MkmxMachineIsReady(&machineB));
+    assert(frameA.command == 0x99);
+    assert(frameA.payload[0] == 0xDE);
+    assert(machineB.state == MKMX_IDLE);
+
+
+    // TEST: timeout disabled by default, a truncated frame waits forever
+    Test_begin();
+    const uint8_t truncated[] = {0x5A, 0xA5, 0x42, 0x99, 0x05, 0x11, 0x22};
+    for(uint8_t i=0; i<sizeof(truncated); ++i){
+        MkmxUpdate(truncated[i]);
+    }
+    for(uint16_t i=0; i<1000; ++i){
+        MkmxTick();
+    }
+    assert(MkmxUpdate(0x33) == MKMX_PLRX);
+
+
+    // TEST: without timeout the next frame is swallowed as payload
+    Test_begin();
+    for(uint8_t i=0; i<sizeof(truncated); ++i){
+        MkmxUpdate(truncated[i]);
+    }
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxUpdate(transaction[i]);
+    }
+    assert(!MkmxIsReady());
+
+
+    // TEST: timeout, every byte restarts the silent interval, the tick only raises the flag
+    Test_begin();
+    MkmxSetTimeout(3);
+    for(uint8_t i=0; i<sizeof(truncated); ++i){
+        MkmxUpdate(truncated[i]);
+    }
+    MkmxTick();
+    MkmxTick();
+    assert(MkmxUpdate(0x33) == MKMX_PLRX);
+    MkmxTick();
+    MkmxTick();
+    MkmxTick();
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxUpdate(transaction[i]);
+    }
+    assert(MkmxIsReady());
+    assert(MkmxFrame.command == 0x99);
+    assert(MkmxFrame.payloadLength == 0x01);
+    assert(MkmxFrame.payload[0] == 0xDE);
+
+
+    // TEST: timeout, a byte seen by the receive ISR restarts the silent interval too
+    Test_begin();
+    MkmxSetTimeout(3);
+    for(uint8_t i=0; i<sizeof(truncated); ++i){
+        MkmxByteArrived();
+        MkmxUpdate(truncated[i]);
+    }
+    MkmxTick();
+    MkmxTick();
+    MkmxByteArrived();      // still in the software buffer
+    MkmxTick();
+    MkmxTick();
+    assert(MkmxUpdate(0x33) == MKMX_PLRX);
+    MkmxTick();
+    MkmxTick();
+    MkmxTick();
+    MkmxByteArrived();
+    assert(MkmxUpdate(0x5A) == MKMX_SOF1);
+
+
+    // TEST: timeout, a complete frame still in the software buffer when the silence is detected is kept
+    Test_begin();
+    MkmxSetTimeout(3);
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxByteArrived();
+    }
+    assert(MkmxUpdate(transaction[0]) == MKMX_SOF1);
+    assert(MkmxUpdate(transaction[1]) == MKMX_SOF2);
+    assert(MkmxUpdate(transaction[2]) == MKMX_ADDR);
+    MkmxTick();
+    MkmxTick();
+    MkmxTick();
+    for(uint8_t i=3; i<sizeof(transaction); ++i){
+        MkmxUpdate(transaction[i]);
+    }
+    assert(MkmxIsReady());
+    assert(MkmxFrame.command == 0x99);
+    assert(MkmxFrame.payload[0] == 0xDE);
+    MkmxDiscardFrame();
+
+
+    // TEST: timeout, buffered bytes before the silence finish the frame, the first one after it abandons it
+    Test_begin();
+    MkmxSetTimeout(3);
+    for(uint8_t i=0; i<sizeof(truncated); ++i){
+        MkmxByteArrived();
+    }
+    MkmxTick();
+    MkmxTick();
+    MkmxTick();
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxByteArrived();
+    }
+    for(uint8_t i=0; i<sizeof(truncated); ++i){
+        assert(MkmxUpdate(truncated[i]) != MKMX_IDLE);
+    }
+    assert(MkmxUpdate(transaction[0]) == MKMX_SOF1);
+    for(uint8_t i=1; i<sizeof(transaction); ++i){
+        MkmxUpdate(transaction[i]);
+    }
+    assert(MkmxIsReady());
+    assert(MkmxFrame.command == 0x99);
+    assert(MkmxFrame.payload[0] == 0xDE);
+
+
+    // TEST: timeout while disposing a frame for another address
+    Test_begin();
+    MkmxSetTimeout(2);
+    assert(MkmxUpdate(0x5A) == MKMX_SOF1);
+    assert(MkmxUpdate(0xA5) == MKMX_SOF2);
+    assert(MkmxUpdate(0x24) == MKMX_XADDR);
+    assert(MkmxUpdate(0x99) == MKMX_XCMD);
+    assert(MkmxUpdate(0xFF) == MKMX_XPLRX);
+    MkmxTick();
+    assert(MkmxUpdate(0x00) == MKMX_XPLRX);
+    MkmxTick();
+    MkmxTick();
+    assert(MkmxUpdate(0x5A) == MKMX_SOF1);
+
+
+    // TEST: ticks while idle change nothing, an orphaned SOF1 times out too
+    Test_begin();
+    MkmxSetTimeout(1);
+    for(uint16_t i=0; i<300; ++i){
+        MkmxTick();
+    }
+    assert(MkmxUpdate(0x5A) == MKMX_SOF1);
+    MkmxTick();
+    assert(MkmxUpdate(0x5A) == MKMX_SOF1);
+
+
+    // TEST: instances time out independently
+    MkmxMachineInit(&machineA, &frameA, 0x42, crc8_ccitt_update);
+    MkmxMachineInit(&machineB, &frameB, 0x42, crc8_ccitt_update);
+    MkmxMachineSetTimeout(&machineA, 2);
+    for(uint8_t i=0; i<sizeof(truncated); ++i){
+        MkmxMachineUpdate(&machineA, truncated[i]);
+        MkmxMachineUpdate(&machineB, truncated[i]);
+    }
+    MkmxMachineTick(&machineA);
+    MkmxMachineTick(&machineB);
+    MkmxMachineTick(&machineA);
+    MkmxMachineTick(&machineB);
+    assert(machineA.timedOut);
+    assert(!machineB.timedOut);
+    assert(machineA.state == MKMX_PLRX);
+    assert(MkmxMachineUpdate(&machineA, 0x5A) == MKMX_SOF1);
+    assert(MkmxMachineUpdate(&machineB, 0x5A) == MKMX_PLRX);
+
+
+    // TEST: zero length payload
+    Test_begin();
+    uint8_t crc = crc8_ccitt_update(0, 0x42);
+    crc = crc8_ccitt_update(crc, 0x77);
+    crc = crc8_ccitt_update(crc, 0x00);
+    assert(MkmxUpdate(0x5A) == MKMX_SOF1);
+    assert(MkmxUpdate(0xA5) == MKMX_SOF2);
+    assert(MkmxUpdate(0x42) == MKMX_ADDR);
+    assert(MkmxUpdate(0x77) == MKMX_CMD);
+    assert(MkmxUpdate(0x00) == MKMX_PLCPL);
+    assert(MkmxUpdate(crc) == MKMX_IDLE);
+    assert(MkmxIsReady());
+    assert(MkmxFrame.command == 0x77);
+    assert(MkmxFrame.payloadLength == 0);
+
+
+    // TEST: my address, payload too long, skipped whole and the next frame accepted
+    Test_begin();
+    assert(MkmxUpdate(0x5A) == MKMX_SOF1);
+    assert(MkmxUpdate(0xA5) == MKMX_SOF2);
+    assert(MkmxUpdate(0x42) == MKMX_ADDR);
+    assert(MkmxUpdate(0x99) == MKMX_CMD);
+    assert(MkmxUpdate(MKMX_MAX_INPUT_PAYLOAD_SIZE + 1) == MKMX_XPLRX);
+    for(uint8_t i=0; i<MKMX_MAX_INPUT_PAYLOAD_SIZE; ++i){
+        assert(MkmxUpdate(0x5A) == MKMX_XPLRX);
+    }
+    assert(MkmxUpdate(0x5A) == MKMX_XPLCPL);
+    assert(MkmxUpdate(0x00) == MKMX_IDLE);
+    assert(!MkmxIsReady());
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxUpdate(transaction[i]);
+    }
+    assert(MkmxIsReady());
+    assert(MkmxFrame.payload[0] == 0xDE);
+
+
+    // TEST: frame still ready, the next one waits in the machine until discarded
+    Test_begin();
+    const uint8_t second[] = {0x5A, 0xA5, 0x42, 0x98, 0x02, 0xBE, 0xEF};
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxUpdate(transaction[i]);
+    }
+    for(uint8_t i=0; i<sizeof(second); ++i){
+        MkmxUpdate(second[i]);
+    }
+    assert(MkmxFrame.payload[0] == 0xDE);
+    MkmxDiscardFrame();
+    crc = crc8_ccitt_block(0, &second[2], sizeof(second) - 2);
+    assert(MkmxUpdate(crc) == MKMX_IDLE);
+    assert(MkmxIsReady());
+    assert(MkmxFrame.command == 0x98);
+    assert(MkmxFrame.payloadLength == 2);
+    assert(MkmxFrame.payload[0] == 0xBE);
+    assert(MkmxFrame.payload[1] == 0xEF);
+
+
+    // TEST: frame still ready when the next one completes, the next one is dropped
+    Test_begin();
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxUpdate(transaction[i]);
+    }
+    for(uint8_t i=0; i<sizeof(second); ++i){
+        MkmxUpdate(second[i]);
+    }
+    assert(MkmxUpdate(crc) == MKMX_IDLE);
+    assert(MkmxFrame.command == 0x99);
+    assert(MkmxFrame.payload[0] == 0xDE);
+
+
+    // TEST: a frame failing the CRC leaves the payload of the last accepted one alone
+    Test_begin();
+    for(uint8_t i=0; i<sizeof(transaction); ++i){
+        MkmxUpdate(transaction[i]);
+    }
+    MkmxDiscardFrame();
+    for(uint8_t i=0; i<sizeof(second); ++i){
+        MkmxUpdate(second[i]);
+    }
+    assert(MkmxUpdate(crc ^ 0xFF) == MKMX_IDLE);
+    assert(!MkmxIsReady());
+    assert(MkmxFrame.command == 0x99);
+    assert(MkmxFrame.payloadLength == 0x01);
+    assert(MkmxFrame.payload[0] == 0xDE);
+    assert(MkmxFrame.payload[1] == 0x00);
+
+
+    // TEST: CRC updated once per byte at most, never recomputed over the frame
+#ifndef MKMX_INLINE_CRC
+    MkmxMachineInit(&machineA, &frameA, 0x42, crc8_counting);
+    const uint8_t longFrame[] = {0x5A, 0xA5, 0x42, 0x10, 0x04, 0x01, 0x02, 0x03, 0x04};
+    for(uint8_t i=0; i<sizeof(longFrame); ++i){
+        crcCalls = 0;
+        MkmxMachineUpdate(&machineA, longFrame[i]);
+        assert(crcCalls <= 1);
+    }
+    crcCalls = 0;
+    MkmxMachineUpdate(&machineA, crc8_ccitt_block(0, &longFrame[2], sizeof(longFrame) - 2));
+    assert(crcCalls == 0);
+    assert(MkmxMachineIsReady(&machineA));
+    assert(frameA.payload[3] == 0x04);
+#endif
+
+
     printf("All tests passed\n");
     return 0;
 }
\ No newline at end of file
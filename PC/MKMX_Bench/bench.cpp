@@ -0,0 +1,71 @@
+#include "bench.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+volatile uint32_t u32BenchSink;
+uint64_t u64BenchAllocBytes;
+
+// the benchmarks are single threaded, a plain counter is enough
+void *operator new(size_t szSize) {
+    u64BenchAllocBytes += szSize;
+
+    void *p = malloc(szSize ? szSize : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+double medianOf(std::vector<double> values) {
+    if (values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+    size_t szMid = values.size() / 2;
+
+    return (values.size() & 1) ? values[szMid] : (values[szMid - 1] + values[szMid]) / 2.0;
+}
+
+void writeJson(FILE *pFile, const std::vector<std::pair<std::string, std::string>> &config,
+               const std::vector<sBenchResult_t> &results) {
+    fprintf(pFile, "{\n  \"config\": {");
+    for (size_t i = 0; i < config.size(); i++)
+        fprintf(pFile, "%s\n    \"%s\": %s", i ? "," : "", config[i].first.c_str(), config[i].second.c_str());
+    fprintf(pFile, "\n  },\n  \"results\": [");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const sBenchResult_t &sResult = results[i];
+        double dMedianNs = medianOf(sResult.samplesNs);
+        double dMinNs = *std::min_element(sResult.samplesNs.begin(), sResult.samplesNs.end());
+
+        fprintf(pFile, "%s\n    {\n", i ? "," : "");
+        fprintf(pFile, "      \"name\": \"%s\",\n", sResult.sName.c_str());
+        fprintf(pFile, "      \"bytes\": %llu,\n", (unsigned long long)sResult.u64Bytes);
+        fprintf(pFile, "      \"frames\": %llu,\n", (unsigned long long)sResult.u64Frames);
+        fprintf(pFile, "      \"median_ns\": %.0f,\n", dMedianNs);
+        fprintf(pFile, "      \"min_ns\": %.0f,\n", dMinNs);
+        fprintf(pFile, "      \"ns_per_byte\": %.4f,\n", dMedianNs / (double)sResult.u64Bytes);
+        fprintf(pFile, "      \"bytes_per_s\": %.0f,\n", (double)sResult.u64Bytes * 1e9 / dMedianNs);
+        fprintf(pFile, "      \"frames_per_s\": %.0f,\n", (double)sResult.u64Frames * 1e9 / dMedianNs);
+        fprintf(pFile, "      \"ns_per_frame\": %.2f,\n", sResult.u64Frames ? dMedianNs / (double)sResult.u64Frames : 0.0);
+        fprintf(pFile, "      \"alloc_bytes_per_frame\": %.2f,\n",
+                sResult.u64Frames ? (double)sResult.u64AllocBytes / (double)sResult.u64Frames : 0.0);
+        fprintf(pFile, "      \"samples_ns\": [");
+        for (size_t j = 0; j < sResult.samplesNs.size(); j++)
+            fprintf(pFile, "%s%.0f", j ? ", " : "", sResult.samplesNs[j]);
+        fprintf(pFile, "]\n    }");
+    }
+
+    fprintf(pFile, "\n  ]\n}\n");
+}
@@ -0,0 +1,55 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef struct {
+    std::string sName;
+    uint64_t u64Bytes;          // bytes processed by one sample
+    uint64_t u64Frames;         // frames completed by one sample (0 when not applicable)
+    uint64_t u64AllocBytes;     // heap bytes allocated by one sample
+    std::vector<double> samplesNs;
+} sBenchResult_t;
+
+// results are folded into this, so the compiler can not drop the measured work
+extern volatile uint32_t u32BenchSink;
+
+// every operator new of the process is counted here (see bench.cpp)
+extern uint64_t u64BenchAllocBytes;
+
+// one warm-up pass, then u32Repeat timed passes; fn() does one pass and returns the frames it completed
+template <class F>
+sBenchResult_t runBench(const char *pcName, uint64_t u64Bytes, uint32_t u32Repeat, F fn) {
+    sBenchResult_t sResult;
+    sResult.sName = pcName;
+    sResult.u64Bytes = u64Bytes;
+    sResult.u64Frames = fn();
+    sResult.u64AllocBytes = 0;
+
+    for (uint32_t i = 0; i < u32Repeat; i++) {
+        uint64_t u64AllocBefore = u64BenchAllocBytes;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t u64Frames = fn();
+        auto stop = std::chrono::steady_clock::now();
+
+        sResult.u64AllocBytes = u64BenchAllocBytes - u64AllocBefore;
+        sResult.samplesNs.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+        sResult.u64Frames = u64Frames;
+    }
+
+    return sResult;
+}
+
+double medianOf(std::vector<double> values);
+
+// {"config": {...}, "results": [...]}, config values are written verbatim (quote strings yourself)
+void writeJson(FILE *pFile, const std::vector<std::pair<std::string, std::string>> &config,
+               const std::vector<sBenchResult_t> &results);
+
+#endif // BENCH_H
@@ -0,0 +1,36 @@
+# Performance gate: builds the benchmarks, runs them and compares with the stored baseline of this machine.
+# usage: bash bench_gate.bash [profile] [--update]   (in any order)
+#   profile   baseline name, default: host name and CPU count
+#   --update  (re)write the baseline from this run instead of comparing
+# The first run on a new profile stores its baseline. A regression is confirmed by a second run
+# before the gate fails (exit code 2), so one disturbed run on a busy box does not block anybody.
+cd "$(dirname "$0")"
+
+UPDATE=0
+PROFILE=
+for ARG in "$@"; do
+    case "$ARG" in
+        --update) UPDATE=1 ;;
+        *) PROFILE=$ARG ;;
+    esac
+done
+PROFILE=${PROFILE:-$(hostname -s)-$(nproc)cpu}
+BASELINE=baselines/$PROFILE.json
+REPEAT=30
+
+bash build_bench.bash || exit 1
+mkdir -p baselines
+
+if [ $UPDATE -eq 1 ] || [ ! -f "$BASELINE" ]; then
+    ./mkmx_bench.out --repeat $REPEAT --json "$BASELINE" || exit 1
+    echo "baseline stored in $BASELINE"
+else
+    ./mkmx_bench.out --repeat $REPEAT --json "baselines/$PROFILE.last.json" --compare "$BASELINE"
+    RESULT=$?
+    if [ $RESULT -eq 2 ]; then
+        echo "confirming..."
+        ./mkmx_bench.out --repeat $REPEAT --json "baselines/$PROFILE.last.json" --compare "$BASELINE"
+        RESULT=$?
+    fi
+    exit $RESULT
+fi
@@ -0,0 +1,12 @@
+# Qt-free build of the hot path code from MKMX_TestApp and MkmxStateMachine
+APP=../MKMX_TestApp
+MCU=../../MCU/MkmxStateMachine
+
+gcc -O2 -c $MCU/mkmx_state_machine.c -o mkmx_state_machine.o && \
+gcc -O2 -c $MCU/crc8_ccitt.c -o crc8_ccitt.o && \
+g++ -O2 -std=c++14 -Wall -I$APP -I$MCU -o mkmx_bench.out \
+    main.cpp bench.cpp compare.cpp streamgen.cpp \
+    $APP/engine/framedecoder.cpp $APP/engine/framebuilder.cpp \
+    $APP/utils/crctools.cpp $APP/utils/ringbuffer.cpp $APP/utils/spscqueue.cpp \
+    mkmx_state_machine.o crc8_ccitt.o && \
+rm -f mkmx_state_machine.o crc8_ccitt.o
@@ -0,0 +1,260 @@
+#include "compare.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+// ---- statistics ----
+
+// continued fraction of the regularised incomplete beta function (modified Lentz)
+static double betaContinuedFraction(double a, double b, double x) {
+    const double dTiny = 1e-300;
+    double c = 1.0;
+    double d = 1.0 - (a + b) * x / (a + 1.0);
+    if (fabs(d) < dTiny)
+        d = dTiny;
+    d = 1.0 / d;
+    double f = d;
+
+    for (int m = 1; m <= 300; m++) {
+        double dNum = m * (b - m) * x / ((a + 2.0 * m - 1.0) * (a + 2.0 * m));
+        d = 1.0 + dNum * d;
+        c = 1.0 + dNum / c;
+        if (fabs(d) < dTiny) d = dTiny;
+        if (fabs(c) < dTiny) c = dTiny;
+        d = 1.0 / d;
+        f *= d * c;
+
+        dNum = -(a + m) * (a + b + m) * x / ((a + 2.0 * m) * (a + 2.0 * m + 1.0));
+        d = 1.0 + dNum * d;
+        c = 1.0 + dNum / c;
+        if (fabs(d) < dTiny) d = dTiny;
+        if (fabs(c) < dTiny) c = dTiny;
+        d = 1.0 / d;
+        double dDelta = d * c;
+        f *= dDelta;
+
+        if (fabs(dDelta - 1.0) < 1e-12)
+            break;
+    }
+
+    return f;
+}
+
+static double incompleteBeta(double a, double b, double x) {
+    if (x <= 0.0)
+        return 0.0;
+    if (x >= 1.0)
+        return 1.0;
+
+    double dFront = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1.0 - x));
+
+    if (x < (a + 1.0) / (a + b + 2.0))
+        return dFront * betaContinuedFraction(a, b, x) / a;
+
+    return 1.0 - dFront * betaContinuedFraction(b, a, 1.0 - x) / b;
+}
+
+// Student t cumulative distribution
+static double studentCdf(double t, double dDf) {
+    double dTail = 0.5 * incompleteBeta(dDf / 2.0, 0.5, dDf / (dDf + t * t));
+
+    return (t > 0) ? 1.0 - dTail : dTail;
+}
+
+static double studentQuantile(double p, double dDf) {
+    double dLow = -1000.0, dHigh = 1000.0;
+
+    for (int i = 0; i < 200; i++) {
+        double dMid = (dLow + dHigh) / 2.0;
+        if (studentCdf(dMid, dDf) < p)
+            dLow = dMid;
+        else
+            dHigh = dMid;
+    }
+
+    return (dLow + dHigh) / 2.0;
+}
+
+// preemption and cache disturbances only ever make a sample slower, drop the slowest fifth
+static std::vector<double> trimmed(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    values.resize(values.size() - values.size() / 5);
+
+    return values;
+}
+
+static void meanAndVariance(const std::vector<double> &values, double *pdMean, double *pdVariance) {
+    double dSum = 0.0;
+    for (double v : values)
+        dSum += v;
+    *pdMean = dSum / values.size();
+
+    double dSq = 0.0;
+    for (double v : values)
+        dSq += (v - *pdMean) * (v - *pdMean);
+    *pdVariance = (values.size() > 1) ? dSq / (values.size() - 1) : 0.0;
+}
+
+// ---- JSON input (only the format written by writeJson()) ----
+
+static bool numberAfter(const char *pcBegin, const char *pcEnd, const char *pcKey, double *pdValue) {
+    std::string sKey = std::string("\"") + pcKey + "\":";
+    const char *pc = strstr(pcBegin, sKey.c_str());
+
+    if (pc == nullptr || pc >= pcEnd)
+        return false;
+
+    *pdValue = strtod(pc + sKey.size(), nullptr);
+    return true;
+}
+
+bool loadResults(const std::string &sFile, std::vector<sBenchResult_t> *pResults, std::string *psError) {
+    FILE *pFile = fopen(sFile.c_str(), "r");
+    if (pFile == nullptr) {
+        *psError = "can't open " + sFile;
+        return false;
+    }
+
+    std::string sText;
+    char cBuffer[4096];
+    size_t szRead;
+    while ((szRead = fread(cBuffer, 1, sizeof(cBuffer), pFile)) > 0)
+        sText.append(cBuffer, szRead);
+    fclose(pFile);
+
+    pResults->clear();
+
+    const char *pc = strstr(sText.c_str(), "\"results\"");
+    if (pc == nullptr) {
+        *psError = sFile + ": no results";
+        return false;
+    }
+
+    static const char cNameKey[] = "\"name\": \"";
+    while ((pc = strstr(pc, cNameKey)) != nullptr) {
+        const char *pcName = pc + sizeof(cNameKey) - 1;
+        const char *pcNameEnd = strchr(pcName, '"');
+        const char *pcEnd = strchr(pcName, '}');
+        if (pcNameEnd == nullptr || pcEnd == nullptr)
+            break;
+
+        sBenchResult_t sResult;
+        sResult.sName.assign(pcName, pcNameEnd - pcName);
+
+        double dBytes = 0, dFrames = 0, dAllocPerFrame = 0;
+        numberAfter(pcName, pcEnd, "bytes", &dBytes);
+        numberAfter(pcName, pcEnd, "frames", &dFrames);
+        numberAfter(pcName, pcEnd, "alloc_bytes_per_frame", &dAllocPerFrame);
+        sResult.u64Bytes = (uint64_t)dBytes;
+        sResult.u64Frames = (uint64_t)dFrames;
+        sResult.u64AllocBytes = (uint64_t)llround(dAllocPerFrame * dFrames);
+
+        const char *pcSamples = strstr(pcName, "\"samples_ns\": [");
+        if (pcSamples != nullptr && pcSamples < pcEnd) {
+            const char *pcNum = strchr(pcSamples, '[') + 1;
+            const char *pcClose = strchr(pcNum, ']');
+
+            while (pcNum < pcClose) {
+                char *pcNext;
+                double dValue = strtod(pcNum, &pcNext);
+                if (pcNext == pcNum)
+                    break;
+                sResult.samplesNs.push_back(dValue);
+                pcNum = pcNext;
+                while (pcNum < pcClose && (*pcNum == ',' || *pcNum == ' '))
+                    pcNum++;
+            }
+        }
+
+        if (sResult.samplesNs.empty()) {
+            *psError = sFile + ": no samples for " + sResult.sName;
+            return false;
+        }
+
+        pResults->push_back(sResult);
+        pc = pcEnd;
+    }
+
+    return true;
+}
+
+// ---- comparison ----
+
+unsigned compareResults(FILE *pReport, const std::vector<sBenchResult_t> &baseline,
+                        const std::vector<sBenchResult_t> &current, double dAlpha, double dMinSlowdown) {
+    unsigned uRegressions = 0;
+
+    fprintf(pReport, "%-24s %12s %12s %9s %20s %9s  %s\n",
+            "benchmark", "base ns/B", "now ns/B", "change", "95% CI of change", "p", "verdict");
+
+    for (const sBenchResult_t &sNow : current) {
+        const sBenchResult_t *psBase = nullptr;
+        for (const sBenchResult_t &sBase : baseline) {
+            if (sBase.sName == sNow.sName)
+                psBase = &sBase;
+        }
+
+        if (psBase == nullptr) {
+            fprintf(pReport, "%-24s no baseline\n", sNow.sName.c_str());
+            continue;
+        }
+
+        // compare time per byte, so a different --bytes does not show up as a regression
+        std::vector<double> base, now;
+        for (double d : psBase->samplesNs)
+            base.push_back(d / psBase->u64Bytes);
+        for (double d : sNow.samplesNs)
+            now.push_back(d / sNow.u64Bytes);
+        base = trimmed(base);
+        now = trimmed(now);
+
+        double dMeanBase, dVarBase, dMeanNow, dVarNow;
+        meanAndVariance(base, &dMeanBase, &dVarBase);
+        meanAndVariance(now, &dMeanNow, &dVarNow);
+
+        double dSeBase = dVarBase / base.size();
+        double dSeNow = dVarNow / now.size();
+        double dSe = sqrt(dSeBase + dSeNow);
+        double dDiff = dMeanNow - dMeanBase;
+
+        double dP, dHalfWidth;
+        if (dSe > 0.0 && base.size() > 1 && now.size() > 1) {
+            // Welch-Satterthwaite degrees of freedom
+            double dDf = (dSeBase + dSeNow) * (dSeBase + dSeNow) /
+                         (dSeBase * dSeBase / (base.size() - 1) + dSeNow * dSeNow / (now.size() - 1));
+            dP = 1.0 - studentCdf(dDiff / dSe, dDf);
+            dHalfWidth = studentQuantile(0.975, dDf) * dSe;
+        } else {
+            dP = (dDiff > 0.0) ? 0.0 : 1.0;
+            dHalfWidth = 0.0;
+        }
+
+        double dChange = dDiff / dMeanBase;
+        bool bSlower = (dP < dAlpha) && (dChange > dMinSlowdown);
+
+        double dAllocBase = psBase->u64Frames ? (double)psBase->u64AllocBytes / psBase->u64Frames : 0.0;
+        double dAllocNow = sNow.u64Frames ? (double)sNow.u64AllocBytes / sNow.u64Frames : 0.0;
+        bool bMoreMemory = dAllocNow > dAllocBase + 0.5;
+
+        char cCi[32];
+        snprintf(cCi, sizeof(cCi), "[%+.1f%%, %+.1f%%]",
+                 100.0 * (dDiff - dHalfWidth) / dMeanBase, 100.0 * (dDiff + dHalfWidth) / dMeanBase);
+
+        fprintf(pReport, "%-24s %12.4f %12.4f %+8.1f%% %20s %9.2g  %s",
+                sNow.sName.c_str(), dMeanBase, dMeanNow, 100.0 * dChange, cCi, dP,
+                bSlower ? "SLOWER" : "ok");
+        if (bMoreMemory)
+            fprintf(pReport, ", heap %.1f -> %.1f B/frame", dAllocBase, dAllocNow);
+        fprintf(pReport, "\n");
+
+        if (bSlower)
+            uRegressions++;
+        if (bMoreMemory)
+            uRegressions++;
+    }
+
+    return uRegressions;
+}
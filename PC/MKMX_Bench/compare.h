@@ -0,0 +1,23 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+// reads the "results" of a JSON file written by writeJson()
+bool loadResults(const std::string &sFile, std::vector<sBenchResult_t> *pResults, std::string *psError);
+
+// Compares every current result with the baseline of the same name and prints a report.
+// A time regression needs both a one-sided Welch t-test below dAlpha and a mean slowdown above
+// dMinSlowdown (relative), so tiny but "significant" shifts do not fail the gate.
+// The slowest fifth of each sample set is dropped before testing.
+// Heap bytes per frame are deterministic and fail on any increase.
+// Returns the number of regressions.
+unsigned compareResults(FILE *pReport, const std::vector<sBenchResult_t> &baseline,
+                        const std::vector<sBenchResult_t> &current, double dAlpha, double dMinSlowdown);
+
+#endif // COMPARE_H
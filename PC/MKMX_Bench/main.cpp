@@ -0,0 +1,376 @@
+// Hot path microbenchmarks: frame decoding, CRC8, ring buffer and the MCU state machine,
+// run over a synthetic MKMX stream. Results go to stdout (or --json file) as JSON.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "compare.h"
+#include "streamgen.h"
+
+#include "engine/framebuilder.h"
+#include "engine/framedecoder.h"
+#include "utils/crctools.h"
+#include "utils/ringbuffer.h"
+#include "utils/spscqueue.h"
+
+extern "C" {
+    #include "mkmx_state_machine.h"
+    #include "crc8_ccitt.h"
+}
+
+#define BENCH_OWN_ADDRESS       0x42
+#define BENCH_RING_BUFFER_SIZE  1024
+#define BENCH_TX_QUEUE_SIZE     4096
+// noisy line of the recovery run: frames, corrupted and truncated fractions
+#define BENCH_RECOVERY_FRAMES   200000
+#define BENCH_RECOVERY_CORRUPT  0.05
+#define BENCH_RECOVERY_TRUNCATE 0.05
+
+// what cEngine::incommingInterfaceDataRxed() does with every chunk from the interface
+static uint64_t decodeStream(const uint8_t *pu8Stream, uint32_t u32StreamLen, uint32_t u32Chunk) {
+    cFrameDecoder decoder;
+    uint64_t u64Frames = 0;
+
+    for (uint32_t u32Offset = 0; u32Offset < u32StreamLen; u32Offset += u32Chunk) {
+        uint32_t u32Len = std::min(u32Chunk, u32StreamLen - u32Offset);
+        uint32_t u32Pos = 0;
+
+        // a broken frame may leave bytes to be decoded again, so loop until the decoder asks for more
+        eDecoderResult_t eResult;
+        do {
+            eResult = decoder.decode(pu8Stream + u32Offset, u32Len, &u32Pos);
+            if (eResult == eDecoderFrameReady) {
+                u64Frames++;
+                u32BenchSink += decoder.frame()->u8Cmd;
+            }
+        } while (eResult != eDecoderNeedMoreData);
+    }
+
+    return u64Frames;
+}
+
+static void usage(const char *pcName) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --bytes N         stream length, default 4194304\n"
+            "  --mix L:W,...     payload length mix, default 4:40,16:30,32:20,128:10\n"
+            "  --corrupt R       fraction of corrupted frames, default 0.01\n"
+            "  --foreign R       fraction of frames for other addresses, default 0.2\n"
+            "  --chunk N         bytes handed over per call (serial read size), default 64\n"
+            "  --repeat N        timed passes per benchmark, default 10\n"
+            "  --seed N          stream seed, default 1\n"
+            "  --filter S        run only benchmarks whose name contains S\n"
+            "  --json FILE       write the results to FILE instead of stdout\n"
+            "  --compare FILE    compare with the results in FILE, exit code 2 on a regression\n"
+            "  --alpha P         significance level of the comparison, default 0.01\n"
+            "  --threshold R     smallest relative slowdown reported as a regression, default 0.05\n",
+            pcName);
+}
+
+// the PC slices (utils/crctools) and the MCU table (crc8_ccitt.c) are separate implementations: every
+// bulk path must give the byte-wise result for every start alignment and tail length
+static bool checkCrc8(void) {
+    uint8_t u8Data[8 + 256], u8Copy[8 + 256];
+    uint32_t u32Seed = 1;
+    for (uint8_t &u8Byte : u8Data) {
+        u32Seed = u32Seed * 1103515245u + 12345u;
+        u8Byte = (uint8_t)(u32Seed >> 16);
+    }
+
+    for (uint32_t u32Align = 0; u32Align < 8; u32Align++) {
+        for (uint32_t u32Len = 0; u32Len <= 256; u32Len++) {
+            const uint8_t *pu8Data = u8Data + u32Align;
+            uint8_t u8Init = (uint8_t)(u32Len * 31);
+
+            uint8_t u8Table = u8Init, u8Mcu = u8Init;
+            for (uint32_t i = 0; i < u32Len; i++) {
+                u8Table = _crc8_ccitt_update(u8Table, pu8Data[i]);
+                u8Mcu = crc8_ccitt_update(u8Mcu, pu8Data[i]);
+            }
+
+            uint8_t u8Block = crc8CcittUpdateBlock(u8Init, pu8Data, u32Len);
+            uint8_t u8CopyCrc = crc8CcittCopyBlock(u8Init, u8Copy + u32Align, pu8Data, u32Len);
+            uint8_t u8McuBlock = crc8_ccitt_block(u8Init, pu8Data, (uint16_t)u32Len);
+
+            if (u8Block != u8Table || u8CopyCrc != u8Table || u8Mcu != u8Table || u8McuBlock != u8Table ||
+                memcmp(u8Copy + u32Align, pu8Data, u32Len) != 0) {
+                fprintf(stderr, "crc8 check: alignment %u, length %u: byte-wise 0x%02X, block 0x%02X, copy 0x%02X, "
+                        "mcu 0x%02X, mcu block 0x%02X\n", u32Align, u32Len, u8Table, u8Block, u8CopyCrc, u8Mcu, u8McuBlock);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    sStreamConfig_t sConfig;
+    sConfig.dCorruptRate = 0.01;
+    sConfig.dTruncateRate = 0;
+    sConfig.dForeignRatio = 0.2;
+    sConfig.u8OwnAddr = BENCH_OWN_ADDRESS;
+    sConfig.u32Seed = 1;
+    sConfig.u32Bytes = 4u << 20;
+    sConfig.u32Frames = 0;
+    parsePayloadMix("4:40,16:30,32:20,128:10", &sConfig.mix);
+
+    uint32_t u32Chunk = 64;
+    uint32_t u32Repeat = 10;
+    std::string sFilter;
+    std::string sJsonFile;
+    std::string sCompareFile;
+    double dAlpha = 0.01;
+    double dThreshold = 0.05;
+
+    static const struct option options[] = {
+        {"bytes",   required_argument, nullptr, 'b'},
+        {"mix",     required_argument, nullptr, 'm'},
+        {"corrupt", required_argument, nullptr, 'c'},
+        {"foreign", required_argument, nullptr, 'f'},
+        {"chunk",   required_argument, nullptr, 'k'},
+        {"repeat",  required_argument, nullptr, 'r'},
+        {"seed",    required_argument, nullptr, 's'},
+        {"filter",  required_argument, nullptr, 'F'},
+        {"json",    required_argument, nullptr, 'j'},
+        {"compare", required_argument, nullptr, 'C'},
+        {"alpha",   required_argument, nullptr, 'a'},
+        {"threshold", required_argument, nullptr, 't'},
+        {"help",    no_argument,       nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int iOpt;
+    while ((iOpt = getopt_long(argc, argv, "h", options, nullptr)) != -1) {
+        switch (iOpt) {
+            case 'b': sConfig.u32Bytes = (uint32_t)strtoul(optarg, nullptr, 0); break;
+            case 'm':
+                if (!parsePayloadMix(optarg, &sConfig.mix)) {
+                    fprintf(stderr, "invalid payload mix: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c': sConfig.dCorruptRate = atof(optarg); break;
+            case 'f': sConfig.dForeignRatio = atof(optarg); break;
+            case 'k': u32Chunk = (uint32_t)strtoul(optarg, nullptr, 0); break;
+            case 'r': u32Repeat = (uint32_t)strtoul(optarg, nullptr, 0); break;
+            case 's': sConfig.u32Seed = (uint32_t)strtoul(optarg, nullptr, 0); break;
+            case 'F': sFilter = optarg; break;
+            case 'j': sJsonFile = optarg; break;
+            case 'C': sCompareFile = optarg; break;
+            case 'a': dAlpha = atof(optarg); break;
+            case 't': dThreshold = atof(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (u32Chunk == 0 || u32Repeat == 0 || sConfig.u32Bytes == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sStreamStats_t sStats, sMcuStats;
+    const std::vector<uint8_t> stream = generateStream(sConfig, MAX_PAYLOAD_LENGTH, &sStats);
+    const std::vector<uint8_t> mcuStream = generateStream(sConfig, MKMX_MAX_INPUT_PAYLOAD_SIZE, &sMcuStats);
+
+    const uint8_t *pu8Stream = stream.data();
+    const uint32_t u32StreamLen = (uint32_t)stream.size();
+
+    std::vector<sBenchResult_t> results;
+    auto selected = [&sFilter](const char *pcName) {
+        return sFilter.empty() || strstr(pcName, sFilter.c_str()) != nullptr;
+    };
+
+    if (selected("decoder")) {
+        results.push_back(runBench("decoder", u32StreamLen, u32Repeat, [&]() {
+            return decodeStream(pu8Stream, u32StreamLen, u32Chunk);
+        }));
+    }
+
+    // the same decoder on a noisy line: every intact frame must come out, also the ones that follow
+    // a truncated or corrupted frame directly
+    sStreamStats_t sRecoveryStats = {0, 0, 0, 0};
+    if (selected("decoder_recovery")) {
+        sStreamConfig_t sRecoveryConfig = sConfig;
+        sRecoveryConfig.dCorruptRate = BENCH_RECOVERY_CORRUPT;
+        sRecoveryConfig.dTruncateRate = BENCH_RECOVERY_TRUNCATE;
+        sRecoveryConfig.u32Frames = BENCH_RECOVERY_FRAMES;
+
+        const std::vector<uint8_t> noisy = generateStream(sRecoveryConfig, MAX_PAYLOAD_LENGTH, &sRecoveryStats);
+        uint32_t u32Broken = sRecoveryStats.u32Corrupted + sRecoveryStats.u32Truncated;
+        uint32_t u32IntactFrames = sRecoveryStats.u32Frames - u32Broken;
+
+        results.push_back(runBench("decoder_recovery", noisy.size(), u32Repeat, [&]() {
+            return decodeStream(noisy.data(), (uint32_t)noisy.size(), u32Chunk);
+        }));
+
+        // a broken frame followed by the start of the next one passes CRC8 once in 256 times and takes
+        // that frame with it; without the rescan thousands of frames go missing
+        if (results.back().u64Frames + u32Broken / 256 < u32IntactFrames) {
+            fprintf(stderr, "decoder_recovery: %llu frames decoded, %u intact frames in the stream\n",
+                    (unsigned long long)results.back().u64Frames, u32IntactFrames);
+            return 1;
+        }
+    }
+
+    if ((selected("crc8_update") || selected("crc8_compute")) && !checkCrc8())
+        return 1;
+
+    if (selected("crc8_update")) {
+        results.push_back(runBench("crc8_update", u32StreamLen, u32Repeat, [&]() {
+            uint8_t u8Crc = 0;
+            for (uint32_t i = 0; i < u32StreamLen; i++)
+                u8Crc = _crc8_ccitt_update(u8Crc, pu8Stream[i]);
+            u32BenchSink += u8Crc;
+            return (uint64_t)0;
+        }));
+    }
+
+    // frame sized blocks, the way the builder and the decoder use it
+    if (selected("crc8_compute")) {
+        results.push_back(runBench("crc8_compute", u32StreamLen, u32Repeat, [&]() {
+            uint64_t u64Blocks = 0;
+            for (uint32_t u32Offset = 0; u32Offset < u32StreamLen; u32Offset += 258) {
+                u32BenchSink += computeCRC(pu8Stream + u32Offset, (uint16_t)std::min(258u, u32StreamLen - u32Offset));
+                u64Blocks++;
+            }
+            return u64Blocks;
+        }));
+    }
+
+    if (selected("ringbuffer_push_pop")) {
+        results.push_back(runBench("ringbuffer_push_pop", u32StreamLen, u32Repeat, [&]() {
+            static uint8_t u8Buffer[BENCH_RING_BUFFER_SIZE];
+            uint8_t u8Out[255];
+            sRingBuffer_t sRing;
+            InitializeRingBuffer(&sRing, u8Buffer, BENCH_RING_BUFFER_SIZE, nullptr);
+
+            uint8_t u8Chunk = (uint8_t)std::min(u32Chunk, 255u);
+            for (uint32_t u32Offset = 0; u32Offset < u32StreamLen; u32Offset += u8Chunk) {
+                uint8_t u8Len = (uint8_t)std::min((uint32_t)u8Chunk, u32StreamLen - u32Offset);
+                PushData(&sRing, pu8Stream + u32Offset, u8Len);
+                u32BenchSink += PopData(&sRing, u8Out, u8Len);
+            }
+            return (uint64_t)0;
+        }));
+    }
+
+    if (selected("ringbuffer16_push_pop")) {
+        results.push_back(runBench("ringbuffer16_push_pop", u32StreamLen, u32Repeat, [&]() {
+            static uint8_t u8Buffer[BENCH_RING_BUFFER_SIZE];
+            static uint8_t u8Out[BENCH_RING_BUFFER_SIZE];
+            sRingBuffer_t sRing;
+            InitializeRingBuffer(&sRing, u8Buffer, BENCH_RING_BUFFER_SIZE, nullptr);
+
+            uint16_t u16Chunk = (uint16_t)std::min(u32Chunk, (uint32_t)BENCH_RING_BUFFER_SIZE);
+            for (uint32_t u32Offset = 0; u32Offset < u32StreamLen; u32Offset += u16Chunk) {
+                uint16_t u16Len = (uint16_t)std::min((uint32_t)u16Chunk, u32StreamLen - u32Offset);
+                PushData16(&sRing, pu8Stream + u32Offset, u16Len);
+                u32BenchSink += PopData16(&sRing, u8Out, u16Len);
+            }
+            return (uint64_t)0;
+        }));
+    }
+
+    // cInterface::txData(): one frame serialised into the TX queue; the consumer side is a flush,
+    // so only the producer is measured
+    if (selected("tx_enqueue")) {
+        const std::vector<uint8_t> lengths = generatePayloadLengths(sConfig, sStats.u32Frames);
+        uint64_t u64TxBytes = 0;
+        for (uint8_t u8Len : lengths)
+            u64TxBytes += u8Len + FRAME_OVERHEAD_LENGTH;
+
+        results.push_back(runBench("tx_enqueue", u64TxBytes, u32Repeat, [&]() {
+            static uint8_t u8Buffer[BENCH_TX_QUEUE_SIZE];
+            cSpscByteQueue txQueue(u8Buffer, BENCH_TX_QUEUE_SIZE);
+            uint32_t u32PayloadPos = 0;
+
+            for (size_t i = 0; i < lengths.size(); i++) {
+                if (u32PayloadPos + lengths[i] > u32StreamLen)
+                    u32PayloadPos = 0;
+
+                if (!buildFrame(&txQueue, BENCH_OWN_ADDRESS, (uint8_t)i, pu8Stream + u32PayloadPos, lengths[i])) {
+                    txQueue.flush();
+                    buildFrame(&txQueue, BENCH_OWN_ADDRESS, (uint8_t)i, pu8Stream + u32PayloadPos, lengths[i]);
+                }
+                u32PayloadPos += lengths[i];
+            }
+            u32BenchSink += txQueue.usedBytes();
+            return (uint64_t)lengths.size();
+        }));
+    }
+
+    // the firmware main loop of example.c
+    if (selected("mkmx_update")) {
+        const uint8_t *pu8Mcu = mcuStream.data();
+        const uint32_t u32McuLen = (uint32_t)mcuStream.size();
+
+        results.push_back(runBench("mkmx_update", u32McuLen, u32Repeat, [&]() {
+            uint64_t u64Frames = 0;
+            MkmxInit(BENCH_OWN_ADDRESS, crc8_ccitt_update);
+
+            for (uint32_t i = 0; i < u32McuLen; i++) {
+                MkmxUpdate(pu8Mcu[i]);
+                if (MkmxIsReady()) {
+                    u64Frames++;
+                    u32BenchSink += MkmxFrame.command;
+                    MkmxDiscardFrame();
+                }
+            }
+            return u64Frames;
+        }));
+    }
+
+    std::vector<std::pair<std::string, std::string>> config = {
+        {"bytes", std::to_string(u32StreamLen)},
+        {"mix", "\"" + payloadMixToString(sConfig.mix) + "\""},
+        {"corrupt", std::to_string(sConfig.dCorruptRate)},
+        {"foreign", std::to_string(sConfig.dForeignRatio)},
+        {"chunk", std::to_string(u32Chunk)},
+        {"repeat", std::to_string(u32Repeat)},
+        {"seed", std::to_string(sConfig.u32Seed)},
+        {"stream_frames", std::to_string(sStats.u32Frames)},
+        {"stream_corrupted", std::to_string(sStats.u32Corrupted)},
+        {"stream_foreign", std::to_string(sStats.u32Foreign)},
+        {"recovery_frames", std::to_string(sRecoveryStats.u32Frames)},
+        {"recovery_corrupted", std::to_string(sRecoveryStats.u32Corrupted)},
+        {"recovery_truncated", std::to_string(sRecoveryStats.u32Truncated)}
+    };
+
+    FILE *pFile = stdout;
+    if (!sJsonFile.empty()) {
+        pFile = fopen(sJsonFile.c_str(), "w");
+        if (pFile == nullptr) {
+            perror(sJsonFile.c_str());
+            return 1;
+        }
+    }
+
+    writeJson(pFile, config, results);
+
+    if (pFile != stdout)
+        fclose(pFile);
+
+    if (!sCompareFile.empty()) {
+        std::vector<sBenchResult_t> baseline;
+        std::string sError;
+
+        if (!loadResults(sCompareFile, &baseline, &sError)) {
+            fprintf(stderr, "%s\n", sError.c_str());
+            return 1;
+        }
+
+        unsigned uRegressions = compareResults(stderr, baseline, results, dAlpha, dThreshold);
+        if (uRegressions != 0) {
+            fprintf(stderr, "%u regression(s) against %s\n", uRegressions, sCompareFile.c_str());
+            return 2;
+        }
+    }
+
+    return 0;
+}
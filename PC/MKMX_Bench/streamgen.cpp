@@ -0,0 +1,135 @@
+#include "streamgen.h"
+
+#include <stdlib.h>
+
+#include "utils/crctools.h"
+
+// xorshift32, the stream must not depend on the C library rand()
+static uint32_t nextRandom(uint32_t *pu32State) {
+    uint32_t x = *pu32State;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *pu32State = x;
+    return x;
+}
+
+static double nextUnit(uint32_t *pu32State) {
+    return (double)nextRandom(pu32State) / 4294967296.0;
+}
+
+bool parsePayloadMix(const std::string &sMix, std::vector<sPayloadMixEntry_t> *pMix) {
+    pMix->clear();
+
+    size_t szPos = 0;
+    while (szPos < sMix.size()) {
+        size_t szEnd = sMix.find(',', szPos);
+        if (szEnd == std::string::npos)
+            szEnd = sMix.size();
+
+        std::string sItem = sMix.substr(szPos, szEnd - szPos);
+        size_t szColon = sItem.find(':');
+
+        char *pcEnd;
+        unsigned long ulLen = strtoul(sItem.c_str(), &pcEnd, 0);
+        unsigned long ulWeight = (szColon == std::string::npos) ? 1 : strtoul(sItem.c_str() + szColon + 1, nullptr, 0);
+
+        if (pcEnd == sItem.c_str() || ulLen > 255 || ulWeight == 0)
+            return false;
+
+        pMix->push_back({(uint8_t)ulLen, (uint32_t)ulWeight});
+        szPos = szEnd + 1;
+    }
+
+    return !pMix->empty();
+}
+
+std::string payloadMixToString(const std::vector<sPayloadMixEntry_t> &mix) {
+    std::string sMix;
+
+    for (const sPayloadMixEntry_t &sEntry : mix) {
+        if (!sMix.empty())
+            sMix += ",";
+        sMix += std::to_string(sEntry.u8Len) + ":" + std::to_string(sEntry.u32Weight);
+    }
+
+    return sMix;
+}
+
+static uint8_t pickLength(const std::vector<sPayloadMixEntry_t> &mix, uint32_t u32TotalWeight, uint32_t *pu32State) {
+    uint32_t u32Pick = nextRandom(pu32State) % u32TotalWeight;
+
+    for (const sPayloadMixEntry_t &sEntry : mix) {
+        if (u32Pick < sEntry.u32Weight)
+            return sEntry.u8Len;
+        u32Pick -= sEntry.u32Weight;
+    }
+
+    return mix.back().u8Len;
+}
+
+static uint32_t totalWeight(const std::vector<sPayloadMixEntry_t> &mix) {
+    uint32_t u32TotalWeight = 0;
+    for (const sPayloadMixEntry_t &sEntry : mix)
+        u32TotalWeight += sEntry.u32Weight;
+
+    return u32TotalWeight;
+}
+
+std::vector<uint8_t> generatePayloadLengths(const sStreamConfig_t &sConfig, uint32_t u32Count) {
+    std::vector<uint8_t> lengths(u32Count);
+    uint32_t u32TotalWeight = totalWeight(sConfig.mix);
+    uint32_t u32State = sConfig.u32Seed ? sConfig.u32Seed : 1;
+
+    for (uint32_t i = 0; i < u32Count; i++)
+        lengths[i] = pickLength(sConfig.mix, u32TotalWeight, &u32State);
+
+    return lengths;
+}
+
+std::vector<uint8_t> generateStream(const sStreamConfig_t &sConfig, uint8_t u8MaxOwnPayload, sStreamStats_t *psStats) {
+    std::vector<uint8_t> stream;
+    stream.reserve(sConfig.u32Bytes + 256 + 6);
+
+    uint32_t u32TotalWeight = totalWeight(sConfig.mix);
+    uint32_t u32State = sConfig.u32Seed ? sConfig.u32Seed : 1;
+    *psStats = {0, 0, 0, 0};
+
+    while ((sConfig.u32Frames != 0) ? (psStats->u32Frames < sConfig.u32Frames) : (stream.size() < sConfig.u32Bytes)) {
+        uint8_t u8Len = pickLength(sConfig.mix, u32TotalWeight, &u32State);
+
+        uint8_t u8Addr = sConfig.u8OwnAddr;
+        if (nextUnit(&u32State) < sConfig.dForeignRatio) {
+            u8Addr = (uint8_t)(sConfig.u8OwnAddr + 1 + nextRandom(&u32State) % 255);
+            psStats->u32Foreign++;
+        } else if (u8Len > u8MaxOwnPayload) {
+            u8Len = u8MaxOwnPayload;
+        }
+
+        size_t szStart = stream.size();
+        stream.push_back(0x5A);
+        stream.push_back(0xA5);
+        stream.push_back(u8Addr);
+        stream.push_back((uint8_t)nextRandom(&u32State));
+        stream.push_back(u8Len);
+        for (uint8_t i = 0; i < u8Len; i++)
+            stream.push_back((uint8_t)nextRandom(&u32State));
+        stream.push_back(computeCRC(&stream[szStart + 2], u8Len + 3));
+
+        // drawn only when asked for, so streams without truncation stay the same
+        if (sConfig.dTruncateRate > 0 && nextUnit(&u32State) < sConfig.dTruncateRate) {
+            // the sync stays, at least one byte of the rest is missing
+            stream.resize(szStart + 2 + nextRandom(&u32State) % (u8Len + 4));
+            psStats->u32Truncated++;
+        } else if (nextUnit(&u32State) < sConfig.dCorruptRate) {
+            // anything but the start of frame, so the frame is still seen and fails its CRC (or length) check
+            size_t szByte = szStart + 2 + nextRandom(&u32State) % (u8Len + 4);
+            stream[szByte] ^= (uint8_t)(1u << (nextRandom(&u32State) % 8));
+            psStats->u32Corrupted++;
+        }
+
+        psStats->u32Frames++;
+    }
+
+    return stream;
+}
@@ -0,0 +1,43 @@
+#ifndef STREAMGEN_H
+#define STREAMGEN_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// payload length and its relative weight in the generated stream
+typedef struct {
+    uint8_t u8Len;
+    uint32_t u32Weight;
+} sPayloadMixEntry_t;
+
+typedef struct {
+    std::vector<sPayloadMixEntry_t> mix;
+    double dCorruptRate;        // fraction of frames with one byte flipped
+    double dTruncateRate;       // fraction of frames cut off after the sync, the next frame follows at once
+    double dForeignRatio;       // fraction of frames addressed to someone else
+    uint8_t u8OwnAddr;
+    uint32_t u32Seed;
+    uint32_t u32Bytes;          // stream length (whole frames, at least this many bytes)
+    uint32_t u32Frames;         // or this many frames, when not 0
+} sStreamConfig_t;
+
+typedef struct {
+    uint32_t u32Frames;
+    uint32_t u32Corrupted;
+    uint32_t u32Foreign;
+    uint32_t u32Truncated;
+} sStreamStats_t;
+
+// "len:weight,len:weight,..." e.g. "4:50,32:30,128:20"
+bool parsePayloadMix(const std::string &sMix, std::vector<sPayloadMixEntry_t> *pMix);
+std::string payloadMixToString(const std::vector<sPayloadMixEntry_t> &mix);
+
+// synthetic MKMX byte stream, deterministic for a given config;
+// payloads of the own address are clamped to u8MaxOwnPayload (the MCU accepts only short frames)
+std::vector<uint8_t> generateStream(const sStreamConfig_t &sConfig, uint8_t u8MaxOwnPayload, sStreamStats_t *psStats);
+
+// u32Count payload lengths drawn from the mix (frames to transmit)
+std::vector<uint8_t> generatePayloadLengths(const sStreamConfig_t &sConfig, uint32_t u32Count);
+
+#endif // STREAMGEN_H
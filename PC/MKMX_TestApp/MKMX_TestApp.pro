@@ -1,27 +1,84 @@
 # wersja Qt: 5.11.1 MSVC2015
 
-QT       += core gui widgets serialport
+QT       += core gui widgets serialport network
 
-CONFIG += Console
+CONFIG += Console c++14
 
 TARGET = MKMX_TestApp
 TEMPLATE = app
 
 SOURCES += main.cpp\
         mainwindow.cpp \
+    logmodel.cpp \
     engine/interface.cpp \
+    engine/transport.cpp \
+    engine/serialtransport.cpp \
+    engine/tcptransport.cpp \
+    engine/loopbacktransport.cpp \
+    engine/playbacktransport.cpp \
     utils/ringbuffer.cpp \
     engine/engine.cpp \
+    engine/framedecoder.cpp \
+    engine/framebuilder.cpp \
+    engine/bufferedfilewriter.cpp \
+    engine/capturewriter.cpp \
+    engine/capturereader.cpp \
+    engine/framearchive.cpp \
+    engine/logsink.cpp \
+    engine/metrics.cpp \
     utils/debugtools.cpp \
-    utils/crctools.cpp
+    utils/crctools.cpp \
+    utils/tracetools.cpp \
+    utils/spscqueue.cpp \
+    utils/hdrhistogram.cpp \
+    ../../MCU/MkmxStateMachine/mkmx_state_machine.c \
+    ../../MCU/MkmxStateMachine/crc8_ccitt.c
 
 HEADERS  += mainwindow.h \
+    logmodel.h \
     engine/interface.h \
+    engine/transport.h \
+    engine/serialtransport.h \
+    engine/tcptransport.h \
+    engine/loopbacktransport.h \
+    engine/playbacktransport.h \
     utils/ringbuffer.h \
     engine/engine.h \
+    engine/framedecoder.h \
+    engine/framebuilder.h \
+    engine/capturefile.h \
+    engine/bufferedfilewriter.h \
+    engine/capturewriter.h \
+    engine/capturereader.h \
+    engine/framearchive.h \
+    engine/logsink.h \
+    engine/metrics.h \
     version.h \
     utils/debugtools.h \
-    utils/crctools.h
+    utils/crctools.h \
+    utils/tracetools.h \
+    utils/spscqueue.h \
+    utils/hdrhistogram.h \
+    ../../MCU/MkmxStateMachine/mkmx_state_machine.h \
+    ../../MCU/MkmxStateMachine/crc8_ccitt.h
+
+# the firmware state machine behind the "loop:<address>" transport
+INCLUDEPATH += ../../MCU/MkmxStateMachine
+
+# multi-port epoll reactor (engine/reactor.h)
+linux {
+    DEFINES += MKMX_HAVE_REACTOR
+    SOURCES += engine/reactor.cpp
+    HEADERS += engine/reactor.h
+    QMAKE_CXXFLAGS += -faligned-new
+}
+
+# "pty:" transport (engine/ptytransport.h)
+unix {
+    DEFINES += MKMX_HAVE_PTY
+    SOURCES += engine/ptytransport.cpp
+    HEADERS += engine/ptytransport.h
+}
 
 FORMS    += mainwindow.ui
 
@@ -29,6 +86,11 @@ RESOURCES   +=  MKMX_TestApp.qrc
 
 RC_FILE = MKMX_TestApp.rc
 
+# binary trace records (utils/tracetools.h), compiled out in release builds
+CONFIG(debug, debug|release) {
+    DEFINES += TRACE_LEVEL=3
+}
+
 CONFIG(release, debug|release) {
     DESTDIR = $$PWD/_installer/_installer_sources
 
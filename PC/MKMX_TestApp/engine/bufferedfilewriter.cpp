@@ -0,0 +1,119 @@
+#include "bufferedfilewriter.h"
+
+#include <QDebug>
+
+cBufferedFileWriter::cBufferedFileWriter(const char *pcName, int iMaxQueued, int iFreePool, uint32_t u32FlushIntervalMs, QObject *parent) :
+    QThread(parent),
+    m_pcName(pcName),
+    m_iMaxQueued(iMaxQueued),
+    m_iFreePool(iFreePool),
+    m_u32FlushIntervalMs(u32FlushIntervalMs),
+    m_bStop(false),
+    m_u64DroppedBuffers(0),
+    m_bWriteFailed(false),
+    m_u64LostBuffers(0)
+{
+}
+
+void cBufferedFileWriter::startWriter(void) {
+    m_bStop = false;
+    m_u64DroppedBuffers = 0;
+    m_bWriteFailed = false;
+    m_u64LostBuffers = 0;
+
+    start();
+}
+
+void cBufferedFileWriter::stopWriter(void) {
+    if (!isRunning())
+        return;
+
+    m_mutex.lock();
+    m_bStop = true;
+    m_wakeWriter.wakeOne();
+    m_mutex.unlock();
+
+    wait();
+
+    m_free.clear();
+}
+
+bool cBufferedFileWriter::queue(QByteArray *pbaBuffer) {
+    QMutexLocker locker(&m_mutex);
+
+    return queueLocked(pbaBuffer);
+}
+
+bool cBufferedFileWriter::queueLocked(QByteArray *pbaBuffer) {
+    if (m_queued.size() >= m_iMaxQueued) {
+        m_u64DroppedBuffers++;
+        return false;
+    }
+
+    m_queued.append(*pbaBuffer);
+    m_wakeWriter.wakeOne();
+
+    *pbaBuffer = m_free.isEmpty() ? QByteArray() : m_free.takeLast();
+
+    return true;
+}
+
+bool cBufferedFileWriter::writeData(const void *pData, qint64 i64Len, uint64_t u64KeepLen) {
+    if (m_file.write((const char *)pData, i64Len) != i64Len) {
+        qDebug() << m_pcName << "write failed:" << m_file.errorString();
+        m_bWriteFailed = true;
+
+        // drop what made it of the broken buffer (a cut off block or line), best effort
+        m_file.resize(u64KeepLen);
+        return false;
+    }
+
+    return true;
+}
+
+void cBufferedFileWriter::run(void) {
+    QList<QByteArray> batch;
+
+    for (;;) {
+        m_mutex.lock();
+        if (m_u32FlushIntervalMs != 0) {
+            if (m_queued.isEmpty() && !m_bStop)
+                m_wakeWriter.wait(&m_mutex, m_u32FlushIntervalMs);
+        } else {
+            while (m_queued.isEmpty() && !m_bStop)
+                m_wakeWriter.wait(&m_mutex);
+        }
+
+        batch.swap(m_queued);
+        // the partly filled buffer goes too, so an idle session reaches the disk within the interval
+        if (m_u32FlushIntervalMs != 0)
+            takePartial(&batch);
+        bool bStop = m_bStop;
+        m_mutex.unlock();
+
+        // after a failure the buffers handed over before the producer saw it are only counted
+        foreach (const QByteArray &baBuffer, batch) {
+            if (m_bWriteFailed || !writeBuffer(baBuffer)) {
+                m_bWriteFailed = true;
+                m_u64LostBuffers++;
+            }
+        }
+
+        if (bStop && !m_bWriteFailed)
+            writeTail();
+
+        if (!m_bWriteFailed && !m_file.flush()) {
+            qDebug() << m_pcName << "flush failed:" << m_file.errorString();
+            m_bWriteFailed = true;
+        }
+
+        m_mutex.lock();
+        while (!batch.isEmpty() && m_free.size() < m_iFreePool)
+            m_free.append(batch.takeLast());
+        m_mutex.unlock();
+        batch.clear();
+
+        if (bStop)
+            break;
+    }
+}
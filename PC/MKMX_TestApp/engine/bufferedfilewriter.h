@@ -0,0 +1,77 @@
+#ifndef BUFFEREDFILEWRITER_H
+#define BUFFEREDFILEWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QList>
+#include <QByteArray>
+
+#include <atomic>
+
+#include <stdint.h>
+
+// Writer thread behind cCaptureWriter and cLogSink.
+// Producers fill buffers in memory and queue() them, the writer thread takes everything queued at once
+// and hands it to writeBuffer() in one batch, then flushes the file. A full queue drops buffers (and
+// counts them) rather than stalling the producer. After the first failed write nothing more is written,
+// the file ends at the last complete buffer; the buffers that did not reach the disk are counted.
+class cBufferedFileWriter : public QThread
+{
+    Q_OBJECT
+
+    void run(void);
+
+public:
+    // pcName prefixes the debug messages; u32FlushIntervalMs != 0 wakes the writer at least that often
+    // to take the partly filled buffer (takePartial()), otherwise it sleeps until a buffer is queued
+    cBufferedFileWriter(const char *pcName, int iMaxQueued, int iFreePool, uint32_t u32FlushIntervalMs, QObject *parent = nullptr);
+
+    uint64_t droppedBuffers(void) const { return m_u64DroppedBuffers; }
+    bool writeFailed(void) const { return m_bWriteFailed; }
+    uint64_t lostBuffers(void) const { return m_u64LostBuffers; }
+
+protected:
+    // the file of the writer thread, opened by the subclass before startWriter()
+    QFile m_file;
+    // guards the queue, a subclass may share it for its own producer side state
+    QMutex m_mutex;
+
+    void startWriter(void);
+    // the writer writes what is queued and exits; the file stays open
+    void stopWriter(void);
+
+    // producer side: false when the queue is full and the buffer was dropped (it is left as it is);
+    // otherwise *pbaBuffer is replaced by a recycled buffer, or by a null one when the pool is empty
+    bool queue(QByteArray *pbaBuffer);
+    bool queueLocked(QByteArray *pbaBuffer);
+
+    // writer thread: false marks the writer failed and the buffer lost
+    virtual bool writeBuffer(const QByteArray &baBuffer) = 0;
+    // writer thread, with m_mutex held: append the partly filled buffer to pBatch
+    virtual void takePartial(QList<QByteArray> *pBatch) { Q_UNUSED(pBatch); }
+    // writer thread: the last batch is written and nothing failed, before the final flush
+    virtual void writeTail(void) {}
+
+    // writer thread: on a failure the file is cut back to u64KeepLen (drop what made it of the broken
+    // buffer, best effort) and the writer fails
+    bool writeData(const void *pData, qint64 i64Len, uint64_t u64KeepLen);
+
+private:
+    const char *m_pcName;
+    int m_iMaxQueued;
+    int m_iFreePool;
+    uint32_t m_u32FlushIntervalMs;
+
+    QWaitCondition m_wakeWriter;
+    QList<QByteArray> m_queued;
+    QList<QByteArray> m_free;
+    bool m_bStop;
+
+    std::atomic<uint64_t> m_u64DroppedBuffers;
+    std::atomic<bool> m_bWriteFailed;
+    std::atomic<uint64_t> m_u64LostBuffers;
+};
+
+#endif // BUFFEREDFILEWRITER_H
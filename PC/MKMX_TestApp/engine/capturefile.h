@@ -0,0 +1,88 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <stdint.h>
+
+// Raw bus traffic capture (*.mkcap), little endian, append only:
+//
+//   sCaptureFileHeader_t
+//   block, block, ...            each: sCaptureBlockHeader_t + u32Length bytes of records
+//
+// A data block carries records (sCaptureRecordHeader_t + u16Len bytes), every RX chunk
+// and TX write of the session in the order they happened. Timestamps are monotonic
+// nanoseconds since the capture started; i64StartUtcMs maps them to wall clock time.
+// Since version 2 a port also has control records without bus data (CAPTURE_FLAG_LINE, CAPTURE_FLAG_RESET),
+// so a replay can time out and reset its decoder like the live session did.
+// A reader can walk the file block by block without looking into the records.
+//
+// Sparse time index: after every CAPTURE_INDEX_INTERVAL data blocks (and at the end) an index block
+// lists their first timestamps and file offsets, preceded by the offset of the previous index block.
+// A cleanly closed file ends with a trailer block pointing to the last index block, so a reader
+// finds every data block by following the chain back from the end of the file.
+// Since version 3 the trailer also carries the set of ports with RX records, so a playback picks its
+// port without reading the records.
+
+#define CAPTURE_FILE_MAGIC          "MKMXCAP1"
+#define CAPTURE_FILE_VERSION        3               // readers accept 1 (no control records) and 2 (no port set) as well
+#define CAPTURE_BLOCK_MAGIC         0x4B4C424Du     // "MBLK"
+#define CAPTURE_BLOCK_SIZE          65536           // upper limit of a block, header included
+
+#define CAPTURE_INDEX_INTERVAL      64              // data blocks per index block
+
+#define CAPTURE_FLAG_TX             0x01            // record direction, RX when cleared
+#define CAPTURE_FLAG_LINE           0x02            // control: uint32_t character time of the port in ns (0: no line speed),
+                                                    // recorded when the port opens
+#define CAPTURE_FLAG_RESET          0x04            // control, no data: the RX stream of the port jumped (playback seek)
+#define CAPTURE_FLAGS_CONTROL       (CAPTURE_FLAG_LINE | CAPTURE_FLAG_RESET)
+
+typedef enum {
+    eCaptureBlockData = 0,
+    eCaptureBlockIndex,         // uint64_t previous index block offset (0 = none), sCaptureIndexEntry_t[u32Records]
+    eCaptureBlockTrailer        // uint64_t last index block offset (0 = none),
+                                // since version 3 followed by uint8_t[CAPTURE_PORT_SET_SIZE]: bit n set when port n has RX records
+} eCaptureBlockType_t;
+
+#pragma pack(push, 1)
+
+typedef struct {
+    char cMagic[8];
+    uint16_t u16Version;
+    uint16_t u16HeaderLen;
+    uint32_t u32BlockSize;
+    int64_t i64StartUtcMs;
+} sCaptureFileHeader_t;
+
+typedef struct {
+    uint32_t u32Magic;
+    uint16_t u16Type;
+    uint16_t u16Reserved;
+    uint32_t u32Length;
+    uint32_t u32Records;
+    uint64_t u64FirstNs;
+    uint64_t u64LastNs;
+} sCaptureBlockHeader_t;
+
+typedef struct {
+    uint32_t u32DeltaNs;        // since u64FirstNs of the block
+    uint8_t u8Flags;
+    uint8_t u8PortId;
+    uint16_t u16Len;
+} sCaptureRecordHeader_t;
+
+typedef struct {
+    uint64_t u64FirstNs;
+    uint64_t u64Offset;
+} sCaptureIndexEntry_t;
+
+#pragma pack(pop)
+
+#define CAPTURE_PORT_SET_SIZE       (256 / 8)
+
+#define CAPTURE_TRAILER_V2_LENGTH   (sizeof(sCaptureBlockHeader_t) + sizeof(uint64_t))
+#define CAPTURE_TRAILER_LENGTH      (CAPTURE_TRAILER_V2_LENGTH + CAPTURE_PORT_SET_SIZE)
+
+static_assert(sizeof(sCaptureFileHeader_t) == 24, "capture file header layout");
+static_assert(sizeof(sCaptureBlockHeader_t) == 32, "capture block header layout");
+static_assert(sizeof(sCaptureRecordHeader_t) == 8, "capture record header layout");
+
+#endif // CAPTUREFILE_H
@@ -0,0 +1,271 @@
+#include "capturereader.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+cCaptureReader::cCaptureReader() :
+    m_u64FileSize(0),
+    m_pu8Window(nullptr),
+    m_u64WindowOffset(0),
+    m_u64WindowSize(0),
+    m_u64BlockOffset(0),
+    m_pu8Record(nullptr),
+    m_pu8BlockEnd(nullptr),
+    m_bInBlock(false),
+    m_bComplete(false),
+    m_u64DurationNs(0),
+    m_bHasRxPorts(false),
+    m_bHasPending(false)
+{
+    memset(&m_sHeader, 0, sizeof(m_sHeader));
+    memset(m_au8RxPorts, 0, sizeof(m_au8RxPorts));
+}
+
+cCaptureReader::~cCaptureReader() {
+    close();
+}
+
+bool cCaptureReader::open(const QString &qsFileName, QString *pqsError) {
+    close();
+
+    m_file.setFileName(qsFileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        *pqsError = QString("Can't open %1: %2").arg(qsFileName, m_file.errorString());
+        return false;
+    }
+
+    m_u64FileSize = m_file.size();
+
+    const uint8_t *pu8Header = map(0, sizeof(sCaptureFileHeader_t));
+    if (pu8Header == nullptr) {
+        *pqsError = QString("%1 is not a capture file").arg(qsFileName);
+        close();
+        return false;
+    }
+
+    memcpy(&m_sHeader, pu8Header, sizeof(m_sHeader));
+    if (memcmp(m_sHeader.cMagic, CAPTURE_FILE_MAGIC, sizeof(m_sHeader.cMagic)) != 0 ||
+        m_sHeader.u16Version == 0 || m_sHeader.u16Version > CAPTURE_FILE_VERSION || m_sHeader.u16HeaderLen < sizeof(sCaptureFileHeader_t) ||
+        m_sHeader.u32BlockSize > CAPTURE_BLOCK_SIZE) {
+        *pqsError = QString("%1 is not a capture file (or a newer version)").arg(qsFileName);
+        close();
+        return false;
+    }
+
+    loadIndex();
+    rewind();
+
+    return true;
+}
+
+void cCaptureReader::close(void) {
+    if (m_pu8Window != nullptr)
+        m_file.unmap(m_pu8Window);
+    m_pu8Window = nullptr;
+    m_u64WindowSize = 0;
+
+    m_file.close();
+    m_u64FileSize = 0;
+    m_bInBlock = false;
+    m_bHasPending = false;
+    m_index.clear();
+    m_u64DurationNs = 0;
+    m_bHasRxPorts = false;
+}
+
+void cCaptureReader::rewind(void) {
+    m_u64BlockOffset = m_sHeader.u16HeaderLen;
+    m_bInBlock = false;
+    m_bComplete = false;
+    m_bHasPending = false;
+}
+
+bool cCaptureReader::readBlockHeader(uint64_t u64Offset, sCaptureBlockHeader_t *psBlock) {
+    const uint8_t *pu8Block = map(u64Offset, sizeof(sCaptureBlockHeader_t));
+    if (pu8Block == nullptr)
+        return false;
+
+    memcpy(psBlock, pu8Block, sizeof(*psBlock));
+
+    return (psBlock->u32Magic == CAPTURE_BLOCK_MAGIC) && (psBlock->u32Length <= m_sHeader.u32BlockSize) &&
+           (u64Offset + sizeof(*psBlock) + psBlock->u32Length <= m_u64FileSize);
+}
+
+void cCaptureReader::loadIndex(void) {
+    sCaptureBlockHeader_t sBlock;
+
+    // cleanly closed file: follow the chain of index blocks back from the trailer
+    if (!loadIndexChain()) {
+        // no trailer (the capture was not closed) or a damaged index: walk the block headers,
+        // the records are not touched
+        m_index.clear();
+
+        uint64_t u64Offset = m_sHeader.u16HeaderLen;
+        while (readBlockHeader(u64Offset, &sBlock)) {
+            if (sBlock.u16Type == eCaptureBlockData)
+                m_index.push_back({sBlock.u64FirstNs, u64Offset});
+            u64Offset += sizeof(sBlock) + sBlock.u32Length;
+        }
+    }
+
+    m_u64DurationNs = 0;
+    if (!m_index.empty() && readBlockHeader(m_index.back().u64Offset, &sBlock))
+        m_u64DurationNs = sBlock.u64LastNs;
+}
+
+bool cCaptureReader::loadIndexChain(void) {
+    sCaptureBlockHeader_t sBlock;
+    m_index.clear();
+    m_bHasRxPorts = false;
+
+    uint64_t u64TrailerLen = (m_sHeader.u16Version >= 3) ? CAPTURE_TRAILER_LENGTH : CAPTURE_TRAILER_V2_LENGTH;
+    if (m_u64FileSize < m_sHeader.u16HeaderLen + u64TrailerLen)
+        return false;
+
+    uint64_t u64TrailerOffset = m_u64FileSize - u64TrailerLen;
+    if (!readBlockHeader(u64TrailerOffset, &sBlock) || sBlock.u16Type != eCaptureBlockTrailer ||
+        sizeof(sBlock) + sBlock.u32Length != u64TrailerLen)
+        return false;
+
+    uint64_t u64IndexOffset;
+    const uint8_t *pu8Trailer = map(u64TrailerOffset + sizeof(sBlock), sBlock.u32Length);
+    if (pu8Trailer == nullptr)
+        return false;
+    memcpy(&u64IndexOffset, pu8Trailer, sizeof(u64IndexOffset));
+
+    uint8_t au8RxPorts[CAPTURE_PORT_SET_SIZE];
+    if (u64TrailerLen == CAPTURE_TRAILER_LENGTH)
+        memcpy(au8RxPorts, pu8Trailer + sizeof(u64IndexOffset), sizeof(au8RxPorts));
+
+    // every index block lies before the block pointing to it, so the offsets must strictly fall;
+    // anything else (a loop, a forward link) is a damaged index
+    uint64_t u64Limit = u64TrailerOffset;
+
+    std::vector<std::vector<sCaptureIndexEntry_t>> chain;
+    while (u64IndexOffset != 0) {
+        if (u64IndexOffset < m_sHeader.u16HeaderLen || u64IndexOffset >= u64Limit ||
+            !readBlockHeader(u64IndexOffset, &sBlock) || sBlock.u16Type != eCaptureBlockIndex ||
+            sizeof(uint64_t) + (uint64_t)sBlock.u32Records * sizeof(sCaptureIndexEntry_t) > sBlock.u32Length)
+            return false;
+
+        const uint8_t *pu8Index = map(u64IndexOffset + sizeof(sBlock), sBlock.u32Length);
+        if (pu8Index == nullptr)
+            return false;
+
+        const sCaptureIndexEntry_t *psEntries = (const sCaptureIndexEntry_t *)(pu8Index + sizeof(uint64_t));
+
+        chain.push_back(std::vector<sCaptureIndexEntry_t>(psEntries, psEntries + sBlock.u32Records));
+        u64Limit = u64IndexOffset;
+        memcpy(&u64IndexOffset, pu8Index, sizeof(u64IndexOffset));
+    }
+
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        m_index.insert(m_index.end(), it->begin(), it->end());
+
+    // trusted only together with an intact index
+    if (u64TrailerLen == CAPTURE_TRAILER_LENGTH) {
+        memcpy(m_au8RxPorts, au8RxPorts, sizeof(m_au8RxPorts));
+        m_bHasRxPorts = true;
+    }
+
+    return true;
+}
+
+void cCaptureReader::seek(uint64_t u64TimeNs) {
+    rewind();
+
+    // last block starting at or before the requested time
+    auto it = std::upper_bound(m_index.begin(), m_index.end(), u64TimeNs,
+                               [](uint64_t u64Ns, const sCaptureIndexEntry_t &sEntry) { return u64Ns < sEntry.u64FirstNs; });
+    if (it != m_index.begin())
+        m_u64BlockOffset = (it - 1)->u64Offset;
+
+    while (readRecord(&m_sPending)) {
+        if (m_sPending.u64TimeNs >= u64TimeNs) {
+            m_bHasPending = true;
+            break;
+        }
+    }
+}
+
+const uint8_t *cCaptureReader::map(uint64_t u64Offset, uint64_t u64Len) {
+    // a range that does not fit one window can't be handed out as one pointer
+    if (u64Offset + u64Len > m_u64FileSize || u64Len > CAPTURE_MAP_WINDOW_SIZE)
+        return nullptr;
+
+    if (m_pu8Window == nullptr || u64Offset < m_u64WindowOffset ||
+        u64Offset + u64Len > m_u64WindowOffset + m_u64WindowSize) {
+        if (m_pu8Window != nullptr)
+            m_file.unmap(m_pu8Window);
+
+        m_u64WindowOffset = u64Offset;
+        m_u64WindowSize = qMin<uint64_t>(CAPTURE_MAP_WINDOW_SIZE, m_u64FileSize - u64Offset);
+        m_pu8Window = m_file.map(m_u64WindowOffset, m_u64WindowSize);
+
+        if (m_pu8Window == nullptr)
+            return nullptr;
+    }
+
+    return m_pu8Window + (u64Offset - m_u64WindowOffset);
+}
+
+bool cCaptureReader::enterBlock(void) {
+    if (m_u64BlockOffset == m_u64FileSize) {
+        m_bComplete = true;
+        return false;
+    }
+
+    if (!readBlockHeader(m_u64BlockOffset, &m_sBlock))
+        return false;
+
+    // map header and records together, so every pointer handed out stays inside one window
+    const uint8_t *pu8Block = map(m_u64BlockOffset, sizeof(sCaptureBlockHeader_t) + m_sBlock.u32Length);
+    if (pu8Block == nullptr)
+        return false;
+
+    m_pu8Record = pu8Block + sizeof(sCaptureBlockHeader_t);
+    m_pu8BlockEnd = m_pu8Record + m_sBlock.u32Length;
+    m_u64BlockOffset += sizeof(sCaptureBlockHeader_t) + m_sBlock.u32Length;
+    m_bInBlock = true;
+
+    return true;
+}
+
+bool cCaptureReader::nextRecord(sCaptureRecord_t *psRecord) {
+    if (m_bHasPending) {
+        *psRecord = m_sPending;
+        m_bHasPending = false;
+        return true;
+    }
+
+    return readRecord(psRecord);
+}
+
+bool cCaptureReader::readRecord(sCaptureRecord_t *psRecord) {
+    for (;;) {
+        if (!m_bInBlock && !enterBlock())
+            return false;
+
+        // blocks of other types are skipped as a whole
+        if (m_sBlock.u16Type == eCaptureBlockData &&
+            m_pu8Record + sizeof(sCaptureRecordHeader_t) <= m_pu8BlockEnd) {
+            sCaptureRecordHeader_t sRecord;
+            memcpy(&sRecord, m_pu8Record, sizeof(sRecord));
+
+            if (m_pu8Record + sizeof(sRecord) + sRecord.u16Len > m_pu8BlockEnd)
+                return false;
+
+            psRecord->u64TimeNs = m_sBlock.u64FirstNs + sRecord.u32DeltaNs;
+            psRecord->u8Flags = sRecord.u8Flags;
+            psRecord->u8PortId = sRecord.u8PortId;
+            psRecord->pu8Data = m_pu8Record + sizeof(sRecord);
+            psRecord->u32Len = sRecord.u16Len;
+
+            m_pu8Record += sizeof(sRecord) + sRecord.u16Len;
+            return true;
+        }
+
+        m_bInBlock = false;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef CAPTUREREADER_H
+#define CAPTUREREADER_H
+
+#include <QFile>
+#include <QString>
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "capturefile.h"
+
+// file is mapped in windows of this size, so multi-gigabyte captures work in 32-bit builds too
+#define CAPTURE_MAP_WINDOW_SIZE     (256u << 20)
+
+typedef struct {
+    uint64_t u64TimeNs;         // since the start of the capture
+    uint8_t u8Flags;
+    uint8_t u8PortId;
+    const uint8_t *pu8Data;     // points into the mapped file, valid until the next call of the reader
+    uint32_t u32Len;
+} sCaptureRecord_t;
+
+// Memory mapped, zero-copy reader of capture files (capturefile.h).
+class cCaptureReader
+{
+public:
+    cCaptureReader();
+    ~cCaptureReader();
+
+    bool open(const QString &qsFileName, QString *pqsError);
+    void close(void);
+
+    const sCaptureFileHeader_t *header(void) const { return &m_sHeader; }
+    uint64_t fileSize(void) const { return m_u64FileSize; }
+
+    // next record in file order; false at the end of the file or at the first damaged block
+    // (a capture cut short by a crash ends with a partial block)
+    bool nextRecord(sCaptureRecord_t *psRecord);
+    void rewind(void);
+
+    // whole file was read and every block was intact
+    bool isComplete(void) const { return m_bComplete; }
+
+    // time of the last record
+    uint64_t durationNs(void) const { return m_u64DurationNs; }
+    // continues at the first record at or after u64TimeNs, found through the time index
+    void seek(uint64_t u64TimeNs);
+
+    // CAPTURE_PORT_SET_SIZE bytes, bit n set when port n has RX records; nullptr when the file
+    // does not say (no trailer, or older than version 3), only a scan of the records tells then
+    const uint8_t *rxPorts(void) const { return m_bHasRxPorts ? m_au8RxPorts : nullptr; }
+
+private:
+    QFile m_file;
+    uint64_t m_u64FileSize;
+    sCaptureFileHeader_t m_sHeader;
+
+    uchar *m_pu8Window;
+    uint64_t m_u64WindowOffset;
+    uint64_t m_u64WindowSize;
+
+    // current block
+    uint64_t m_u64BlockOffset;
+    sCaptureBlockHeader_t m_sBlock;
+    const uint8_t *m_pu8Record;
+    const uint8_t *m_pu8BlockEnd;
+    bool m_bInBlock;
+    bool m_bComplete;
+
+    // data block offsets by first timestamp
+    std::vector<sCaptureIndexEntry_t> m_index;
+    uint64_t m_u64DurationNs;
+
+    // from the trailer
+    uint8_t m_au8RxPorts[CAPTURE_PORT_SET_SIZE];
+    bool m_bHasRxPorts;
+
+    // record read ahead by seek()
+    sCaptureRecord_t m_sPending;
+    bool m_bHasPending;
+
+    const uint8_t *map(uint64_t u64Offset, uint64_t u64Len);
+    bool readBlockHeader(uint64_t u64Offset, sCaptureBlockHeader_t *psBlock);
+    bool enterBlock(void);
+    bool readRecord(sCaptureRecord_t *psRecord);
+    void loadIndex(void);
+    // false when the file has no trailer or its index chain is damaged
+    bool loadIndexChain(void);
+};
+
+#endif // CAPTUREREADER_H
@@ -0,0 +1,225 @@
+#include "capturewriter.h"
+
+#include <QDateTime>
+
+#include <string.h>
+
+// largest record payload that still fits an empty block
+#define CAPTURE_MAX_RECORD_DATA     (CAPTURE_BLOCK_SIZE - sizeof(sCaptureBlockHeader_t) - sizeof(sCaptureRecordHeader_t))
+// free block buffers kept for reuse
+#define CAPTURE_FREE_BLOCKS_POOL    16
+
+cCaptureWriter::cCaptureWriter(QObject *parent) :
+    cBufferedFileWriter("capture:", CAPTURE_MAX_QUEUED_BLOCKS, CAPTURE_FREE_BLOCKS_POOL, 0, parent),
+    m_u32BlockLen(0),
+    m_u32BlockRecords(0),
+    m_u64BlockFirstNs(0),
+    m_u64BlockLastNs(0),
+    m_u64FileOffset(0),
+    m_u64LastIndexOffset(0)
+{
+}
+
+cCaptureWriter::~cCaptureWriter() {
+    close();
+}
+
+bool cCaptureWriter::open(const QString &qsFileName, QString *pqsError) {
+    close();
+
+    m_file.setFileName(qsFileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *pqsError = tr("Can't create capture file %1: %2").arg(qsFileName, m_file.errorString());
+        return false;
+    }
+
+    sCaptureFileHeader_t sHeader;
+    memcpy(sHeader.cMagic, CAPTURE_FILE_MAGIC, sizeof(sHeader.cMagic));
+    sHeader.u16Version = CAPTURE_FILE_VERSION;
+    sHeader.u16HeaderLen = sizeof(sCaptureFileHeader_t);
+    sHeader.u32BlockSize = CAPTURE_BLOCK_SIZE;
+    sHeader.i64StartUtcMs = QDateTime::currentMSecsSinceEpoch();
+    m_start = std::chrono::steady_clock::now();
+
+    if (m_file.write((const char *)&sHeader, sizeof(sHeader)) != sizeof(sHeader)) {
+        *pqsError = tr("Can't write capture file %1: %2").arg(qsFileName, m_file.errorString());
+        m_file.close();
+        return false;
+    }
+
+    m_u64FileOffset = sizeof(sHeader);
+    m_u64LastIndexOffset = 0;
+    m_pendingIndex.clear();
+    m_pendingIndex.reserve(CAPTURE_INDEX_INTERVAL);
+    memset(m_au8RxPorts, 0, sizeof(m_au8RxPorts));
+    m_block.resize(CAPTURE_BLOCK_SIZE);
+    m_u32BlockLen = 0;
+    m_u32BlockRecords = 0;
+
+    startWriter();
+
+    return true;
+}
+
+void cCaptureWriter::close(void) {
+    if (!m_file.isOpen())
+        return;
+
+    handOver();
+    stopWriter();
+
+    m_file.close();
+    m_block.clear();
+}
+
+void cCaptureWriter::startBlock(uint64_t u64Ns) {
+    m_u32BlockLen = sizeof(sCaptureBlockHeader_t);
+    m_u32BlockRecords = 0;
+    m_u64BlockFirstNs = u64Ns;
+    m_u64BlockLastNs = u64Ns;
+}
+
+void cCaptureWriter::record(uint8_t u8Flags, uint8_t u8PortId, const uint8_t *pu8Data, uint32_t u32Len) {
+    // the file is broken already, see writeFailed()
+    if (writeFailed())
+        return;
+
+    uint64_t u64Ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+
+    // one record per chunk unless it is too big for a block
+    do {
+        uint32_t u32Part = (u32Len > CAPTURE_MAX_RECORD_DATA) ? CAPTURE_MAX_RECORD_DATA : u32Len;
+
+        if ((m_u32BlockRecords != 0) &&
+            ((m_u32BlockLen + sizeof(sCaptureRecordHeader_t) + u32Part > CAPTURE_BLOCK_SIZE) ||
+             (u64Ns - m_u64BlockFirstNs > UINT32_MAX)))
+            handOver();
+
+        if (m_u32BlockRecords == 0)
+            startBlock(u64Ns);
+
+        uint8_t *pu8Block = (uint8_t *)m_block.data();
+
+        sCaptureRecordHeader_t sRecord;
+        sRecord.u32DeltaNs = (uint32_t)(u64Ns - m_u64BlockFirstNs);
+        sRecord.u8Flags = u8Flags;
+        sRecord.u8PortId = u8PortId;
+        sRecord.u16Len = (uint16_t)u32Part;
+        memcpy(pu8Block + m_u32BlockLen, &sRecord, sizeof(sRecord));
+        if (u32Part != 0)
+            memcpy(pu8Block + m_u32BlockLen + sizeof(sRecord), pu8Data, u32Part);
+
+        m_u32BlockLen += sizeof(sRecord) + u32Part;
+        m_u32BlockRecords++;
+        m_u64BlockLastNs = u64Ns;
+
+        pu8Data += u32Part;
+        u32Len -= u32Part;
+    } while (u32Len != 0);
+}
+
+void cCaptureWriter::handOver(void) {
+    if (m_u32BlockRecords == 0)
+        return;
+
+    sCaptureBlockHeader_t sHeader;
+    sHeader.u32Magic = CAPTURE_BLOCK_MAGIC;
+    sHeader.u16Type = eCaptureBlockData;
+    sHeader.u16Reserved = 0;
+    sHeader.u32Length = m_u32BlockLen - sizeof(sCaptureBlockHeader_t);
+    sHeader.u32Records = m_u32BlockRecords;
+    sHeader.u64FirstNs = m_u64BlockFirstNs;
+    sHeader.u64LastNs = m_u64BlockLastNs;
+    memcpy(m_block.data(), &sHeader, sizeof(sHeader));
+
+    // the block buffer always has CAPTURE_BLOCK_SIZE bytes, the used length travels in its header;
+    // a dropped block is just filled again
+    if (queue(&m_block) && m_block.size() != CAPTURE_BLOCK_SIZE)
+        m_block = QByteArray(CAPTURE_BLOCK_SIZE, 0);
+
+    m_u32BlockRecords = 0;
+    m_u32BlockLen = 0;
+}
+
+bool cCaptureWriter::writeBlock(uint16_t u16Type, uint32_t u32Records, uint64_t u64FirstNs, uint64_t u64LastNs,
+                                const void *pData, uint32_t u32Len) {
+    sCaptureBlockHeader_t sHeader;
+    sHeader.u32Magic = CAPTURE_BLOCK_MAGIC;
+    sHeader.u16Type = u16Type;
+    sHeader.u16Reserved = 0;
+    sHeader.u32Length = u32Len;
+    sHeader.u32Records = u32Records;
+    sHeader.u64FirstNs = u64FirstNs;
+    sHeader.u64LastNs = u64LastNs;
+
+    // m_u64FileOffset is the end of the last complete block
+    if (!writeData(&sHeader, sizeof(sHeader), m_u64FileOffset) || !writeData(pData, u32Len, m_u64FileOffset))
+        return false;
+
+    m_u64FileOffset += sizeof(sHeader) + u32Len;
+
+    return true;
+}
+
+bool cCaptureWriter::writeIndex(void) {
+    if (m_pendingIndex.empty())
+        return true;
+
+    QByteArray baIndex;
+    baIndex.append((const char *)&m_u64LastIndexOffset, sizeof(m_u64LastIndexOffset));
+    baIndex.append((const char *)m_pendingIndex.data(), m_pendingIndex.size() * sizeof(sCaptureIndexEntry_t));
+
+    m_u64LastIndexOffset = m_u64FileOffset;
+    bool bWritten = writeBlock(eCaptureBlockIndex, m_pendingIndex.size(), m_pendingIndex.front().u64FirstNs,
+                               m_pendingIndex.back().u64FirstNs, baIndex.constData(), baIndex.size());
+
+    m_pendingIndex.clear();
+
+    return bWritten;
+}
+
+bool cCaptureWriter::writeBuffer(const QByteArray &baBuffer) {
+    const sCaptureBlockHeader_t *psHeader = (const sCaptureBlockHeader_t *)baBuffer.constData();
+
+    uint32_t u32BlockLen = sizeof(sCaptureBlockHeader_t) + psHeader->u32Length;
+    if (!writeData(baBuffer.constData(), u32BlockLen, m_u64FileOffset))
+        return false;
+
+    m_pendingIndex.push_back({psHeader->u64FirstNs, m_u64FileOffset});
+    m_u64FileOffset += u32BlockLen;
+    addRxPorts(baBuffer);
+
+    if (m_pendingIndex.size() == CAPTURE_INDEX_INTERVAL)
+        writeIndex();
+
+    return true;
+}
+
+void cCaptureWriter::addRxPorts(const QByteArray &baBlock) {
+    // only blocks that reached the disk count, the set matches what a reader finds by scanning the records
+    const sCaptureBlockHeader_t *psHeader = (const sCaptureBlockHeader_t *)baBlock.constData();
+    const uint8_t *pu8Record = (const uint8_t *)baBlock.constData() + sizeof(sCaptureBlockHeader_t);
+    const uint8_t *pu8End = pu8Record + psHeader->u32Length;
+
+    while (pu8Record < pu8End) {
+        sCaptureRecordHeader_t sRecord;
+        memcpy(&sRecord, pu8Record, sizeof(sRecord));
+
+        if (!(sRecord.u8Flags & (CAPTURE_FLAG_TX | CAPTURE_FLAGS_CONTROL)))
+            m_au8RxPorts[sRecord.u8PortId >> 3] |= 1u << (sRecord.u8PortId & 7);
+
+        pu8Record += sizeof(sRecord) + sRecord.u16Len;
+    }
+}
+
+void cCaptureWriter::writeTail(void) {
+    // only after a clean session: a trailer would make the reader trust an index over a partly written block
+    if (!writeIndex())
+        return;
+
+    uint8_t au8Trailer[sizeof(uint64_t) + CAPTURE_PORT_SET_SIZE];
+    memcpy(au8Trailer, &m_u64LastIndexOffset, sizeof(m_u64LastIndexOffset));
+    memcpy(au8Trailer + sizeof(m_u64LastIndexOffset), m_au8RxPorts, sizeof(m_au8RxPorts));
+
+    writeBlock(eCaptureBlockTrailer, 0, 0, 0, au8Trailer, sizeof(au8Trailer));
+}
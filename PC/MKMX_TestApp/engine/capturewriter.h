@@ -0,0 +1,74 @@
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <QByteArray>
+
+#include <chrono>
+#include <vector>
+
+#include <stdint.h>
+
+#include "bufferedfilewriter.h"
+#include "capturefile.h"
+
+// at most this many blocks wait for the disk, further blocks are dropped (and counted)
+// rather than stalling the interface thread
+#define CAPTURE_MAX_QUEUED_BLOCKS   256
+// [ms] how long a partly filled block may wait before the producer hands it over
+#define CAPTURE_HANDOVER_INTERVAL   500
+
+// Writes a capture file (capturefile.h) from its own thread (cBufferedFileWriter).
+// The producer fills a block in memory with record() and hands complete blocks over,
+// the writer thread takes everything queued at once and writes it out in one batch.
+class cCaptureWriter : public cBufferedFileWriter
+{
+    Q_OBJECT
+
+public:
+    cCaptureWriter(QObject *parent = nullptr);
+    ~cCaptureWriter();
+
+    bool open(const QString &qsFileName, QString *pqsError);
+    // hands over what is left, waits until it is on the disk and closes the file
+    void close(void);
+
+    bool isOpen(void) const { return m_file.isOpen(); }
+    QString fileName(void) const { return m_file.fileName(); }
+
+    // producer side: call from one thread only (the interface thread)
+    void record(uint8_t u8Flags, uint8_t u8PortId, const uint8_t *pu8Data, uint32_t u32Len);
+    // queues the current block even if it is not full, called periodically so an idle session reaches the disk too
+    void handOver(void);
+
+    // droppedBuffers(), writeFailed() and lostBuffers() count blocks; after a failed write the file
+    // has no trailer, the reader rescans it
+
+private:
+    // block being filled by the producer
+    QByteArray m_block;
+    uint32_t m_u32BlockLen;
+    uint32_t m_u32BlockRecords;
+    uint64_t m_u64BlockFirstNs;
+    uint64_t m_u64BlockLastNs;
+
+    std::chrono::steady_clock::time_point m_start;
+
+    // writer thread only
+    uint64_t m_u64FileOffset;
+    uint64_t m_u64LastIndexOffset;
+    std::vector<sCaptureIndexEntry_t> m_pendingIndex;
+    // ports with RX records in the written blocks, for the trailer
+    uint8_t m_au8RxPorts[CAPTURE_PORT_SET_SIZE];
+
+    void startBlock(uint64_t u64Ns);
+    bool writeBlock(uint16_t u16Type, uint32_t u32Records, uint64_t u64FirstNs, uint64_t u64LastNs,
+                    const void *pData, uint32_t u32Len);
+    bool writeIndex(void);
+    void addRxPorts(const QByteArray &baBlock);
+
+    bool writeBuffer(const QByteArray &baBuffer);
+    // index and trailer
+    void writeTail(void);
+};
+
+#endif // CAPTUREWRITER_H
@@ -2,19 +2,27 @@
 
 #include <QSettings>
 #include <QMessageBox>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
 
-#include "utils/crctools.h"
+#include <vector>
 
 #include "interface.h"
+#include "serialtransport.h"
+#include "capturewriter.h"
+#include "capturereader.h"
+#include "framearchive.h"
+
+#ifdef MKMX_HAVE_REACTOR
+    #include "reactor.h"
+#endif
 
 #include "version.h"
 
-#define DEBUG_ENGINE
+#include <QDebug>
 
-//#ifdef DEBUG_ENGINE
-    #include <QDebug>
-    #include "utils/debugtools.h"
-//#endif
+#include "utils/tracetools.h"
 
 #define BINARY_DEBUG_DATA_COMMAND	'g'
 #define TEXT_DEBUG_DATA_COMMAND		't'
@@ -28,22 +36,56 @@
 #define READ_DATA_SAMPLES_AT_ONCE       1
 #define READ_DATA_BASE_TIMEOUT_PERIOD   15
 
+#define REACTOR_PORT_SPEC   "reactor:"
+
+// well above the 16 ms latency timer of common USB adapters at 4800 Bd, far below a frame time
+#define INTER_BYTE_TIMEOUT_DEFAULT_CHARS    20
+
 cEngine::cEngine(QObject *parent) :
     QObject(parent),
-    eRxState(eStart0x5A),
-    dataInterface(nullptr)
+    dataInterface(nullptr),
+    interByteTimeoutChars(INTER_BYTE_TIMEOUT_DEFAULT_CHARS),
+    reactor(nullptr),
+    capture(nullptr),
+    archive(nullptr),
+    logSink(nullptr)
 {
+    initPlaybackControl(&playback);
+
     incommingDataInterfaceResetInternalState();
 }
 
 void cEngine::readSettings(QSettings *settings) {
-    Q_UNUSED(settings);
+    // not written back: the command line (main.cpp) may override it for one run only
+    captureDirectory = settings->value("captureDirectory", "").toString();
+    archiveDirectory = settings->value("archiveDirectory", "").toString();
+    interByteTimeoutChars = settings->value("interByteTimeoutChars", INTER_BYTE_TIMEOUT_DEFAULT_CHARS).toUInt();
+
+    logSinkConfig.qsDirectory = settings->value("logDirectory", "").toString();
+    logSinkConfig.u32RotateBytes = qMin(settings->value("logRotateMB", 64).toUInt(), 4095u) << 20;
+    logSinkConfig.u32RotateSeconds = settings->value("logRotateMinutes", 60).toUInt() * 60;
+    logSinkConfig.bBinary = settings->value("logBinary", false).toBool();
+    logSinkConfig.bCompress = settings->value("logCompress", false).toBool();
 }
 
 void cEngine::writeSettings(QSettings *settings) {
     Q_UNUSED(settings);
 }
 
+QString cEngine::captureFileName(void) {
+    if (capture != nullptr)
+        return capture->fileName();
+
+    return QString();
+}
+
+QString cEngine::archiveFileName(void) {
+    if (archive != nullptr)
+        return archive->fileName();
+
+    return QString();
+}
+
 void cEngine::incommingDataInterfaceConnected(void) {
     qDebug() << "ENGINE: incommingDataInterfaceConnected()";
 
@@ -56,6 +98,9 @@ void cEngine::incommingDataInterfaceConnected(void) {
 }
 
 void cEngine::incommingDataInterfaceError(const QString &qsError) {
+    // the GUI shows it in a message box, not in the log window
+    logText(tr("Error: %1").arg(qsError), false);
+
     emit incommingDataInterfaceTriggersError(qsError);
 }
 
@@ -68,34 +113,73 @@ void cEngine::incommingDataInterfaceDisconnected(void) {
     closeIncommingDataInterface();
 }
 
-bool cEngine::checkFrameCRC(sRxFrame_t *frame) {
+bool cEngine::txData(int iPortId, uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint32_t u32Len) {
+#ifdef MKMX_HAVE_REACTOR
+    // every port is a bus of its own, the frame goes to the chosen one only
+    if (reactor != nullptr)
+        return reactor->txData(iPortId, u8Addr, u8Cmd, pu8Payload, u32Len);
+#endif
 
-    uint8_t crc = 0, i;
-    for (i = 0; i < frame->u8Len + 3; i++)
-        crc = _crc8_ccitt_update(crc, frame->u8RawData[i]);
+    if ((dataInterface == nullptr) || (iPortId != 0))
+        return false;
+
+    return dataInterface->txData(u8Addr, u8Cmd, pu8Payload, u32Len);
+}
 
-#ifdef DEBUG_ENGINE
-        qDebug() << "ENGINE checkFrameCRC => computed for rxed data: " << u8ToString(crc) << ", embedded within the frame: " << u8ToString(frame->u8CRC);
+bool cEngine::txData(int iPortId, uint8_t u8Addr, uint8_t u8Cmd, const QByteArray &baData) {
+    return txData(iPortId, u8Addr, u8Cmd, (const uint8_t *)baData.constData(), baData.length());
+}
+
+QStringList cEngine::portNames(void) const {
+    QStringList qsPortNames;
+
+#ifdef MKMX_HAVE_REACTOR
+    if (reactor != nullptr) {
+        for (int iPortId = 0; iPortId < reactor->portsCount(); iPortId++)
+            qsPortNames.append(reactor->portName(iPortId));
+
+        return qsPortNames;
+    }
 #endif
 
-    return (crc == frame->u8CRC);
+    if (dataInterface != nullptr)
+        qsPortNames.append(dataInterface->serialPortName());
+
+    return qsPortNames;
 }
 
-bool cEngine::txData(uint8_t u8Addr, uint8_t u8Cmd, QByteArray baData) {
-    return dataInterface->txData(u8Addr, u8Cmd, baData);
+void cEngine::incommingDataInterfaceDiscontinuity(void) {
+    // called from the interface thread, between two newData() calls
+    incommingDataInterfaceResetInternalState();
 }
 
 void cEngine::incommingDataInterfaceResetInternalState(void) {
-    eRxState = eStart0x5A;
+    rxDecoder.reset();
 }
 
-void cEngine::parseFrame(sRxFrame_t *frame) {
+void cEngine::logText(const QString &qsText, bool bShow) {
+    if (logSink != nullptr) {
+        QByteArray baText = qsText.toUtf8();
+        logSink->append(baText.constData(), baText.size());
+    }
+
+    if (bShow)
+        emit newDebugVariableText(qsText);
+}
+
+void cEngine::parseFrame(const sRxFrame_t *frame, const QString &qsSource) {
     if (frame->u8Cmd == TEXT_DEBUG_DATA_COMMAND) {
-        char cText[512];
-        memcpy(cText, frame->u8Payload, frame->u8Len);
-        cText[frame->u8Len] = '\0';
+        // text ends at the first zero, if any
+        const char *pcText = (const char *)frame->u8Payload;
+        QByteArray baText(pcText, qstrnlen(pcText, frame->u8Len));
 
-        emit newDebugVariableText(QString(cText));
+        if (logSink != nullptr)
+            logSink->append(frame->u8DestAddr, frame->u8Cmd, baText.constData(), baText.size());
+
+        if (qsSource.isEmpty())
+            emit newDebugFrameText(frame->u8DestAddr, frame->u8Cmd, baText);
+        else
+            emit newDebugVariableText(QString("[%1] %2").arg(qsSource, QString::fromUtf8(baText)));
     } else {
 //        emit incommingDataInterfaceError(trUtf8("Odebrano ramkę z kodem ID o nieoczekiwanej wartości ?! Wartość kodu ID: %1 (hex: %2)... To nie powinno się zdarzyć !")
 //                                         .arg(QString::number(frame->u8Cmd),
@@ -105,114 +189,166 @@ void cEngine::parseFrame(sRxFrame_t *frame) {
     }
 }
 
-void cEngine::incommingInterfaceDataRxed(QByteArray baData) {
-    static uint8_t u8RxPayloadDataCnt = 0, u8PayloadLen = 0;
-    static uint16_t u16RawDataCnt = 0;
-    static sRxFrame_t rxFrame;
+void cEngine::incommingInterfaceDataRxed(const QByteArray &baData, quint64 u64RxNs) {
+    sessionMetrics.rxBytes(baData.length());
 
-    while (!baData.isEmpty()) {
-        uint8_t u8Data = baData.at(0);
-        baData.remove(0, 1);
-#ifdef DEBUG_ENGINE
-        qDebug() << "eRxState " << eRxState << "u8Data" << u8ToString(u8Data);
-#endif
-        switch (eRxState) {
-        case eStart0x5A:
-            if (u8Data == 0x5A) {
-                eRxState = eStart0xA5;
-                u16RawDataCnt = 0;
-                u8RxPayloadDataCnt = 0;
-            }
-            break;
+    rxDecoder.feed((const uint8_t *)baData.constData(), baData.length(), u64RxNs, dataInterface->characterTimeNs(), interByteTimeoutChars,
+                   [this](eDecoderResult_t eResult) {
+        switch (eResult) {
+        case eDecoderFrameReady: {
+            const sRxFrame_t *rxFrame = rxDecoder.frame();
+            TRACE_DEBUG(eTraceEngineFrame, rxFrame->u8DestAddr, rxFrame->u8Cmd, rxFrame->u8Len);
 
-        case eStart0xA5:
-            if (u8Data == 0xA5) {
-                rxFrame.u16Start = 0x5AA5;
-                eRxState = eDestAddr;
-            } else {
-                eRxState = eStart0x5A;
-            }
-            break;
+            sessionMetrics.frame(rxFrame->u8DestAddr, rxFrame->u8Cmd);
 
-        case eDestAddr:
-            rxFrame.u8DestAddr = u8Data;
-            rxFrame.u8RawData[u16RawDataCnt++] = u8Data;
-            eRxState = eCommand;
-            break;
+            if (archive != nullptr)
+                archive->append(archive->nowUs(), dataInterface->portId(), rxFrame);
 
-        case eCommand:
-            rxFrame.u8Cmd = u8Data;
-            rxFrame.u8RawData[u16RawDataCnt++] = u8Data;
-            eRxState = ePayloadLen;
+            parseFrame(rxFrame);
             break;
+        }
 
-        case ePayloadLen:
-            rxFrame.u8Len = u8Data;
-            rxFrame.u8RawData[u16RawDataCnt++] = u8Data;
-
-            if (rxFrame.u8Len <= MAX_PAYLOAD_LENGTH) {
-                if (rxFrame.u8Len != 0) {
-                    u8PayloadLen = rxFrame.u8Len;
-
-                    eRxState = ePayload;
-                } else {
-                    eRxState = eCRC;
-                }
-            } else {
-                qDebug() << "MAX PAYLOAD ERROR!!!";
-                //ERROR!!!
-                eRxState = eStart0x5A;
-            }
+        case eDecoderCrcError:
+            TRACE_ERROR(eTraceEngineCrcError, rxDecoder.frame()->u8DestAddr, rxDecoder.frame()->u8Cmd, rxDecoder.frame()->u8CRC);
             break;
 
-        case ePayload:
-            rxFrame.u8Payload[u8RxPayloadDataCnt++] = u8Data;
-            rxFrame.u8RawData[u16RawDataCnt++] = u8Data;
-
-            if (--u8PayloadLen == 0) {
-                rxFrame.u8CRC = 0;
-                eRxState = eCRC;
-            }
+        case eDecoderMaxPayloadError:
+            TRACE_ERROR(eTraceEngineMaxPayloadError, rxDecoder.frame()->u8DestAddr, rxDecoder.frame()->u8Cmd, rxDecoder.frame()->u8Len);
             break;
 
-        case eCRC:
-            rxFrame.u8CRC = u8Data;
+        case eDecoderTimeout:
+            TRACE_ERROR(eTraceEngineInterByteTimeout, rxDecoder.frame()->u8DestAddr, rxDecoder.frame()->u8Cmd, rxDecoder.frame()->u8Len);
+            break;
 
-#ifdef DEBUG_ENGINE
-            qDebug() << "FULL FRAME";
-            qDebug() << "  cmd:     " << u8ToString(rxFrame.u8Cmd);
-            qDebug() << "  adr:     " << u8ToString(rxFrame.u8DestAddr);
-            qDebug() << "  len:     " << u8ToString(rxFrame.u8Len) << "(" << rxFrame.u8Len << "bajtów )";
-            qDebug() << "  payload: " << pu8ToString(rxFrame.u8Payload, rxFrame.u8Len);
-            qDebug() << "  crc:     " << u8ToString(rxFrame.u8CRC);
-#endif
-            if (checkFrameCRC(&rxFrame)) {
-               parseFrame(&rxFrame);
-            } else {
-                //ERROR!
-                qDebug() << "CRC ERROR!!!";
-            }
-
-            eRxState = eStart0x5A;
+        case eDecoderNeedMoreData:
             break;
         }
-    }
+    });
+
+    sessionMetrics.decoderStats(rxDecoder.stats());
 }
 
 bool cEngine::isIncommingDataInterfaceConnected(void) {
+#ifdef MKMX_HAVE_REACTOR
+    // connected while any port survives, a dropped port only reports its error
+    if (reactor != nullptr)
+        return reactor->isOnline();
+#endif
+
     if (dataInterface != nullptr)
         return dataInterface->isOnline();
     else
         return false;
 }
 
+void cEngine::openSessionOutputs(void) {
+    QString qsSessionName = QString("mkmx_%1").arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
+
+    // first, so it keeps the errors of the other outputs
+    if (!logSinkConfig.qsDirectory.isEmpty()) {
+        QString qsError;
+
+        logSink = new cLogSink(this);
+        if (!logSink->open(logSinkConfig, qsSessionName, &qsError)) {
+            delete logSink;
+            logSink = nullptr;
+
+            logText(qsError);
+        }
+    }
+
+    if (!captureDirectory.isEmpty()) {
+        QString qsError;
+        QString qsFileName = QDir(captureDirectory).filePath(qsSessionName + ".mkcap");
+
+        capture = new cCaptureWriter(this);
+        if (!capture->open(qsFileName, &qsError)) {
+            // the session still runs, only without a capture
+            logText(qsError);
+
+            delete capture;
+            capture = nullptr;
+        }
+    }
+
+    if (!archiveDirectory.isEmpty()) {
+        QString qsError;
+
+        // frames are appended from the I/O thread, see incommingInterfaceDataRxed() and reactorFrameRxed()
+        archive = new cFrameArchive;
+        if (!archive->create(QDir(archiveDirectory).filePath(qsSessionName + ".mkfa"), &qsError)) {
+            logText(qsError);
+
+            delete archive;
+            archive = nullptr;
+        }
+    }
+}
+
+void cEngine::closeSessionOutputs(void) {
+    // the I/O thread has finished, nobody records any more
+    if (capture != nullptr) {
+        capture->close();
+
+        if (capture->droppedBuffers() != 0)
+            qDebug() << "capture: dropped blocks:" << capture->droppedBuffers();
+        if (capture->writeFailed())
+            logText(tr("Capture %1: write failed, lost blocks: %2").arg(capture->fileName()).arg(capture->lostBuffers()));
+
+        delete capture;
+        capture = nullptr;
+    }
+
+    if (logSink != nullptr) {
+        logSink->close();
+
+        if (logSink->droppedBuffers() != 0)
+            qDebug() << "log sink: dropped buffers:" << logSink->droppedBuffers();
+        if (logSink->writeFailed())
+            logText(tr("Log sink: write failed, lost buffers: %1").arg(logSink->lostBuffers()));
+
+        delete logSink;
+        logSink = nullptr;
+    }
+
+    // writes the index
+    if (archive != nullptr) {
+        delete archive;
+        archive = nullptr;
+    }
+}
+
 void cEngine::openIncommingDataInterface(const QString &qsPortName, int iWaitTimeout) {
+    if (qsPortName.startsWith(REACTOR_PORT_SPEC)) {
+        QString qsError;
+        QStringList qsPortNames = qsPortName.mid(strlen(REACTOR_PORT_SPEC)).split(',', QString::SkipEmptyParts);
+
+        if (openReactorPorts(qsPortNames, SERIAL_TRANSPORT_BAUD_RATE, &qsError)) {
+            emit incommingDataInterfaceBecomesOnline(qsPortName);
+        } else {
+            logText(tr("Error: %1").arg(qsError), false);
+            emit incommingDataInterfaceTriggersError(qsError);
+        }
+
+        return;
+    }
+
     dataInterface = new cInterface(this);
 
     connect(dataInterface, SIGNAL(connected()), this, SLOT(incommingDataInterfaceConnected()));
     connect(dataInterface, SIGNAL(error(QString)), this, SLOT(incommingDataInterfaceError(QString)));
     connect(dataInterface, SIGNAL(disconnected()), this, SLOT(incommingDataInterfaceDisconnected()));
-    connect(dataInterface, SIGNAL(newData(QByteArray)), this, SLOT(incommingInterfaceDataRxed(QByteArray)), Qt::DirectConnection);
+    connect(dataInterface, SIGNAL(newData(QByteArray,quint64)), this, SLOT(incommingInterfaceDataRxed(QByteArray,quint64)), Qt::DirectConnection);
+    connect(dataInterface, SIGNAL(discontinuity()), this, SLOT(incommingDataInterfaceDiscontinuity()), Qt::DirectConnection);
+
+    // the previous interface thread has finished, nobody updates the counters now
+    rxDecoder.resetStats();
+    sessionMetrics.reset();
+    dataInterface->setMetrics(&sessionMetrics);
+    dataInterface->setPlaybackControl(&playback);
+
+    openSessionOutputs();
+    dataInterface->setCapture(capture);
 
     dataInterface->start(qsPortName, iWaitTimeout);
 }
@@ -220,7 +356,7 @@ void cEngine::openIncommingDataInterface(const QString &qsPortName, int iWaitTim
 void cEngine::closeIncommingDataInterface(void) {
     bool bEmitOfflineSignal = false;
 
-    if ((dataInterface != nullptr))
+    if ((dataInterface != nullptr) || (reactor != nullptr))
         bEmitOfflineSignal = true;
 
     if (dataInterface != nullptr) {
@@ -235,6 +371,171 @@ void cEngine::closeIncommingDataInterface(void) {
         }
     }
 
+    closeReactorPorts();
+
+    closeSessionOutputs();
+
     if (bEmitOfflineSignal)
         emit incommingDataInterfaceBecomesOffline();
+
+#if TRACE_LEVEL > TRACE_LEVEL_NONE
+    traceDumpToDebug();
+#endif
+}
+
+bool cEngine::replayCapture(const QString &qsFileName, sReplayStats_t *psStats, QString *pqsError) {
+    cCaptureReader reader;
+    if (!reader.open(qsFileName, pqsError))
+        return false;
+
+    memset(psStats, 0, sizeof(*psStats));
+
+    // every port had its own decoder in the live session, the character time comes from its line record
+    // (none in version 1 captures: no gap check, like a transport without a line speed)
+    std::vector<cFrameDecoder> decoders(256);
+    std::vector<uint64_t> characterNs(256, 0);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    sCaptureRecord_t sRecord;
+    while (reader.nextRecord(&sRecord)) {
+        cFrameDecoder &decoder = decoders[sRecord.u8PortId];
+
+        if (sRecord.u8Flags & CAPTURE_FLAG_LINE) {
+            uint32_t u32CharacterNs = 0;
+            if (sRecord.u32Len >= sizeof(u32CharacterNs))
+                memcpy(&u32CharacterNs, sRecord.pu8Data, sizeof(u32CharacterNs));
+
+            characterNs[sRecord.u8PortId] = u32CharacterNs;
+            continue;
+        }
+
+        // the live session reset its decoder here (see incommingDataInterfaceDiscontinuity())
+        if (sRecord.u8Flags & CAPTURE_FLAG_RESET) {
+            decoder.reset();
+            continue;
+        }
+
+        if (sRecord.u8Flags & CAPTURE_FLAG_TX)
+            continue;
+
+        // the record time is taken where the live session read the chunk, so the same gaps time out;
+        // frames are only counted: parseFrame() would feed the log sink and the log window of the live session
+        decoder.feed(sRecord.pu8Data, sRecord.u32Len, sRecord.u64TimeNs, characterNs[sRecord.u8PortId], interByteTimeoutChars,
+                     [](eDecoderResult_t) {});
+
+        psStats->u64Records++;
+        psStats->u64Bytes += sRecord.u32Len;
+    }
+
+    psStats->dSeconds = timer.nsecsElapsed() / 1e9;
+    psStats->bComplete = reader.isComplete();
+
+    for (const cFrameDecoder &decoder : decoders)
+        decoder.addStats(&psStats->sDecoder);
+
+    return true;
+}
+
+bool cEngine::openReactorPorts(const QStringList &qsPortNames, int iBaudRate, QString *pqsError) {
+#ifdef MKMX_HAVE_REACTOR
+    // the outputs of a previous session must be closed before openSessionOutputs() replaces them
+    closeIncommingDataInterface();
+
+    if (qsPortNames.isEmpty()) {
+        *pqsError = tr("No ports for the reactor, use %1<port>,<port>,...").arg(REACTOR_PORT_SPEC);
+        return false;
+    }
+
+    reactor = new cReactor(this);
+
+    if (!reactor->isValid()) {
+        *pqsError = reactor->errorString();
+
+        delete reactor;
+        reactor = nullptr;
+
+        return false;
+    }
+
+    foreach (const QString &qsPortName, qsPortNames) {
+        if (reactor->addPort(qsPortName, iBaudRate, pqsError) < 0) {
+            delete reactor;
+            reactor = nullptr;
+
+            return false;
+        }
+    }
+
+    // the same session as with a single interface, the port id of a record is the reactor port
+    sessionMetrics.reset();
+    openSessionOutputs();
+
+    reactor->setCapture(capture);
+    reactor->setMetrics(&sessionMetrics);
+    reactor->setInterByteTimeout(interByteTimeoutChars);
+
+    // frames are handed over from the reactor thread and are valid only during the call
+    connect(reactor, &cReactor::frameReceived, this, &cEngine::reactorFrameRxed, Qt::DirectConnection);
+    connect(reactor, &cReactor::portError, this, &cEngine::reactorPortError);
+
+    reactor->start();
+
+    return true;
+#else
+    Q_UNUSED(qsPortNames);
+    Q_UNUSED(iBaudRate);
+
+    *pqsError = tr("Reactor mode is available on Linux only");
+
+    return false;
+#endif
+}
+
+void cEngine::closeReactorPorts(void) {
+#ifdef MKMX_HAVE_REACTOR
+    if (reactor != nullptr) {
+        disconnect(reactor, nullptr, nullptr, nullptr);
+
+        reactor->stop();
+
+        delete reactor;
+        reactor = nullptr;
+    }
+#endif
+}
+
+void cEngine::reactorFrameRxed(int iPortId, const sRxFrame_t *frame) {
+#ifdef MKMX_HAVE_REACTOR
+    TRACE_DEBUG(eTraceEngineFrame, frame->u8DestAddr, frame->u8Cmd, frame->u8Len);
+
+    sessionMetrics.frame(frame->u8DestAddr, frame->u8Cmd);
+
+    if (archive != nullptr)
+        archive->append(archive->nowUs(), iPortId, frame);
+
+    parseFrame(frame, reactor->portName(iPortId));
+#else
+    Q_UNUSED(iPortId);
+    Q_UNUSED(frame);
+#endif
+}
+
+void cEngine::reactorPortError(int iPortId, const QString &qsError) {
+#ifdef MKMX_HAVE_REACTOR
+    // queued from the reactor thread, the session may be closed meanwhile
+    if (reactor == nullptr)
+        return;
+
+    // one broken adapter must not take the other ports down, just report it
+    logText(tr("[%1] port error: %2").arg(reactor->portName(iPortId), qsError));
+
+    // the session ends with its last port, like an interface whose port went away
+    if (!reactor->isOnline())
+        closeIncommingDataInterface();
+#else
+    Q_UNUSED(iPortId);
+    Q_UNUSED(qsError);
+#endif
 }
@@ -4,54 +4,92 @@
 #include <QObject>
 #include <QTimer>
 #include <QSettings>
+#include <QStringList>
 
 #include <stdint.h>
 
-class cInterface;
+#include "framedecoder.h"
+#include "playbacktransport.h"
+#include "logsink.h"
+#include "metrics.h"
 
-#define MAX_PAYLOAD_LENGTH  128
+class cInterface;
+class cReactor;
+class cCaptureWriter;
+class cFrameArchive;
+
+typedef struct {
+    uint64_t u64Records;        // RX records fed to the decoder
+    uint64_t u64Bytes;
+    sDecoderStats_t sDecoder;   // summed over all ports
+    double dSeconds;
+    bool bComplete;             // false when the capture ends with a damaged block
+} sReplayStats_t;
 
 class cEngine : public QObject
 {
     Q_OBJECT
-private:
-    typedef struct {
-        uint16_t u16Start;
-        uint8_t u8DestAddr;
-        uint8_t u8Cmd;
-        uint8_t u8Len;
-        uint8_t u8Payload[MAX_PAYLOAD_LENGTH];
-        uint8_t u8CRC;
-
-        uint8_t u8RawData[MAX_PAYLOAD_LENGTH + 3];
-    } sRxFrame_t;
-
-    typedef enum {
-        eStart0x5A = 0,
-        eStart0xA5,
-        eDestAddr,
-        eCommand,
-        ePayloadLen,
-        ePayload,
-        eCRC
-    } eRxState_t;
-
 public:
     cEngine(QObject *parent = nullptr);
 
-    bool txData(uint8_t u8Addr, uint8_t u8Cmd, QByteArray baData);
+    // iPortId picks the bus: an index into portNames(), always 0 for a single interface
+    bool txData(int iPortId, uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint32_t u32Len);
+    bool txData(int iPortId, uint8_t u8Addr, uint8_t u8Cmd, const QByteArray &baData);
+
+    // ports of the open session, one per reactor port or the single interface
+    QStringList portNames(void) const;
 
     void readSettings(QSettings *settings);
     void writeSettings(QSettings *settings);
 
+    // qsPortName is a transport specification (transport.h) or "reactor:<port>,<port>,..." for several
+    // serial ports serviced by one reactor thread (Linux only, frames are shown with their port name)
     void openIncommingDataInterface(const QString &qsPortName, int iWaitTimeout);
     void closeIncommingDataInterface(void);
 
     bool isIncommingDataInterfaceConnected(void);
 
+    // raw traffic of every session opened afterwards is captured to <dir>/mkmx_<date>_<time>.mkcap,
+    // empty directory disables capturing
+    void setCaptureDirectory(const QString &qsDirectory) { captureDirectory = qsDirectory; }
+    QString captureFileName(void);
+
+    // every frame decoded in a session opened afterwards is archived to <dir>/mkmx_<date>_<time>.mkfa
+    // (framearchive.h), empty directory disables archiving
+    void setArchiveDirectory(const QString &qsDirectory) { archiveDirectory = qsDirectory; }
+    QString archiveFileName(void);
+
+    // log lines of every session opened afterwards are streamed to disk (logsink.h)
+    void setLogSinkConfig(const sLogSinkConfig_t &sConfig) { logSinkConfig = sConfig; }
+    const sLogSinkConfig_t &getLogSinkConfig(void) const { return logSinkConfig; }
+
+    // feeds the RX records of a capture straight from the mapped file into the decoder, as fast as possible
+    // on the calling thread, with the inter-byte timeout and the decoder resets of the live session;
+    // frames are only counted, the live session is not touched
+    bool replayCapture(const QString &qsFileName, sReplayStats_t *psStats, QString *pqsError);
+
+    // speed, pause and seek of a session opened on a "play:<file>" port
+    sPlaybackControl_t *playbackControl(void) { return &playback; }
+
+    // a partial frame is dropped when nothing came for this many character times (0: never),
+    // applies to transports with a line speed only
+    void setInterByteTimeout(uint32_t u32Characters) { interByteTimeoutChars = u32Characters; }
+    uint32_t getInterByteTimeout(void) const { return interByteTimeoutChars; }
+
+    // counters of the live session, reset when it is opened
+    const cEngineMetrics *metrics(void) const { return &sessionMetrics; }
+
 private:
-    bool checkFrameCRC(sRxFrame_t *frame);
-    void parseFrame(sRxFrame_t *frame);
+    void parseFrame(const sRxFrame_t *frame, const QString &qsSource = QString());
+    // a line for the session log (log sink) and, with bShow, for the log window
+    void logText(const QString &qsText, bool bShow = true);
+
+    // capture, archive and log sink of a session, whichever is configured
+    void openSessionOutputs(void);
+    void closeSessionOutputs(void);
+
+    bool openReactorPorts(const QStringList &qsPortNames, int iBaudRate, QString *pqsError);
+    void closeReactorPorts(void);
 
 signals:
     void incommingDataInterfaceBecomesOnline(QString pn);
@@ -59,17 +97,36 @@ signals:
     void incommingDataInterfaceBecomesOffline(void);
 
     void newDebugVariableText(QString str);
+    // text frame of the live session, the GUI formats it only when it is shown
+    void newDebugFrameText(int iAddr, int iCmd, QByteArray baText);
 
 private slots:
     void incommingDataInterfaceConnected(void);
     void incommingDataInterfaceError(const QString &qsError);
     void incommingDataInterfaceDisconnected(void);
-    void incommingInterfaceDataRxed(const QByteArray baData);
+    void incommingInterfaceDataRxed(const QByteArray &baData, quint64 u64RxNs);
+    void incommingDataInterfaceDiscontinuity(void);
+
+    void reactorFrameRxed(int iPortId, const sRxFrame_t *frame);
+    void reactorPortError(int iPortId, const QString &qsError);
 
 private:
-    eRxState_t eRxState;
+    cFrameDecoder rxDecoder;
+    cEngineMetrics sessionMetrics;
 
     cInterface* dataInterface;
+    sPlaybackControl_t playback;
+    uint32_t interByteTimeoutChars;
+    cReactor* reactor;
+
+    QString captureDirectory;
+    cCaptureWriter* capture;
+
+    QString archiveDirectory;
+    cFrameArchive* archive;
+
+    sLogSinkConfig_t logSinkConfig;
+    cLogSink* logSink;
 
     void incommingDataInterfaceResetInternalState(void);
 };
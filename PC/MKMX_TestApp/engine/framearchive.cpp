@@ -0,0 +1,433 @@
+#include "framearchive.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <algorithm>
+
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+
+#define ARCHIVE_KEYS    65536
+
+static inline uint64_t align8(uint64_t u64Value) {
+    return (u64Value + 7) & ~(uint64_t)7;
+}
+
+static inline bool writeAll(QFile *file, const void *pData, uint64_t u64Len) {
+    return file->write((const char *)pData, u64Len) == (qint64)u64Len;
+}
+
+cFrameArchive::cFrameArchive() :
+    m_bWriting(false),
+    m_bStoredIndex(false),
+    m_pu8Window(nullptr),
+    m_u64WindowOffset(0),
+    m_u32WindowUsed(0),
+    m_u64FramesEnd(0),
+    m_i64LastUs(0),
+    m_pu8Map(nullptr),
+    m_u32Frames(0),
+    m_pu64Offsets(nullptr),
+    m_pu32Buckets(nullptr),
+    m_u32Buckets(0),
+    m_pu32Ids(nullptr)
+{
+    memset(&m_sHeader, 0, sizeof(m_sHeader));
+}
+
+cFrameArchive::~cFrameArchive() {
+    close();
+}
+
+bool cFrameArchive::create(const QString &qsFileName, QString *pqsError) {
+    close();
+
+    m_file.setFileName(qsFileName);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        *pqsError = QString("Can't create frame archive %1: %2").arg(qsFileName, m_file.errorString());
+        return false;
+    }
+
+    memcpy(m_sHeader.cMagic, ARCHIVE_FILE_MAGIC, sizeof(m_sHeader.cMagic));
+    m_sHeader.u16Version = ARCHIVE_FILE_VERSION;
+    m_sHeader.u16HeaderLen = sizeof(sArchiveFileHeader_t);
+    m_sHeader.u32BucketUs = ARCHIVE_BUCKET_US;
+    m_sHeader.i64StartUtcUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    m_start = std::chrono::steady_clock::now();
+
+    if (m_file.write((const char *)&m_sHeader, sizeof(m_sHeader)) != sizeof(m_sHeader) || !m_file.flush()) {
+        *pqsError = QString("Can't write frame archive %1: %2").arg(qsFileName, m_file.errorString());
+        m_file.close();
+        return false;
+    }
+
+    m_bWriting = true;
+    m_u64FramesEnd = sizeof(m_sHeader);
+    m_i64LastUs = m_sHeader.i64StartUtcUs;
+    m_keyLists.assign(ARCHIVE_KEYS, std::vector<uint32_t>());
+
+    if (!growWindow()) {
+        *pqsError = QString("Can't map frame archive %1: %2").arg(qsFileName, m_file.errorString());
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+int64_t cFrameArchive::nowUs(void) const {
+    return m_sHeader.i64StartUtcUs +
+           std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+bool cFrameArchive::growWindow(void) {
+    if (m_pu8Window != nullptr) {
+        m_file.unmap(m_pu8Window);
+        m_pu8Window = nullptr;
+    }
+
+    // the new window starts right at the end of the frames, so a frame never straddles two windows
+    m_u64WindowOffset = m_u64FramesEnd;
+    m_u32WindowUsed = 0;
+
+    // the blocks behind the window must exist before it is mapped: a store into a page the full disk
+    // can't back raises SIGBUS instead of failing
+#ifdef Q_OS_UNIX
+    if (posix_fallocate(m_file.handle(), m_u64WindowOffset, ARCHIVE_GROW_SIZE) != 0)
+        return false;
+#else
+    // SetEndOfFile() allocates them already
+    if (!m_file.resize(m_u64WindowOffset + ARCHIVE_GROW_SIZE))
+        return false;
+#endif
+
+    m_pu8Window = m_file.map(m_u64WindowOffset, ARCHIVE_GROW_SIZE);
+
+    return m_pu8Window != nullptr;
+}
+
+void cFrameArchive::addToBuckets(int64_t i64TimeUs) {
+    // every bucket up to this frame's one starts with this frame
+    while (m_sHeader.i64StartUtcUs + (int64_t)m_buckets.size() * m_sHeader.u32BucketUs <= i64TimeUs)
+        m_buckets.push_back(m_u32Frames);
+}
+
+void cFrameArchive::append(int64_t i64TimeUs, uint8_t u8PortId, const sRxFrame_t *frame) {
+    uint32_t u32Size = sizeof(sArchiveFrame_t) + frame->u8Len;
+
+    if (m_pu8Window == nullptr)
+        return;
+
+    // no space left: the archive stops at the last frame, close() still writes its index
+    if (m_u32WindowUsed + u32Size > ARCHIVE_GROW_SIZE && !growWindow()) {
+        qDebug() << "frame archive: can't grow" << m_file.fileName() << "- archive stopped";
+        return;
+    }
+
+    // the queries rely on the time order
+    if (i64TimeUs < m_i64LastUs)
+        i64TimeUs = m_i64LastUs;
+    m_i64LastUs = i64TimeUs;
+
+    sArchiveFrame_t sFrame;
+    sFrame.i64TimeUs = i64TimeUs;
+    sFrame.u8PortId = u8PortId;
+    sFrame.u8Addr = frame->u8DestAddr;
+    sFrame.u8Cmd = frame->u8Cmd;
+    sFrame.u8Len = frame->u8Len;
+
+    uchar *pu8Dst = m_pu8Window + m_u32WindowUsed;
+    memcpy(pu8Dst, &sFrame, sizeof(sFrame));
+    memcpy(pu8Dst + sizeof(sFrame), frame->u8Payload, frame->u8Len);
+
+    addToBuckets(i64TimeUs);
+    m_offsets.push_back(m_u64FramesEnd);
+    m_keyLists[(frame->u8DestAddr << 8) | frame->u8Cmd].push_back(m_u32Frames);
+    m_u32Frames++;
+
+    m_u32WindowUsed += u32Size;
+    m_u64FramesEnd += u32Size;
+}
+
+bool cFrameArchive::writeIndex(void) {
+    std::vector<sArchiveKey_t> keys;
+    uint32_t u32Ids = 0;
+
+    for (uint32_t u32Key = 0; u32Key < ARCHIVE_KEYS; u32Key++) {
+        if (m_keyLists[u32Key].empty())
+            continue;
+
+        sArchiveKey_t sKey;
+        sKey.u16Key = u32Key;
+        sKey.u16Reserved = 0;
+        sKey.u32First = u32Ids;
+        sKey.u32Count = m_keyLists[u32Key].size();
+        keys.push_back(sKey);
+
+        u32Ids += sKey.u32Count;
+    }
+
+    sArchiveTrailer_t sTrailer;
+    sTrailer.u32Magic = ARCHIVE_TRAILER_MAGIC;
+    sTrailer.u32Frames = m_u32Frames;
+    sTrailer.u64FramesEnd = m_u64FramesEnd;
+    sTrailer.u32Buckets = m_buckets.size();
+    sTrailer.u32Keys = keys.size();
+
+    if (!m_file.seek(align8(m_u64FramesEnd)) ||
+        !writeAll(&m_file, m_offsets.data(), m_offsets.size() * sizeof(uint64_t)) ||
+        !writeAll(&m_file, m_buckets.data(), m_buckets.size() * sizeof(uint32_t)) ||
+        !writeAll(&m_file, keys.data(), keys.size() * sizeof(sArchiveKey_t)))
+        return false;
+
+    for (const sArchiveKey_t &sKey : keys) {
+        if (!writeAll(&m_file, m_keyLists[sKey.u16Key].data(), sKey.u32Count * sizeof(uint32_t)))
+            return false;
+    }
+
+    // the trailer validates the index, so it goes out only after the index is on the disk
+    if (!m_file.flush())
+        return false;
+
+    return writeAll(&m_file, &sTrailer, sizeof(sTrailer)) && m_file.flush();
+}
+
+bool cFrameArchive::open(const QString &qsFileName, QString *pqsError) {
+    close();
+
+    m_file.setFileName(qsFileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        *pqsError = QString("Can't open frame archive %1: %2").arg(qsFileName, m_file.errorString());
+        return false;
+    }
+
+    uint64_t u64FileSize = m_file.size();
+    if (u64FileSize >= sizeof(sArchiveFileHeader_t))
+        m_pu8Map = m_file.map(0, u64FileSize);
+
+    if (m_pu8Map != nullptr)
+        memcpy(&m_sHeader, m_pu8Map, sizeof(m_sHeader));
+
+    if (m_pu8Map == nullptr || memcmp(m_sHeader.cMagic, ARCHIVE_FILE_MAGIC, sizeof(m_sHeader.cMagic)) != 0 ||
+        m_sHeader.u16Version != ARCHIVE_FILE_VERSION || m_sHeader.u32BucketUs == 0) {
+        *pqsError = QString("%1 is not a frame archive").arg(qsFileName);
+        close();
+        return false;
+    }
+
+    m_bStoredIndex = loadIndex(u64FileSize);
+    if (!m_bStoredIndex)
+        rebuildIndex(u64FileSize);
+
+    return true;
+}
+
+bool cFrameArchive::loadIndex(uint64_t u64FileSize) {
+    sArchiveTrailer_t sTrailer;
+
+    if (u64FileSize < m_sHeader.u16HeaderLen + sizeof(sTrailer))
+        return false;
+
+    memcpy(&sTrailer, m_pu8Map + u64FileSize - sizeof(sTrailer), sizeof(sTrailer));
+    if (sTrailer.u32Magic != ARCHIVE_TRAILER_MAGIC)
+        return false;
+
+    uint64_t u64Offset = align8(sTrailer.u64FramesEnd);
+    uint64_t u64BucketsOffset = u64Offset + (uint64_t)sTrailer.u32Frames * sizeof(uint64_t);
+    uint64_t u64KeysOffset = u64BucketsOffset + (uint64_t)sTrailer.u32Buckets * sizeof(uint32_t);
+    uint64_t u64IdsOffset = u64KeysOffset + (uint64_t)sTrailer.u32Keys * sizeof(sArchiveKey_t);
+
+    // every frame is in exactly one id list
+    if (sTrailer.u64FramesEnd < m_sHeader.u16HeaderLen ||
+        u64IdsOffset + (uint64_t)sTrailer.u32Frames * sizeof(uint32_t) + sizeof(sTrailer) != u64FileSize)
+        return false;
+
+    // a damaged index whose size still fits must not lead frame() and bound() out of the map
+    const uint64_t *pu64Offsets = (const uint64_t *)(m_pu8Map + u64Offset);
+    for (uint32_t i = 0; i < sTrailer.u32Frames; i++) {
+        if (pu64Offsets[i] < m_sHeader.u16HeaderLen || pu64Offsets[i] > sTrailer.u64FramesEnd ||
+            sTrailer.u64FramesEnd - pu64Offsets[i] < sizeof(sArchiveFrame_t))
+            return false;
+
+        const sArchiveFrame_t *psFrame = (const sArchiveFrame_t *)(m_pu8Map + pu64Offsets[i]);
+        if (sTrailer.u64FramesEnd - pu64Offsets[i] - sizeof(sArchiveFrame_t) < psFrame->u8Len)
+            return false;
+    }
+
+    const uint32_t *pu32Buckets = (const uint32_t *)(m_pu8Map + u64BucketsOffset);
+    if (sTrailer.u32Frames > 0 && sTrailer.u32Buckets == 0)
+        return false;
+    for (uint32_t i = 0; i < sTrailer.u32Buckets; i++) {
+        if (pu32Buckets[i] > sTrailer.u32Frames || (i > 0 && pu32Buckets[i] < pu32Buckets[i - 1]))
+            return false;
+    }
+
+    const uint32_t *pu32Ids = (const uint32_t *)(m_pu8Map + u64IdsOffset);
+    for (uint32_t i = 0; i < sTrailer.u32Frames; i++) {
+        if (pu32Ids[i] >= sTrailer.u32Frames)
+            return false;
+    }
+
+    m_u32Frames = sTrailer.u32Frames;
+    m_pu64Offsets = pu64Offsets;
+    m_pu32Buckets = pu32Buckets;
+    m_u32Buckets = sTrailer.u32Buckets;
+    m_pu32Ids = pu32Ids;
+
+    m_keyFirst.assign(ARCHIVE_KEYS, 0);
+    m_keyCount.assign(ARCHIVE_KEYS, 0);
+
+    const sArchiveKey_t *psKeys = (const sArchiveKey_t *)(m_pu8Map + u64KeysOffset);
+    for (uint32_t i = 0; i < sTrailer.u32Keys; i++) {
+        if ((uint64_t)psKeys[i].u32First + psKeys[i].u32Count > m_u32Frames)
+            return false;
+
+        m_keyFirst[psKeys[i].u16Key] = psKeys[i].u32First;
+        m_keyCount[psKeys[i].u16Key] = psKeys[i].u32Count;
+    }
+
+    return true;
+}
+
+void cFrameArchive::rebuildIndex(uint64_t u64FileSize) {
+    uint64_t u64Offset = m_sHeader.u16HeaderLen;
+
+    m_offsets.clear();
+    m_buckets.clear();
+    m_u32Frames = 0;
+
+    m_keyFirst.assign(ARCHIVE_KEYS, 0);
+    m_keyCount.assign(ARCHIVE_KEYS, 0);
+
+    // frames end at the zeroes of the last window (or at a cut off frame)
+    while (u64Offset + sizeof(sArchiveFrame_t) <= u64FileSize) {
+        sArchiveFrame_t sFrame;
+        memcpy(&sFrame, m_pu8Map + u64Offset, sizeof(sFrame));
+
+        if (sFrame.i64TimeUs < m_sHeader.i64StartUtcUs || sFrame.u8Len > MAX_PAYLOAD_LENGTH ||
+            u64Offset + sizeof(sFrame) + sFrame.u8Len > u64FileSize)
+            break;
+
+        addToBuckets(sFrame.i64TimeUs);
+        m_offsets.push_back(u64Offset);
+        m_keyCount[(sFrame.u8Addr << 8) | sFrame.u8Cmd]++;
+        m_u32Frames++;
+
+        u64Offset += sizeof(sFrame) + sFrame.u8Len;
+    }
+
+    // id lists of all keys in one array, the same layout as a stored index
+    uint32_t u32First = 0;
+    for (uint32_t u32Key = 0; u32Key < ARCHIVE_KEYS; u32Key++) {
+        m_keyFirst[u32Key] = u32First;
+        u32First += m_keyCount[u32Key];
+    }
+
+    std::vector<uint32_t> fill(m_keyFirst);
+    m_ids.resize(m_u32Frames);
+    for (uint32_t u32Id = 0; u32Id < m_u32Frames; u32Id++) {
+        const sArchiveFrame_t *psFrame = (const sArchiveFrame_t *)(m_pu8Map + m_offsets[u32Id]);
+        m_ids[fill[(psFrame->u8Addr << 8) | psFrame->u8Cmd]++] = u32Id;
+    }
+
+    m_pu64Offsets = m_offsets.data();
+    m_pu32Buckets = m_buckets.data();
+    m_u32Buckets = m_buckets.size();
+    m_pu32Ids = m_ids.data();
+}
+
+void cFrameArchive::close(void) {
+    if (m_bWriting) {
+        if (m_pu8Window != nullptr)
+            m_file.unmap(m_pu8Window);
+
+        // drop the unused rest of the last window
+        m_file.resize(m_u64FramesEnd);
+
+        // a partial index must not stay behind the frames: cut it off (by name, the file may
+        // still hold unwritten data) and let open() rebuild the index from the frames
+        if (!writeIndex()) {
+            m_file.close();
+            QFile::resize(m_file.fileName(), m_u64FramesEnd);
+        }
+    }
+
+    if (m_pu8Map != nullptr)
+        m_file.unmap(m_pu8Map);
+
+    m_file.close();
+
+    m_bWriting = false;
+    m_bStoredIndex = false;
+    m_pu8Window = nullptr;
+    m_pu8Map = nullptr;
+    m_u32Frames = 0;
+    m_pu64Offsets = nullptr;
+    m_pu32Buckets = nullptr;
+    m_u32Buckets = 0;
+    m_pu32Ids = nullptr;
+
+    m_keyLists.clear();
+    m_keyFirst.clear();
+    m_keyCount.clear();
+    m_offsets.clear();
+    m_buckets.clear();
+    m_ids.clear();
+}
+
+uint32_t cFrameArchive::bound(int64_t i64TimeUs, bool bUpper) const {
+    if (m_u32Frames == 0 || i64TimeUs < m_sHeader.i64StartUtcUs)
+        return 0;
+
+    // the bucket holding the time limits the binary search to the frames of one bucket
+    uint64_t u64Bucket = (i64TimeUs - m_sHeader.i64StartUtcUs) / m_sHeader.u32BucketUs;
+    uint32_t u32Lo = m_pu32Buckets[qMin<uint64_t>(u64Bucket, m_u32Buckets - 1)];
+    uint32_t u32Hi = (u64Bucket + 1 < m_u32Buckets) ? m_pu32Buckets[u64Bucket + 1] : m_u32Frames;
+
+    while (u32Lo < u32Hi) {
+        uint32_t u32Mid = u32Lo + (u32Hi - u32Lo) / 2;
+        int64_t i64MidUs = frame(u32Mid)->i64TimeUs;
+
+        if (bUpper ? (i64MidUs <= i64TimeUs) : (i64MidUs < i64TimeUs))
+            u32Lo = u32Mid + 1;
+        else
+            u32Hi = u32Mid;
+    }
+
+    return u32Lo;
+}
+
+void cFrameArchive::query(int64_t i64FromUs, int64_t i64ToUs, int iAddr, int iCmd, std::vector<uint32_t> *pIds) const {
+    pIds->clear();
+
+    uint32_t u32Lo = bound(i64FromUs, false);
+    uint32_t u32Hi = bound(i64ToUs, true);
+    if (u32Lo >= u32Hi)
+        return;
+
+    if (iAddr == ARCHIVE_ANY && iCmd == ARCHIVE_ANY) {
+        pIds->reserve(u32Hi - u32Lo);
+        for (uint32_t u32Id = u32Lo; u32Id < u32Hi; u32Id++)
+            pIds->push_back(u32Id);
+        return;
+    }
+
+    // slice [u32Lo, u32Hi) out of the id list of every matching key
+    for (uint32_t u32Key = 0; u32Key < ARCHIVE_KEYS; u32Key++) {
+        if ((iAddr != ARCHIVE_ANY && (int)(u32Key >> 8) != iAddr) || (iCmd != ARCHIVE_ANY && (int)(u32Key & 0xFF) != iCmd))
+            continue;
+
+        const uint32_t *pu32Begin = m_pu32Ids + m_keyFirst[u32Key];
+        const uint32_t *pu32End = pu32Begin + m_keyCount[u32Key];
+
+        pIds->insert(pIds->end(), std::lower_bound(pu32Begin, pu32End, u32Lo), std::lower_bound(pu32Begin, pu32End, u32Hi));
+    }
+
+    // several keys matched: merge their slices
+    if (iAddr == ARCHIVE_ANY || iCmd == ARCHIVE_ANY)
+        std::sort(pIds->begin(), pIds->end());
+}
@@ -0,0 +1,145 @@
+#ifndef FRAMEARCHIVE_H
+#define FRAMEARCHIVE_H
+
+#include <QFile>
+#include <QString>
+
+#include <chrono>
+#include <vector>
+
+#include <stdint.h>
+
+#include "framedecoder.h"
+
+// Decoded frame archive (*.mkfa), little endian:
+//
+//   sArchiveFileHeader_t
+//   frame, frame, ...            each: sArchiveFrame_t + u8Len bytes of payload, in time order
+//   index                        written when the archive is closed:
+//                                  uint64_t frame offsets[u32Frames]
+//                                  uint32_t first frame of every time bucket[u32Buckets]
+//                                  sArchiveKey_t[u32Keys], one for every (address, command) seen
+//                                  uint32_t frame ids of all keys, each key's ids ascending
+//   sArchiveTrailer_t
+//
+// The file is written through a mapped window that grows in ARCHIVE_GROW_SIZE steps, so
+// appending a frame is a memcpy. An archive without a trailer (the session crashed) ends with
+// zeroes; opening it rebuilds the index in memory from the frames.
+
+#define ARCHIVE_FILE_MAGIC          "MKMXARC1"
+#define ARCHIVE_FILE_VERSION        1
+#define ARCHIVE_TRAILER_MAGIC       0x5844494Du     // "MIDX"
+#define ARCHIVE_GROW_SIZE           (16u << 20)
+#define ARCHIVE_BUCKET_US           1000000         // time bucket width
+
+#pragma pack(push, 1)
+
+typedef struct {
+    char cMagic[8];
+    uint16_t u16Version;
+    uint16_t u16HeaderLen;
+    uint32_t u32BucketUs;
+    int64_t i64StartUtcUs;      // start of the first time bucket
+} sArchiveFileHeader_t;
+
+typedef struct {
+    int64_t i64TimeUs;          // UTC, microseconds since the epoch
+    uint8_t u8PortId;
+    uint8_t u8Addr;
+    uint8_t u8Cmd;
+    uint8_t u8Len;
+} sArchiveFrame_t;
+
+typedef struct {
+    uint16_t u16Key;            // address << 8 | command
+    uint16_t u16Reserved;
+    uint32_t u32First;          // into the id array
+    uint32_t u32Count;
+} sArchiveKey_t;
+
+typedef struct {
+    uint32_t u32Magic;
+    uint32_t u32Frames;
+    uint64_t u64FramesEnd;      // the index starts at the next multiple of 8
+    uint32_t u32Buckets;
+    uint32_t u32Keys;
+} sArchiveTrailer_t;
+
+#pragma pack(pop)
+
+static_assert(sizeof(sArchiveFileHeader_t) == 24, "archive file header layout");
+static_assert(sizeof(sArchiveFrame_t) == 12, "archive frame layout");
+
+#define ARCHIVE_ANY     (-1)    // wildcard address / command of query()
+
+// Writes an archive (create, append, close) or opens one for queries (open, query, frame, close).
+// Queries narrow the time range through the buckets, then take the matching slice of the
+// (address, command) id lists, so they never touch frames outside the result.
+class cFrameArchive
+{
+public:
+    cFrameArchive();
+    ~cFrameArchive();
+
+    bool create(const QString &qsFileName, QString *pqsError);
+    // call from one thread only; frames must come in time order
+    void append(int64_t i64TimeUs, uint8_t u8PortId, const sRxFrame_t *frame);
+    int64_t nowUs(void) const;
+
+    bool open(const QString &qsFileName, QString *pqsError);
+    // writes the index when the archive was created
+    void close(void);
+
+    QString fileName(void) const { return m_file.fileName(); }
+    // false when the archive was not closed cleanly and the index had to be rebuilt
+    bool hasStoredIndex(void) const { return m_bStoredIndex; }
+
+    uint32_t framesCount(void) const { return m_u32Frames; }
+    int64_t startUs(void) const { return m_sHeader.i64StartUtcUs; }
+
+    // ids of the frames with i64FromUs <= time <= i64ToUs, ascending
+    void query(int64_t i64FromUs, int64_t i64ToUs, int iAddr, int iCmd, std::vector<uint32_t> *pIds) const;
+    // payload follows the returned header; valid until close()
+    const sArchiveFrame_t *frame(uint32_t u32Id) const { return (const sArchiveFrame_t *)(m_pu8Map + m_pu64Offsets[u32Id]); }
+
+private:
+    QFile m_file;
+    sArchiveFileHeader_t m_sHeader;
+    bool m_bWriting;
+    bool m_bStoredIndex;
+
+    // writing: current mapped window
+    uchar *m_pu8Window;
+    uint64_t m_u64WindowOffset;
+    uint32_t m_u32WindowUsed;
+    uint64_t m_u64FramesEnd;
+    int64_t m_i64LastUs;
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<std::vector<uint32_t>> m_keyLists;
+
+    // reading: whole file mapped
+    uchar *m_pu8Map;
+
+    // index, points into the map or into the vectors below
+    uint32_t m_u32Frames;
+    const uint64_t *m_pu64Offsets;
+    const uint32_t *m_pu32Buckets;
+    uint32_t m_u32Buckets;
+    const uint32_t *m_pu32Ids;
+    std::vector<uint32_t> m_keyFirst;
+    std::vector<uint32_t> m_keyCount;
+
+    std::vector<uint64_t> m_offsets;
+    std::vector<uint32_t> m_buckets;
+    std::vector<uint32_t> m_ids;
+
+    bool growWindow(void);
+    bool writeIndex(void);
+    bool loadIndex(uint64_t u64FileSize);
+    void rebuildIndex(uint64_t u64FileSize);
+    void addToBuckets(int64_t i64TimeUs);
+    // first frame with time > i64TimeUs (bUpper) or >= i64TimeUs
+    uint32_t bound(int64_t i64TimeUs, bool bUpper) const;
+};
+
+#endif // FRAMEARCHIVE_H
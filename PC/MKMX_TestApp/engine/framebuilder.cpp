@@ -0,0 +1,48 @@
+#include "framebuilder.h"
+
+#include <string.h>
+
+#include "utils/crctools.h"
+#include "utils/spscqueue.h"
+
+uint32_t buildFrame(uint8_t *pu8Dst, uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint8_t u8Len) {
+    pu8Dst[0] = 0x5A;
+    pu8Dst[1] = 0xA5;
+    pu8Dst[2] = u8Addr;
+    pu8Dst[3] = u8Cmd;
+    pu8Dst[4] = u8Len;
+
+    uint8_t u8Crc = crc8CcittUpdateBlock(0, &pu8Dst[2], 3);
+    u8Crc = crc8CcittCopyBlock(u8Crc, &pu8Dst[FRAME_HEADER_LENGTH], pu8Payload, u8Len);
+
+    pu8Dst[FRAME_HEADER_LENGTH + u8Len] = u8Crc;
+
+    return FRAME_OVERHEAD_LENGTH + u8Len;
+}
+
+bool buildFrame(cSpscByteQueue *txQueue, uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint32_t u32Len) {
+    if (u32Len > MAX_TX_PAYLOAD_LENGTH)
+        return false;
+
+    uint32_t u32FrameLen = FRAME_OVERHEAD_LENGTH + u32Len;
+
+    sSpscRegion_t sRegion;
+    if (!txQueue->reserve(u32FrameLen, &sRegion))
+        return false;
+
+    if (sRegion.u32SegLen[1] == 0) {
+        // usual case, the frame fits before the end of the queue buffer
+        buildFrame(sRegion.pu8Seg[0], u8Addr, u8Cmd, pu8Payload, (uint8_t)u32Len);
+    } else {
+        // the frame wraps around, build it aside and split it
+        uint8_t u8Frame[FRAME_OVERHEAD_LENGTH + MAX_TX_PAYLOAD_LENGTH];
+        buildFrame(u8Frame, u8Addr, u8Cmd, pu8Payload, (uint8_t)u32Len);
+
+        memcpy(sRegion.pu8Seg[0], u8Frame, sRegion.u32SegLen[0]);
+        memcpy(sRegion.pu8Seg[1], u8Frame + sRegion.u32SegLen[0], sRegion.u32SegLen[1]);
+    }
+
+    txQueue->commit(u32FrameLen);
+
+    return true;
+}
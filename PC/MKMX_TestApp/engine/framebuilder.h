@@ -0,0 +1,21 @@
+#ifndef FRAMEBUILDER_H
+#define FRAMEBUILDER_H
+
+#include <stdint.h>
+
+class cSpscByteQueue;
+
+#define FRAME_HEADER_LENGTH     5   // 0x5A 0xA5 addr cmd len
+#define FRAME_OVERHEAD_LENGTH   (FRAME_HEADER_LENGTH + 1)
+#define MAX_TX_PAYLOAD_LENGTH   255
+
+// Serialises a complete frame straight into the TX queue (producer side):
+// space for header + payload + CRC is reserved up front, header and payload are written once
+// and the CRC is computed while the payload is copied. Returns false (and queues nothing)
+// when the payload is too long or the queue does not have enough free space.
+bool buildFrame(cSpscByteQueue *txQueue, uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint32_t u32Len);
+
+// the same frame into a plain buffer of at least FRAME_OVERHEAD_LENGTH + u8Len bytes, returns the frame length
+uint32_t buildFrame(uint8_t *pu8Dst, uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint8_t u8Len);
+
+#endif // FRAMEBUILDER_H
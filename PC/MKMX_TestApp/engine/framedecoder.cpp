@@ -0,0 +1,269 @@
+#include "framedecoder.h"
+
+#include <string.h>
+
+#include "utils/crctools.h"
+
+cFrameDecoder::cFrameDecoder() :
+    m_eRxState(eStart0x5A),
+    m_u8Crc(0),
+    m_u8PayloadCnt(0),
+    m_bHunting(false),
+    m_u32RescanLen(0),
+    m_u32RescanPos(0),
+    m_bRescanning(false),
+    m_bRecovering(false),
+    m_u64LastRxNs(0)
+{
+    memset(&m_sRxFrame, 0, sizeof(m_sRxFrame));
+    resetStats();
+}
+
+void cFrameDecoder::reset(void) {
+    m_eRxState = eStart0x5A;
+    m_bHunting = false;
+
+    m_u32RescanLen = 0;
+    m_u32RescanPos = 0;
+    m_bRecovering = false;
+
+    m_u64LastRxNs = 0;
+}
+
+void cFrameDecoder::resetStats(void) {
+    memset(&m_sStats, 0, sizeof(m_sStats));
+}
+
+void cFrameDecoder::addStats(sDecoderStats_t *psTotal) const {
+    psTotal->u64Frames += m_sStats.u64Frames;
+    psTotal->u64CrcErrors += m_sStats.u64CrcErrors;
+    psTotal->u64MaxPayloadErrors += m_sStats.u64MaxPayloadErrors;
+    psTotal->u64Resyncs += m_sStats.u64Resyncs;
+    psTotal->u64SkippedBytes += m_sStats.u64SkippedBytes;
+    psTotal->u64RecoveredFrames += m_sStats.u64RecoveredFrames;
+    psTotal->u64Timeouts += m_sStats.u64Timeouts;
+}
+
+void cFrameDecoder::skipped(uint32_t u32Bytes) {
+    m_sStats.u64SkippedBytes += u32Bytes;
+
+    if (!m_bHunting) {
+        m_bHunting = true;
+        m_sStats.u64Resyncs++;
+    }
+}
+
+bool cFrameDecoder::checkGap(uint64_t u64RxNs, uint64_t u64ArrivalNs, uint64_t u64TimeoutNs) {
+    uint64_t u64LastRxNs = m_u64LastRxNs;
+    m_u64LastRxNs = u64RxNs;
+
+    if (u64TimeoutNs == 0 || u64LastRxNs == 0 || m_eRxState == eStart0x5A)
+        return false;
+
+    // the first byte of the chunk came u64ArrivalNs before it was read
+    if (u64RxNs - u64LastRxNs <= u64ArrivalNs + u64TimeoutNs)
+        return false;
+
+    m_eRxState = eStart0x5A;
+    m_u32RescanLen = 0;
+    m_u32RescanPos = 0;
+
+    m_sStats.u64Timeouts++;
+
+    return true;
+}
+
+void cFrameDecoder::feed(const uint8_t *pu8Data, uint32_t u32Len, uint64_t u64RxNs, uint64_t u64CharacterNs, uint32_t u32TimeoutChars,
+                         const std::function<void(eDecoderResult_t)> &onResult) {
+    // a sender that stopped in the middle of a frame must not take the start of the next one with it
+    if (checkGap(u64RxNs, u32Len * u64CharacterNs, u32TimeoutChars * u64CharacterNs))
+        onResult(eDecoderTimeout);
+
+    // a broken frame may leave bytes to be decoded again, so loop until the decoder asks for more
+    uint32_t u32Pos = 0;
+    eDecoderResult_t eResult;
+    while ((eResult = decode(pu8Data, u32Len, &u32Pos)) != eDecoderNeedMoreData)
+        onResult(eResult);
+}
+
+// first 0x5A 0xA5 (or 0x5A as the last byte, its pair may come next), u32Len when there is none
+static uint32_t findSync(const uint8_t *pu8Data, uint32_t u32Len) {
+    const uint8_t *pu8End = pu8Data + u32Len;
+    const uint8_t *pu8Sync = pu8Data;
+
+    while ((pu8Sync = (const uint8_t *)memchr(pu8Sync, 0x5A, pu8End - pu8Sync)) != nullptr) {
+        if (pu8Sync + 1 == pu8End || pu8Sync[1] == 0xA5)
+            return pu8Sync - pu8Data;
+
+        pu8Sync++;
+    }
+
+    return u32Len;
+}
+
+void cFrameDecoder::rescan(eDecoderResult_t eError) {
+    uint8_t u8Bytes[FRAME_LOOKBACK_LENGTH];
+    uint32_t u32Len = 0;
+
+    // the broken frame is still in m_sRxFrame, the length byte is the last one read on a length error
+    u8Bytes[u32Len++] = m_sRxFrame.u8DestAddr;
+    u8Bytes[u32Len++] = m_sRxFrame.u8Cmd;
+    u8Bytes[u32Len++] = m_sRxFrame.u8Len;
+    if (eError == eDecoderCrcError) {
+        memcpy(&u8Bytes[u32Len], m_sRxFrame.u8Payload, m_sRxFrame.u8Len);
+        u32Len += m_sRxFrame.u8Len;
+        u8Bytes[u32Len++] = m_sRxFrame.u8CRC;
+    }
+
+    // when the broken frame came from an earlier rescan, it ended inside it and the rest of
+    // that rescan follows it; both together are never longer than the earlier rescan
+    uint32_t u32Rest = m_bRescanning ? m_u32RescanLen - m_u32RescanPos : 0;
+    if (u32Len + u32Rest > sizeof(u8Bytes))
+        u32Rest = sizeof(u8Bytes) - u32Len;
+    memcpy(&u8Bytes[u32Len], &m_u8Rescan[m_u32RescanPos], u32Rest);
+    u32Len += u32Rest;
+
+    // bytes before the next candidate belonged to the broken frame, they are not counted as skipped
+    uint32_t u32Sync = findSync(u8Bytes, u32Len);
+
+    m_u32RescanLen = u32Len - u32Sync;
+    m_u32RescanPos = 0;
+    memcpy(m_u8Rescan, &u8Bytes[u32Sync], m_u32RescanLen);
+}
+
+eDecoderResult_t cFrameDecoder::decode(const uint8_t *pu8Data, uint32_t u32Len, uint32_t *pu32Pos) {
+    eDecoderResult_t eResult;
+
+    // bytes of a broken frame go first, they are older than anything in the span
+    if (m_u32RescanPos < m_u32RescanLen) {
+        m_bRescanning = true;
+        eResult = scan(m_u8Rescan, m_u32RescanLen, &m_u32RescanPos);
+
+        if (eResult == eDecoderCrcError || eResult == eDecoderMaxPayloadError)
+            rescan(eResult);
+        m_bRescanning = false;
+
+        if (eResult != eDecoderNeedMoreData)
+            return eResult;
+    }
+
+    eResult = scan(pu8Data, u32Len, pu32Pos);
+
+    if (eResult == eDecoderCrcError || eResult == eDecoderMaxPayloadError)
+        rescan(eResult);
+
+    return eResult;
+}
+
+eDecoderResult_t cFrameDecoder::scan(const uint8_t *pu8Data, uint32_t u32Len, uint32_t *pu32Pos) {
+    uint32_t u32Pos = *pu32Pos;
+
+    while (u32Pos < u32Len) {
+        switch (m_eRxState) {
+        case eStart0x5A: {
+            // usual case, frames follow each other
+            if (pu8Data[u32Pos] == 0x5A) {
+                m_eRxState = eStart0xA5;
+                u32Pos++;
+                break;
+            }
+
+            // garbage is stepped over with memchr, not byte by byte
+            const uint8_t *pu8Sync = (const uint8_t *)memchr(&pu8Data[u32Pos], 0x5A, u32Len - u32Pos);
+            uint32_t u32Sync = (pu8Sync != nullptr) ? pu8Sync - pu8Data : u32Len;
+
+            if (u32Sync != u32Pos)
+                skipped(u32Sync - u32Pos);
+            u32Pos = u32Sync;
+
+            if (pu8Sync != nullptr) {
+                m_eRxState = eStart0xA5;
+                u32Pos++;
+            }
+            break;
+        }
+
+        case eStart0xA5:
+            if (pu8Data[u32Pos] == 0xA5) {
+                m_sRxFrame.u16Start = 0x5AA5;
+                m_u8Crc = 0;
+                m_u8PayloadCnt = 0;
+                m_eRxState = eDestAddr;
+                m_bHunting = false;
+                m_bRecovering = m_bRescanning;
+            } else if (pu8Data[u32Pos] != 0x5A) {
+                // 0x5A 0x5A 0xA5 is still a valid start of frame
+                m_eRxState = eStart0x5A;
+                skipped(2);
+            } else {
+                skipped(1);
+            }
+            u32Pos++;
+            break;
+
+        case eDestAddr:
+            m_sRxFrame.u8DestAddr = pu8Data[u32Pos++];
+            m_u8Crc = _crc8_ccitt_update(m_u8Crc, m_sRxFrame.u8DestAddr);
+            m_eRxState = eCommand;
+            break;
+
+        case eCommand:
+            m_sRxFrame.u8Cmd = pu8Data[u32Pos++];
+            m_u8Crc = _crc8_ccitt_update(m_u8Crc, m_sRxFrame.u8Cmd);
+            m_eRxState = ePayloadLen;
+            break;
+
+        case ePayloadLen:
+            m_sRxFrame.u8Len = pu8Data[u32Pos++];
+            m_u8Crc = _crc8_ccitt_update(m_u8Crc, m_sRxFrame.u8Len);
+
+            if (m_sRxFrame.u8Len > MAX_PAYLOAD_LENGTH) {
+                m_eRxState = eStart0x5A;
+
+                m_sStats.u64MaxPayloadErrors++;
+
+                *pu32Pos = u32Pos;
+                return eDecoderMaxPayloadError;
+            }
+
+            m_eRxState = (m_sRxFrame.u8Len != 0) ? ePayload : eCRC;
+            break;
+
+        case ePayload: {
+            uint32_t u32Chunk = m_sRxFrame.u8Len - m_u8PayloadCnt;
+            if (u32Chunk > u32Len - u32Pos)
+                u32Chunk = u32Len - u32Pos;
+
+            uint8_t *pu8Dst = &m_sRxFrame.u8Payload[m_u8PayloadCnt];
+            memcpy(pu8Dst, &pu8Data[u32Pos], u32Chunk);
+
+            m_u8Crc = crc8CcittUpdateBlock(m_u8Crc, pu8Dst, u32Chunk);
+
+            m_u8PayloadCnt += u32Chunk;
+            u32Pos += u32Chunk;
+
+            if (m_u8PayloadCnt == m_sRxFrame.u8Len)
+                m_eRxState = eCRC;
+            break;
+        }
+
+        case eCRC:
+            m_sRxFrame.u8CRC = pu8Data[u32Pos++];
+            m_eRxState = eStart0x5A;
+
+            *pu32Pos = u32Pos;
+            if (m_u8Crc == m_sRxFrame.u8CRC) {
+                m_sStats.u64Frames++;
+                if (m_bRecovering)
+                    m_sStats.u64RecoveredFrames++;
+                return eDecoderFrameReady;
+            }
+
+            m_sStats.u64CrcErrors++;
+            return eDecoderCrcError;
+        }
+    }
+
+    *pu32Pos = u32Pos;
+    return eDecoderNeedMoreData;
+}
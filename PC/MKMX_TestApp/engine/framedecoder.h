@@ -0,0 +1,112 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <functional>
+
+#include <stdint.h>
+
+#define MAX_PAYLOAD_LENGTH  128
+
+// bytes of a frame after its 0x5A 0xA5: addr, cmd, len, payload, crc
+#define FRAME_LOOKBACK_LENGTH   (3 + MAX_PAYLOAD_LENGTH + 1)
+
+typedef struct {
+    uint16_t u16Start;
+    uint8_t u8DestAddr;
+    uint8_t u8Cmd;
+    uint8_t u8Len;
+    uint8_t u8Payload[MAX_PAYLOAD_LENGTH];
+    uint8_t u8CRC;
+} sRxFrame_t;
+
+typedef struct {
+    uint64_t u64Frames;
+    uint64_t u64CrcErrors;
+    uint64_t u64MaxPayloadErrors;
+    uint64_t u64Resyncs;            // runs of bytes that had to be skipped to find a start of frame
+    uint64_t u64SkippedBytes;
+    uint64_t u64RecoveredFrames;    // good frames that started inside a broken one
+    uint64_t u64Timeouts;           // partial frames dropped after a silent gap
+} sDecoderStats_t;
+
+typedef enum {
+    eDecoderNeedMoreData = 0,
+    eDecoderFrameReady,
+    eDecoderCrcError,
+    eDecoderMaxPayloadError,
+    eDecoderTimeout             // feed() only: a partial frame was dropped after a silent gap
+} eDecoderResult_t;
+
+// Incremental MKMX frame decoder:
+// walks the given byte span from *pu32Pos and stops right after a complete (or broken)
+// frame, so the caller can handle it and call decode() again with the same span.
+// CRC is accumulated while bytes arrive and the payload is copied in bulk.
+// After a CRC or length error the bytes of the broken frame are searched again for the next
+// 0x5A 0xA5 and decoded before any new data, so a frame that started inside it is not lost.
+// decode() returns eDecoderNeedMoreData only when both the span and these bytes are used up.
+// Frame returned by frame() stays valid until the next call of decode().
+class cFrameDecoder
+{
+private:
+    typedef enum {
+        eStart0x5A = 0,
+        eStart0xA5,
+        eDestAddr,
+        eCommand,
+        ePayloadLen,
+        ePayload,
+        eCRC
+    } eRxState_t;
+
+public:
+    cFrameDecoder();
+
+    void reset(void);
+
+    eDecoderResult_t decode(const uint8_t *pu8Data, uint32_t u32Len, uint32_t *pu32Pos);
+
+    // Call before decoding a chunk read at u64RxNs, whose bytes took u64ArrivalNs to come in.
+    // When the line was silent for more than u64TimeoutNs since the previous chunk, a partial frame
+    // is dropped (the sender stopped in the middle of it) and true is returned.
+    bool checkGap(uint64_t u64RxNs, uint64_t u64ArrivalNs, uint64_t u64TimeoutNs);
+
+    // Decodes a whole chunk of a serial line read at u64RxNs: checkGap() with the character time of the line
+    // (0: no gap check), then decode() until the chunk is used up. onResult gets every result but
+    // eDecoderNeedMoreData; on eDecoderTimeout frame() still holds the start of the dropped frame.
+    void feed(const uint8_t *pu8Data, uint32_t u32Len, uint64_t u64RxNs, uint64_t u64CharacterNs, uint32_t u32TimeoutChars,
+              const std::function<void(eDecoderResult_t)> &onResult);
+
+    const sRxFrame_t *frame(void) const { return &m_sRxFrame; }
+
+    const sDecoderStats_t *stats(void) const { return &m_sStats; }
+    // adds the counters to *psTotal, for totals over several decoders
+    void addStats(sDecoderStats_t *psTotal) const;
+    void resetStats(void);
+
+private:
+    eRxState_t m_eRxState;
+
+    uint8_t m_u8Crc;
+    uint8_t m_u8PayloadCnt;
+
+    sRxFrame_t m_sRxFrame;
+
+    // set while skipping garbage, so one run of it counts as one resync
+    bool m_bHunting;
+    sDecoderStats_t m_sStats;
+
+    // bytes of broken frames still to be decoded again, starting with a sync candidate
+    uint8_t m_u8Rescan[FRAME_LOOKBACK_LENGTH];
+    uint32_t m_u32RescanLen;
+    uint32_t m_u32RescanPos;
+    bool m_bRescanning;     // scan() runs over m_u8Rescan
+    bool m_bRecovering;     // the current frame started in m_u8Rescan
+
+    uint64_t m_u64LastRxNs;
+
+    eDecoderResult_t scan(const uint8_t *pu8Data, uint32_t u32Len, uint32_t *pu32Pos);
+    void rescan(eDecoderResult_t eError);
+    void skipped(uint32_t u32Bytes);
+};
+
+#endif // FRAMEDECODER_H
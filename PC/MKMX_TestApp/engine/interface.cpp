@@ -1,26 +1,33 @@
 #include "interface.h"
 
-#include "utils/crctools.h"
+#include "framebuilder.h"
+#include "transport.h"
+#include "playbacktransport.h"
+#include "capturewriter.h"
+#include "metrics.h"
 
-#include <QtSerialPort/QtSerialPort>
+#include <QDebug>
+#include <QScopedPointer>
+#include <QTimer>
 
-#define DEBUG_INTERFACE_THREAD
+#include "utils/tracetools.h"
 
-#ifdef DEBUG_INTERFACE_THREAD
-    #include <QDebug>
-    #include "utils/debugtools.h"
-#endif
+static_assert((TX_BUFFER_LENGTH & (TX_BUFFER_LENGTH - 1)) == 0, "TX_BUFFER_LENGTH must be a power of two");
 
 cInterface::cInterface(QObject *parent) :
     QThread(parent),
-    m_closeRequest(false),
-    m_online(false)
+    m_online(false),
+    m_u32CharacterTimeNs(0),
+    m_txQueue(u8DataTxBuffer, TX_BUFFER_LENGTH),
+    m_txWakePending(false),
+    m_capture(nullptr),
+    m_metrics(nullptr),
+    m_u8PortId(0),
+    m_psPlayback(nullptr)
 {
     m_interfaceID = "strThreadID";
 
     u8FrameCnt = 0;
-
-    InitializeRingBuffer(&m_sDataTxBuffer, u8DataTxBuffer, TX_BUFFER_LENGTH, 0);
 }
 
 void cInterface::start(const QString &qsPortName, int iWaitTimeout) {
@@ -29,7 +36,6 @@ void cInterface::start(const QString &qsPortName, int iWaitTimeout) {
     m_waitTimeout = iWaitTimeout;
 
     m_online = false;
-    m_closeRequest = false;
 
     QThread::start();
 }
@@ -37,185 +43,175 @@ void cInterface::start(const QString &qsPortName, int iWaitTimeout) {
 void cInterface::stop(void) {
     qDebug() << "close serial";
 
-    m_mutex.lock();
-    m_closeRequest = true;
-    m_mutex.unlock();
+    // safe to call before run() reaches exec(), the event loop then returns immediately
+    quit();
 
     wait();
 }
 
 bool cInterface::isOnline(void) {
-    QMutexLocker locker(&m_mutex);
     return m_online;
 }
 
-bool cInterface::txData(uint8_t u8Addr, uint8_t u8Cmd, QByteArray baData) {
-    m_mutex.lock();
-
+bool cInterface::txData(uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint32_t u32Len) {
     if (m_online) {
-#ifdef DEBUG_INTERFACE_THREAD
-        QByteArray payload = QByteArray(baData);
-#endif
-        uint8_t u8LenInBytes = baData.length();
-
-        //prepend length protocol field:
-        baData.prepend((char)u8LenInBytes);
-
-        //prepend frame count field:
-        baData.prepend((char)u8Cmd);
-
-        //prepend command protocol field:
-        baData.prepend((char)u8Addr);
-
-        //prepend FRAME HEADER:
-        baData.prepend((char)0xA5);
-        baData.prepend((char)0x5A);
+        TRACE_DEBUG(eTraceIfaceTxFrame, u8Addr, u8Cmd, u32Len);
 
-        uint8_t u8CrcResult = computeCRC((uint8_t *)(baData.data() + 2), baData.length() - 2);
+        uint32_t u32FrameLen = FRAME_OVERHEAD_LENGTH + u32Len;
 
-        baData.append((char)u8CrcResult);
+        // the stamp goes first, so the interface thread never writes a frame before it sees its stamp;
+        // the free space can only grow meanwhile, so the frame will fit (without room for the stamp
+        // the frame is just not measured)
+        if (m_metrics != nullptr && u32Len <= MAX_TX_PAYLOAD_LENGTH && m_txQueue.freeBytes() >= u32FrameLen)
+            m_txLatency.stamp(u32FrameLen);
 
-#ifdef DEBUG_INTERFACE_THREAD
-        qDebug() << "IFACE TX_DATA (" << m_interfaceID << "):";
-        qDebug() << "  data len:    " << baData.length();
-        qDebug() << "  data raw:    " << qbaToString(baData);
-        qDebug() << "  payload len: " << u8LenInBytes;
-        qDebug() << "  payload raw: " << qbaToString(payload);
-        qDebug() << "  free:        " << NoOfFreeBytes(&m_sDataTxBuffer);
-        qDebug() << "  crc:         " << u8ToString(u8CrcResult);
-#endif
+        // we are the only producer, so the space reserved by the builder can not be taken away
+        if (buildFrame(&m_txQueue, u8Addr, u8Cmd, pu8Payload, u32Len)) {
+            m_txLatency.queued(u32FrameLen);
 
-        if (NoOfFreeBytes(&m_sDataTxBuffer) >= baData.length()) {
-            for(int i = 0; i < baData.length(); i++) {
-                PushByte(&m_sDataTxBuffer, baData.at(i));
-            }
+            if (m_metrics != nullptr)
+                m_metrics->txQueueLevel(m_txQueue.usedBytes());
 
-            m_mutex.unlock();
+            // one pending wake-up is enough, the interface thread drains everything queued so far;
+            // the fence pairs with the one in flushTxBuffer(): either we see the flag cleared or
+            // the interface thread sees this frame
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!m_txWakePending.exchange(true, std::memory_order_relaxed))
+                emit txRequested();
 
             return true;
         } else {
-            qDebug() << "there is not enough free space in tx buffer for: " << m_serialPortName;
+            TRACE_ERROR(eTraceIfaceTxNoSpace, u32Len + FRAME_OVERHEAD_LENGTH, m_txQueue.freeBytes(), 0);
         }
     } else {
-        qDebug() << "interface is offline - can not tx data...";
+        TRACE_ERROR(eTraceIfaceTxOffline, u8Addr, u8Cmd, 0);
     }
 
-    m_mutex.unlock();
-
     return false;
 }
 
-QString cInterface::errorToString(QSerialPort::SerialPortError errCode) {
-    switch (errCode) {
-
-        case QSerialPort::DeviceNotFoundError:
-            return "Attempting to open an non-existing device";
-        case QSerialPort::PermissionError:
-            return "Attempting to open device which was already opened or current user does not have enough permission";
-        case QSerialPort::OpenError:
-            return "Attempting to open device which was already opened in this object";
-        case QSerialPort::ParityError:
-            return "Parity error detected by the hardware while reading data";
-        case QSerialPort::FramingError:
-            return "Framing error detected by the hardware while reading data";
-        case QSerialPort::BreakConditionError:
-            return "Break condition detected by the hardware on the input line";
-        case QSerialPort::WriteError:
-            return "An I/O error occurred while writing the data";
-        case QSerialPort::ReadError:
-            return "An I/O error occurred while reading the data";
-        case QSerialPort::ResourceError:
-            return "Resource becomes unavailable (the device was unexpectedly removed from the system?)";
-        case QSerialPort::UnsupportedOperationError:
-            return "The requested device operation is not supported or prohibited by the running operating system";
-        case QSerialPort::UnknownError:
-            return "An unidentified error occurred";
-        case QSerialPort::TimeoutError:
-            return "A timeout error occurred";
-        case QSerialPort::NotOpenError:
-            return "Operation can only be successfully performed if the device is open";
-        default:
-        case QSerialPort::NoError:
-            return "No error occurred";
-    }
+bool cInterface::txData(uint8_t u8Addr, uint8_t u8Cmd, const QByteArray &baData) {
+    return txData(u8Addr, u8Cmd, (const uint8_t *)baData.constData(), baData.length());
 }
 
-void cInterface::run(void) {
-    bool currentPortNameChanged = false;
+void cInterface::flushTxBuffer(cTransport *transport) {
+    // clear before draining, so a frame pushed while we drain triggers another wake-up
+    m_txWakePending.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
 
-    m_mutex.lock();
-    QString currentPortName;
-    if (currentPortName != m_serialPortName) {
-        currentPortName = m_serialPortName;
-        currentPortNameChanged = true;
+    uint32_t u32NoOfBytesToSend;
+    while ((u32NoOfBytesToSend = m_txQueue.pop(u8DataTxStaging, TX_BUFFER_LENGTH)) != 0) {
+        // the transport queues what it can not write at once and sends it from this thread's event loop
+        transport->write(u8DataTxStaging, u32NoOfBytesToSend);
+
+        if (m_capture != nullptr)
+            m_capture->record(CAPTURE_FLAG_TX, m_u8PortId, u8DataTxStaging, u32NoOfBytesToSend);
     }
+}
 
+void cInterface::run(void) {
+    m_mutex.lock();
+    QString currentPortName = m_serialPortName;
     int currentWaitTimeout = m_waitTimeout;
     m_mutex.unlock();
 
-    QSerialPort serial;
+    QString qsError;
+    QScopedPointer<cTransport> transport(cTransport::create(currentPortName, &qsError));
 
-    while (!m_closeRequest) {
-        if (currentPortNameChanged) {
-            qDebug() << "currentPortNameChanged";
+    cPlaybackTransport *playback = qobject_cast<cPlaybackTransport *>(transport.data());
+    if (playback != nullptr && m_psPlayback != nullptr)
+        playback->setControl(m_psPlayback);
 
-            serial.close();
-            serial.setPortName(currentPortName);
-            serial.setBaudRate(4800);
+    // a malformed port specification fails like a port that can't be opened
+    if (transport.isNull() || !transport->open(&qsError)) {
+        emit error(qsError);
+        qDebug() << tr("Can't open %1: %2").arg(currentPortName, qsError);
 
-            if (!serial.open(QIODevice::ReadWrite)) {
-                emit error(errorToString(serial.error())); //tr("Can't open %1, error code %2").arg(m_serialPortName).arg(serial.error()));
-                qDebug() << tr("Can't open %1, error code %2").arg(m_serialPortName).arg(serial.error());
+        emit disconnected();
+        return;
+    }
 
-                break;
-            }
+    // everything below runs in this thread, driven by its event loop:
+    // reads are handled as soon as the transport signals them and txData() wakes us through txRequested(),
+    // so TX latency no longer depends on the read timeout
+    cTransport *t = transport.data();
 
-            m_online = true;
+    uint32_t u32CharacterNs = (t->baudRate() != 0) ? 10 * 1000000000ull / t->baudRate() : 0;
+    m_u32CharacterTimeNs = u32CharacterNs;
 
-            emit connected();
-        }
+    // a replay of the capture times out partial frames with the same character time
+    if (m_capture != nullptr)
+        m_capture->record(CAPTURE_FLAG_LINE, m_u8PortId, (const uint8_t *)&u32CharacterNs, sizeof(u32CharacterNs));
 
-        if (serial.waitForReadyRead(currentWaitTimeout)) {
-            // read request
-            QByteArray rxedData = serial.readAll();
+    connect(t, &cTransport::readyRead, t, [this, t]() {
+        QByteArray rxedData = t->readAll();
+        uint64_t u64RxNs = cEngineMetrics::nowNs();
 
-            if (!rxedData.isEmpty()) {
-                emit newData(rxedData);
-            }
-        } else {
-            //emit timeout(tr("Wait read request timeout %1").arg(QTime::currentTime().toString()));
-            //qDebug() << tr("Wait read request timeout %1").arg(QTime::currentTime().toString());
+        if (!rxedData.isEmpty()) {
+            TRACE_DEBUG(eTraceIfaceRxChunk, rxedData.length(), 0, 0);
+
+            if (m_capture != nullptr)
+                m_capture->record(0, m_u8PortId, (const uint8_t *)rxedData.constData(), rxedData.length());
+
+            emit newData(rxedData, u64RxNs);
         }
+    });
+
+    // bytes count as sent, and frames as delivered, only once the transport has written them to the device
+    m_txLatency.reset();
+    connect(t, &cTransport::bytesWritten, t, [this](quint64 u64Bytes) {
+        if (m_metrics != nullptr) {
+            m_metrics->txBytes(u64Bytes);
+            m_txLatency.written(u64Bytes, m_metrics);
+        }
+    });
+
+    connect(t, &cTransport::discontinuity, t, [this]() {
+        if (m_capture != nullptr)
+            m_capture->record(CAPTURE_FLAG_RESET, m_u8PortId, nullptr, 0);
+
+        emit discontinuity();
+    });
+
+    connect(this, &cInterface::txRequested, t, [this, t]() {
+        flushTxBuffer(t);
+    }, Qt::QueuedConnection);
+
+    connect(t, &cTransport::fatalError, t, [this](const QString &s) {
+        emit error(s);
+        quit();
+    });
+
+    QTimer captureTimer;
+    if (m_capture != nullptr) {
+        connect(&captureTimer, &QTimer::timeout, t, [this]() {
+            m_capture->handOver();
+        });
+        captureTimer.start(CAPTURE_HANDOVER_INTERVAL);
+    }
 
-        m_mutex.lock();
+    if (t->name() != currentPortName)
+        qDebug() << "transport:" << t->name();
 
-        uint8_t u8UsedBytes = NoOfUsedBytes(&m_sDataTxBuffer);
-        if (u8UsedBytes != 0) {
-            uint8_t *u8DataBuffer = new uint8_t [u8UsedBytes];
+    m_online = true;
+    TRACE_INFO(eTraceIfaceOpened, 0, 0, 0);
 
-            uint8_t u8NoOfBytesToSend = PopData(&m_sDataTxBuffer, u8DataBuffer, u8UsedBytes);
+    emit connected();
 
-            serial.write((const char *)u8DataBuffer, u8NoOfBytesToSend);
+    exec();
 
-            if (!serial.waitForBytesWritten(currentWaitTimeout)) {
-                emit timeout(tr("Wait write response timeout %1").arg(QTime::currentTime().toString()));
-                qDebug() << tr("Wait write response timeout %1").arg(QTime::currentTime().toString());
-            }
+    m_online = false;
 
-            delete [] u8DataBuffer;
-        }
+    // give already queued data a chance to leave before the port goes away
+    flushTxBuffer(t);
+    t->waitForBytesWritten(currentWaitTimeout);
 
-        if (currentPortName != m_serialPortName) {
-            currentPortName = m_serialPortName;
-            currentPortNameChanged = true;
-        } else {
-            currentPortNameChanged = false;
-        }
-        currentWaitTimeout = m_waitTimeout;
-        m_mutex.unlock();
-    }
+    t->close();
 
-    emit disconnected();
+    captureTimer.stop();
+    if (m_capture != nullptr)
+        m_capture->handOver();
 
-    m_online = false;
+    TRACE_INFO(eTraceIfaceClosed, 0, 0, 0);
+    emit disconnected();
 }
@@ -3,11 +3,17 @@
 
 #include <QThread>
 #include <QMutex>
-#include <QSerialPort>
 
-#include "utils/ringbuffer.h"
+#include <atomic>
 
-#define TX_BUFFER_LENGTH    1024
+#include "metrics.h"
+#include "utils/spscqueue.h"
+
+class cTransport;
+class cCaptureWriter;
+typedef struct sPlaybackControl sPlaybackControl_t;
+
+#define TX_BUFFER_LENGTH        1024
 
 class cInterface: public QThread
 {
@@ -24,12 +30,34 @@ public:
 
     QString serialPortName(void) { return m_serialPortName; }
 
-    bool txData(uint8_t u8Addr, uint8_t u8Cmd, QByteArray baData);
+    // time of one character (start + 8 data + stop bits) on the open port, 0 when the transport
+    // has no line speed; valid from the first newData() on
+    uint32_t characterTimeNs(void) const { return m_u32CharacterTimeNs; }
+
+    // raw RX chunks and TX writes are recorded from the interface thread; set before start()
+    void setCapture(cCaptureWriter *capture) { m_capture = capture; }
+    // byte counters, TX queue level and TX latency; set before start()
+    void setMetrics(cEngineMetrics *metrics) { m_metrics = metrics; }
+    // port id of the capture records and archived frames of this interface (default 0); set before start()
+    void setPortId(uint8_t u8PortId) { m_u8PortId = u8PortId; }
+    uint8_t portId(void) const { return m_u8PortId; }
+    // speed, pause and seek of a "play:" transport; set before start()
+    void setPlaybackControl(sPlaybackControl_t *psPlayback) { m_psPlayback = psPlayback; }
+
+    // producer side of the TX queue: call from one thread only (the GUI thread)
+    bool txData(uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint32_t u32Len);
+    bool txData(uint8_t u8Addr, uint8_t u8Cmd, const QByteArray &baData);
 
 signals:
     void timeout(const QString &s);
 
-    void newData(QByteArray baData);
+    void txRequested(void);
+
+    // u64RxNs: when the chunk was read (cEngineMetrics::nowNs())
+    void newData(QByteArray baData, quint64 u64RxNs);
+
+    // emitted from the interface thread, see cTransport::discontinuity() (use Qt::DirectConnection)
+    void discontinuity(void);
 
     void connected(void);
     void error(const QString &s);
@@ -37,17 +65,27 @@ signals:
 
 private:
     QMutex m_mutex;
-    bool m_closeRequest;
-    bool m_online;
+    std::atomic<bool> m_online;
+    std::atomic<uint32_t> m_u32CharacterTimeNs;
 
-    sRingBuffer_t m_sDataTxBuffer;
     uint8_t u8DataTxBuffer[TX_BUFFER_LENGTH];
+    uint8_t u8DataTxStaging[TX_BUFFER_LENGTH];
+    cSpscByteQueue m_txQueue;
+    std::atomic<bool> m_txWakePending;
 
     QString m_interfaceID;
     QString m_serialPortName;
     int m_waitTimeout;
 
-    QString errorToString(QSerialPort::SerialPortError errCode);
+    cCaptureWriter *m_capture;
+    cEngineMetrics *m_metrics;
+    uint8_t m_u8PortId;
+    sPlaybackControl_t *m_psPlayback;
+
+    // closed when the transport reports the bytes written (cTransport::bytesWritten())
+    cTxLatencyTracker m_txLatency;
+
+    void flushTxBuffer(cTransport *transport);
 
     uint8_t u8FrameCnt;
 };
@@ -0,0 +1,280 @@
+#include "logsink.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+
+#include <string.h>
+
+// free buffers kept for reuse
+#define LOG_SINK_FREE_BUFFERS_POOL  4
+
+cLogSink::cLogSink(QObject *parent) :
+    cBufferedFileWriter("log sink:", LOG_SINK_MAX_QUEUED, LOG_SINK_FREE_BUFFERS_POOL, LOG_SINK_FLUSH_INTERVAL, parent),
+    m_i64PrefixSecond(-1),
+    m_u32FileIndex(0),
+    m_u64FileBytes(0),
+    m_i64FileOpenedMs(0)
+{
+    m_sConfig.u32RotateBytes = 0;
+    m_sConfig.u32RotateSeconds = 0;
+    m_sConfig.bBinary = false;
+    m_sConfig.bCompress = false;
+}
+
+cLogSink::~cLogSink() {
+    close();
+}
+
+bool cLogSink::open(const sLogSinkConfig_t &sConfig, const QString &qsName, QString *pqsError) {
+    close();
+
+    m_sConfig = sConfig;
+    m_qsName = qsName;
+    m_u32FileIndex = 0;
+
+    // the first file is opened here, so a wrong directory is reported to the caller
+    if (!openNextFile(pqsError))
+        return false;
+
+    m_i64PrefixSecond = -1;
+    m_buffer.clear();
+    m_buffer.reserve(LOG_SINK_BUFFER_SIZE);
+
+    startWriter();
+
+    return true;
+}
+
+void cLogSink::close(void) {
+    if (!isRunning())
+        return;
+
+    stopWriter();
+
+    m_file.close();
+}
+
+bool cLogSink::openNextFile(QString *pqsError) {
+    m_file.close();
+
+    QString qsFileName = QDir(m_sConfig.qsDirectory).filePath(
+                QString("%1_%2.%3").arg(m_qsName).arg(m_u32FileIndex++, 3, 10, QChar('0'))
+                                   .arg((m_sConfig.bBinary || m_sConfig.bCompress) ? "mklog" : "log"));
+
+    m_file.setFileName(qsFileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *pqsError = tr("Can't create log file %1: %2").arg(qsFileName, m_file.errorString());
+        return false;
+    }
+
+    m_u64FileBytes = 0;
+    m_i64FileOpenedMs = QDateTime::currentMSecsSinceEpoch();
+
+    if (m_sConfig.bBinary || m_sConfig.bCompress) {
+        sLogSinkFileHeader_t sHeader;
+        memcpy(sHeader.cMagic, LOG_SINK_FILE_MAGIC, sizeof(sHeader.cMagic));
+        sHeader.u8Binary = m_sConfig.bBinary;
+        sHeader.u8Compressed = m_sConfig.bCompress;
+        sHeader.u16HeaderLen = sizeof(sHeader);
+
+        if (m_file.write((const char *)&sHeader, sizeof(sHeader)) != sizeof(sHeader)) {
+            *pqsError = tr("Can't write log file %1: %2").arg(qsFileName, m_file.errorString());
+            m_file.close();
+            return false;
+        }
+
+        m_u64FileBytes = sizeof(sHeader);
+    }
+
+    return true;
+}
+
+void cLogSink::append(const char *pcText, uint32_t u32Len) {
+    appendLine(0, 0, 0, pcText, u32Len);
+}
+
+void cLogSink::append(uint8_t u8Addr, uint8_t u8Cmd, const char *pcText, uint32_t u32Len) {
+    appendLine(LOG_SINK_FLAG_FRAME, u8Addr, u8Cmd, pcText, u32Len);
+}
+
+void cLogSink::appendLine(uint8_t u8Flags, uint8_t u8Addr, uint8_t u8Cmd, const char *pcText, uint32_t u32Len) {
+    int64_t i64NowMs = QDateTime::currentMSecsSinceEpoch();
+
+    // the file is broken already, see writeFailed()
+    if (writeFailed())
+        return;
+
+    if (u32Len > 0xFFFF)
+        u32Len = 0xFFFF;
+
+    QMutexLocker locker(&m_mutex);
+
+    // a line never spans two buffers; a dropped buffer is just filled again
+    if (m_buffer.size() + sizeof(sLogSinkRecord_t) + sizeof(m_cPrefix) + 8 + u32Len > LOG_SINK_BUFFER_SIZE) {
+        queueLocked(&m_buffer);
+
+        // a recycled buffer keeps its reserved capacity
+        m_buffer.resize(0);
+        m_buffer.reserve(LOG_SINK_BUFFER_SIZE);
+    }
+
+    if (m_sConfig.bBinary) {
+        sLogSinkRecord_t sRecord;
+        sRecord.i64TimeUs = i64NowMs * 1000;
+        sRecord.u8Flags = u8Flags;
+        sRecord.u8Addr = u8Addr;
+        sRecord.u8Cmd = u8Cmd;
+        sRecord.u8Reserved = 0;
+        sRecord.u16Len = u32Len;
+
+        m_buffer.append((const char *)&sRecord, sizeof(sRecord));
+        m_buffer.append(pcText, u32Len);
+        return;
+    }
+
+    // the date and time are formatted once a second, only the milliseconds change from line to line
+    if (i64NowMs / 1000 != m_i64PrefixSecond) {
+        m_i64PrefixSecond = i64NowMs / 1000;
+
+        QByteArray baPrefix = QDateTime::fromMSecsSinceEpoch(m_i64PrefixSecond * 1000).toString("yyyy-MM-dd hh:mm:ss.").toLatin1();
+        qstrncpy(m_cPrefix, baPrefix.constData(), sizeof(m_cPrefix));
+    }
+
+    char cMs[16];
+    int iMs = i64NowMs % 1000;
+    cMs[0] = '0' + iMs / 100;
+    cMs[1] = '0' + (iMs / 10) % 10;
+    cMs[2] = '0' + iMs % 10;
+    cMs[3] = ' ';
+
+    m_buffer.append(m_cPrefix);
+    m_buffer.append(cMs, 4);
+    if (u8Flags & LOG_SINK_FLAG_FRAME)
+        m_buffer.append(QByteArray("<0x") + QByteArray::number(u8Addr, 16).rightJustified(2, '0') + "> ");
+    m_buffer.append(pcText, u32Len);
+    m_buffer.append('\n');
+}
+
+bool cLogSink::writeBuffer(const QByteArray &baBuffer) {
+    int64_t i64NowMs = QDateTime::currentMSecsSinceEpoch();
+
+    // rotation happens between buffers, which always end with a whole line
+    if ((m_sConfig.u32RotateBytes != 0 && m_u64FileBytes >= m_sConfig.u32RotateBytes) ||
+        (m_sConfig.u32RotateSeconds != 0 && i64NowMs - m_i64FileOpenedMs >= (int64_t)m_sConfig.u32RotateSeconds * 1000)) {
+        QString qsError;
+        if (!openNextFile(&qsError)) {
+            qDebug() << "log sink:" << qsError;
+            return false;
+        }
+    }
+
+    bool bWritten;
+    uint64_t u64Written;
+    if (m_sConfig.bCompress) {
+        QByteArray baBlock = qCompress(baBuffer);
+        uint32_t u32Len = baBlock.size();
+
+        bWritten = writeData(&u32Len, sizeof(u32Len), m_u64FileBytes) &&
+                   writeData(baBlock.constData(), baBlock.size(), m_u64FileBytes);
+        u64Written = sizeof(u32Len) + baBlock.size();
+    } else {
+        bWritten = writeData(baBuffer.constData(), baBuffer.size(), m_u64FileBytes);
+        u64Written = baBuffer.size();
+    }
+
+    if (!bWritten)
+        return false;
+
+    m_u64FileBytes += u64Written;
+    return true;
+}
+
+void cLogSink::takePartial(QList<QByteArray> *pBatch) {
+    if (m_buffer.isEmpty())
+        return;
+
+    pBatch->append(m_buffer);
+    m_buffer = QByteArray();
+    m_buffer.reserve(LOG_SINK_BUFFER_SIZE);
+}
+
+static void unpackRecords(QByteArray *pbaPending, QFile *output) {
+    int iPos = 0;
+
+    while (iPos + (int)sizeof(sLogSinkRecord_t) <= pbaPending->size()) {
+        sLogSinkRecord_t sRecord;
+        memcpy(&sRecord, pbaPending->constData() + iPos, sizeof(sRecord));
+
+        if (iPos + (int)sizeof(sRecord) + sRecord.u16Len > pbaPending->size())
+            break;
+
+        QByteArray baLine = QDateTime::fromMSecsSinceEpoch(sRecord.i64TimeUs / 1000).toString("yyyy-MM-dd hh:mm:ss.zzz ").toLatin1();
+        if (sRecord.u8Flags & LOG_SINK_FLAG_FRAME)
+            baLine += QByteArray("<0x") + QByteArray::number(sRecord.u8Addr, 16).rightJustified(2, '0') + "> ";
+        baLine.append(pbaPending->constData() + iPos + sizeof(sRecord), sRecord.u16Len);
+        baLine.append('\n');
+        output->write(baLine);
+
+        iPos += sizeof(sRecord) + sRecord.u16Len;
+    }
+
+    pbaPending->remove(0, iPos);
+}
+
+bool cLogSink::unpack(const QString &qsFileName, QFile *output, QString *pqsError) {
+    QFile input(qsFileName);
+    if (!input.open(QIODevice::ReadOnly)) {
+        *pqsError = QString("Can't open %1: %2").arg(qsFileName, input.errorString());
+        return false;
+    }
+
+    sLogSinkFileHeader_t sHeader;
+    if (input.read((char *)&sHeader, sizeof(sHeader)) != sizeof(sHeader) ||
+        memcmp(sHeader.cMagic, LOG_SINK_FILE_MAGIC, sizeof(sHeader.cMagic)) != 0) {
+        // plain text log
+        input.seek(0);
+        while (!input.atEnd())
+            output->write(input.read(LOG_SINK_BUFFER_SIZE));
+        return true;
+    }
+
+    input.seek(sHeader.u16HeaderLen);
+
+    QByteArray baPending;
+    while (!input.atEnd()) {
+        QByteArray baData;
+
+        if (sHeader.u8Compressed) {
+            uint32_t u32Len;
+            if (input.read((char *)&u32Len, sizeof(u32Len)) != sizeof(u32Len))
+                break;
+
+            // the length and qUncompress()'s size prefix come from the file, never trust them with an allocation
+            if (u32Len < 4 || u32Len > LOG_SINK_MAX_BLOCK_SIZE || u32Len > input.size() - input.pos()) {
+                *pqsError = QString("%1: damaged block at offset %2").arg(qsFileName).arg(input.pos() - sizeof(u32Len));
+                return false;
+            }
+
+            QByteArray baBlock = input.read(u32Len);
+            const uint8_t *pu8Block = (const uint8_t *)baBlock.constData();
+            uint32_t u32Expected = ((uint32_t)pu8Block[0] << 24) | (pu8Block[1] << 16) | (pu8Block[2] << 8) | pu8Block[3];
+
+            if (u32Expected > LOG_SINK_BUFFER_SIZE || (baData = qUncompress(baBlock)).isEmpty()) {
+                *pqsError = QString("%1: damaged block at offset %2").arg(qsFileName).arg(input.pos() - u32Len - sizeof(u32Len));
+                return false;
+            }
+        } else {
+            baData = input.read(LOG_SINK_BUFFER_SIZE);
+        }
+
+        if (sHeader.u8Binary) {
+            baPending.append(baData);
+            unpackRecords(&baPending, output);
+        } else {
+            output->write(baData);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,102 @@
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+#include <stdint.h>
+
+#include "bufferedfilewriter.h"
+
+// Session log on disk. Plain text files (*.log) have no header, one line per message:
+//   yyyy-MM-dd hh:mm:ss.zzz <0xAA> text
+// Binary or compressed files (*.mklog) start with sLogSinkFileHeader_t. Binary content is a
+// sequence of sLogSinkRecord_t + u16Len bytes of text. Compressed content is a sequence of
+// blocks: uint32_t length + qCompress() output of one buffer.
+
+#define LOG_SINK_FILE_MAGIC         "MKMXLOG1"
+#define LOG_SINK_BUFFER_SIZE        (256u << 10)    // lines are collected and written in buffers of this size
+#define LOG_SINK_FLUSH_INTERVAL     500             // [ms] a partly filled buffer waits at most this long
+#define LOG_SINK_MAX_QUEUED         64              // further buffers are dropped (and counted)
+// largest compressed block: qCompress() size prefix + zlib's compressBound() of a full buffer
+#define LOG_SINK_MAX_BLOCK_SIZE     (4 + LOG_SINK_BUFFER_SIZE + (LOG_SINK_BUFFER_SIZE >> 12) + (LOG_SINK_BUFFER_SIZE >> 14) + 13)
+
+#define LOG_SINK_FLAG_FRAME         0x01            // u8Addr and u8Cmd are valid
+
+#pragma pack(push, 1)
+
+typedef struct {
+    char cMagic[8];
+    uint8_t u8Binary;
+    uint8_t u8Compressed;
+    uint16_t u16HeaderLen;
+} sLogSinkFileHeader_t;
+
+typedef struct {
+    int64_t i64TimeUs;          // UTC
+    uint8_t u8Flags;
+    uint8_t u8Addr;
+    uint8_t u8Cmd;
+    uint8_t u8Reserved;
+    uint16_t u16Len;
+} sLogSinkRecord_t;
+
+#pragma pack(pop)
+
+typedef struct {
+    QString qsDirectory;        // empty: no log sink
+    uint32_t u32RotateBytes;    // start the next file after this many bytes (below 4 GiB), 0: no limit
+    uint32_t u32RotateSeconds;  // start the next file after this time, 0: no limit
+    bool bBinary;
+    bool bCompress;
+} sLogSinkConfig_t;
+
+// Streams log lines to <dir>/<name>_NNN.log (.mklog) from its own thread (cBufferedFileWriter).
+// append() may be called from any thread, it only copies the line into the current buffer.
+class cLogSink : public cBufferedFileWriter
+{
+    Q_OBJECT
+
+public:
+    cLogSink(QObject *parent = nullptr);
+    ~cLogSink();
+
+    bool open(const sLogSinkConfig_t &sConfig, const QString &qsName, QString *pqsError);
+    // writes what is left and closes the file
+    void close(void);
+
+    bool isOpen(void) const { return isRunning(); }
+
+    void append(const char *pcText, uint32_t u32Len);
+    void append(uint8_t u8Addr, uint8_t u8Cmd, const char *pcText, uint32_t u32Len);
+
+    // a failed rotation fails the writer like a failed write, see writeFailed()
+
+    // decodes a *.mklog file into text lines, plain *.log files are copied as they are;
+    // fails on a damaged or cut off compressed block, the lines before it are written already
+    static bool unpack(const QString &qsFileName, QFile *output, QString *pqsError);
+
+private:
+    sLogSinkConfig_t m_sConfig;
+    QString m_qsName;
+
+    // guarded by m_mutex
+    QByteArray m_buffer;
+
+    // text prefix "yyyy-MM-dd hh:mm:ss." of the last second
+    int64_t m_i64PrefixSecond;
+    char m_cPrefix[24];
+
+    // writer thread only
+    uint32_t m_u32FileIndex;
+    uint64_t m_u64FileBytes;
+    int64_t m_i64FileOpenedMs;
+
+    void appendLine(uint8_t u8Flags, uint8_t u8Addr, uint8_t u8Cmd, const char *pcText, uint32_t u32Len);
+    bool openNextFile(QString *pqsError);
+    bool writeBuffer(const QByteArray &baBuffer);
+    void takePartial(QList<QByteArray> *pBatch);
+};
+
+#endif // LOGSINK_H
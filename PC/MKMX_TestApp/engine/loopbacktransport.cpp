@@ -0,0 +1,112 @@
+#include "loopbacktransport.h"
+
+#include <QMetaObject>
+
+#include <string.h>
+
+#include "framebuilder.h"
+
+extern "C" {
+    #include "crc8_ccitt.h"
+}
+
+#define LOOPBACK_CMD_PING   0x00
+#define LOOPBACK_CMD_READ   0x01
+#define LOOPBACK_CMD_WRITE  0x02
+
+void cLoopbackEchoDevice::rxFromMaster(const uint8_t *pu8Data, uint32_t u32Len, cLoopbackTransport *link) {
+    link->deliver(pu8Data, u32Len);
+}
+
+cLoopbackMkmxDevice::cLoopbackMkmxDevice(uint8_t u8Address) :
+    m_u8Address(u8Address)
+{
+    MkmxMachineInit(&m_machine, &m_frame, u8Address, crc8_ccitt_update);
+
+    for (uint8_t i = 0; i < MKMX_MAX_INPUT_PAYLOAD_SIZE; i++)
+        m_u8Registers[i] = (uint8_t)(u8Address + i);
+}
+
+void cLoopbackMkmxDevice::rxFromMaster(const uint8_t *pu8Data, uint32_t u32Len, cLoopbackTransport *link) {
+    for (uint32_t i = 0; i < u32Len; i++) {
+        MkmxMachineUpdate(&m_machine, pu8Data[i]);
+
+        if (MkmxMachineIsReady(&m_machine)) {
+            answer(link);
+            MkmxMachineDiscardFrame(&m_machine);
+        }
+    }
+}
+
+void cLoopbackMkmxDevice::answer(cLoopbackTransport *link) {
+    uint8_t u8Answer[FRAME_OVERHEAD_LENGTH + MKMX_MAX_INPUT_PAYLOAD_SIZE];
+    const uint8_t *pu8Payload;
+    uint8_t u8Len;
+
+    switch (m_frame.command) {
+    case LOOPBACK_CMD_PING:
+        pu8Payload = nullptr;
+        u8Len = 0;
+        break;
+
+    case LOOPBACK_CMD_READ:
+        pu8Payload = m_u8Registers;
+        u8Len = (m_frame.payloadLength != 0) ? qMin(m_frame.payload[0], (uint8_t)MKMX_MAX_INPUT_PAYLOAD_SIZE) : 0;
+        break;
+
+    case LOOPBACK_CMD_WRITE:
+        memcpy(m_u8Registers, m_frame.payload, m_frame.payloadLength);
+        pu8Payload = nullptr;
+        u8Len = 0;
+        break;
+
+    default:
+        pu8Payload = m_frame.payload;
+        u8Len = m_frame.payloadLength;
+        break;
+    }
+
+    link->deliver(u8Answer, buildFrame(u8Answer, m_u8Address, m_frame.command, pu8Payload, u8Len));
+}
+
+cLoopbackTransport::cLoopbackTransport(cLoopbackDevice *device, QObject *parent) :
+    cTransport(parent),
+    m_device(device),
+    m_bReadyReadPending(false)
+{
+    if (m_device == nullptr)
+        m_device = new cLoopbackEchoDevice;
+}
+
+cLoopbackTransport::~cLoopbackTransport() {
+    delete m_device;
+}
+
+QByteArray cLoopbackTransport::readAll(void) {
+    QByteArray baData;
+    baData.swap(m_baRx);
+
+    return baData;
+}
+
+bool cLoopbackTransport::write(const uint8_t *pu8Data, uint32_t u32Len) {
+    m_device->rxFromMaster(pu8Data, u32Len, this);
+    emit bytesWritten(u32Len);
+
+    return true;
+}
+
+void cLoopbackTransport::deliver(const uint8_t *pu8Data, uint32_t u32Len) {
+    m_baRx.append((const char *)pu8Data, u32Len);
+
+    // queued, so a device answering from inside write() does not re-enter the reader,
+    // and data delivered in one go is signalled once
+    if (!m_bReadyReadPending) {
+        m_bReadyReadPending = true;
+
+        QMetaObject::invokeMethod(this, [this]() {
+            m_bReadyReadPending = false;
+            emit readyRead();
+        }, Qt::QueuedConnection);
+    }
+}
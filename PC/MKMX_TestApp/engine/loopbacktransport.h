@@ -0,0 +1,79 @@
+#ifndef LOOPBACKTRANSPORT_H
+#define LOOPBACKTRANSPORT_H
+
+#include "transport.h"
+
+extern "C" {
+    #include "mkmx_state_machine.h"
+}
+
+class cLoopbackTransport;
+
+// in-process peer of cLoopbackTransport, gets everything the engine transmits
+// and answers through cLoopbackTransport::deliver()
+class cLoopbackDevice
+{
+public:
+    virtual ~cLoopbackDevice() {}
+
+    virtual void rxFromMaster(const uint8_t *pu8Data, uint32_t u32Len, cLoopbackTransport *link) = 0;
+};
+
+// sends every byte straight back
+class cLoopbackEchoDevice : public cLoopbackDevice
+{
+public:
+    void rxFromMaster(const uint8_t *pu8Data, uint32_t u32Len, cLoopbackTransport *link);
+};
+
+// MKMX slave running the firmware state machine (MCU/MkmxStateMachine), answers frames for its
+// address with the same commands as the sim/mkmx_farm slaves:
+//   0x00 ping   answers an empty payload
+//   0x01 read   answers payload[0] bytes of the slave registers
+//   0x02 write  stores the payload in the registers, answers an empty payload
+//   others      echoed back
+class cLoopbackMkmxDevice : public cLoopbackDevice
+{
+public:
+    cLoopbackMkmxDevice(uint8_t u8Address);
+
+    void rxFromMaster(const uint8_t *pu8Data, uint32_t u32Len, cLoopbackTransport *link);
+
+private:
+    MkmxMachine_t m_machine;
+    MkmxFrame_t m_frame;
+    uint8_t m_u8Address;
+    uint8_t m_u8Registers[MKMX_MAX_INPUT_PAYLOAD_SIZE];
+
+    void answer(cLoopbackTransport *link);
+};
+
+// Connects the engine TX directly to a simulated device RX without any wire in between,
+// so the parser, CRC, queues and signal delivery run at memory speed.
+class cLoopbackTransport : public cTransport
+{
+    Q_OBJECT
+public:
+    // takes ownership of the device, nullptr selects cLoopbackEchoDevice
+    cLoopbackTransport(cLoopbackDevice *device = nullptr, QObject *parent = nullptr);
+    ~cLoopbackTransport();
+
+    bool open(QString *pqsError) { Q_UNUSED(pqsError); return true; }
+    void close(void) { m_baRx.clear(); }
+
+    QByteArray readAll(void);
+    bool write(const uint8_t *pu8Data, uint32_t u32Len);
+
+    QString name(void) const { return "loop:"; }
+
+    // device side: queue data for the engine, readyRead() follows from the event loop
+    void deliver(const uint8_t *pu8Data, uint32_t u32Len);
+
+private:
+    cLoopbackDevice *m_device;
+
+    QByteArray m_baRx;
+    bool m_bReadyReadPending;
+};
+
+#endif // LOOPBACKTRANSPORT_H
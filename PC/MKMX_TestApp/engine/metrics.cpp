@@ -0,0 +1,105 @@
+#include "metrics.h"
+
+#include <chrono>
+
+#define METRICS_FRAME_KEYS  (256 * 256)
+
+static_assert((TX_STAMP_BUFFER_LENGTH & (TX_STAMP_BUFFER_LENGTH - 1)) == 0, "TX_STAMP_BUFFER_LENGTH must be a power of two");
+
+cEngineMetrics::cEngineMetrics() :
+    m_pu64Frames(new std::atomic<uint64_t>[METRICS_FRAME_KEYS])
+{
+    reset();
+}
+
+void cEngineMetrics::reset(void) {
+    m_u64RxBytes.store(0, std::memory_order_relaxed);
+    m_u64TxBytes.store(0, std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < METRICS_FRAME_KEYS; i++)
+        m_pu64Frames[i].store(0, std::memory_order_relaxed);
+
+    m_u64Frames.store(0, std::memory_order_relaxed);
+    m_u64CrcErrors.store(0, std::memory_order_relaxed);
+    m_u64MaxPayloadErrors.store(0, std::memory_order_relaxed);
+    m_u64Resyncs.store(0, std::memory_order_relaxed);
+    m_u64SkippedBytes.store(0, std::memory_order_relaxed);
+    m_u64RecoveredFrames.store(0, std::memory_order_relaxed);
+    m_u64RxTimeouts.store(0, std::memory_order_relaxed);
+
+    m_u32TxQueueHighWater.store(0, std::memory_order_relaxed);
+
+    m_txLatency.reset();
+}
+
+uint64_t cEngineMetrics::nowNs(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void cEngineMetrics::decoderStats(const sDecoderStats_t *psStats) {
+    m_u64Frames.store(psStats->u64Frames, std::memory_order_relaxed);
+    m_u64CrcErrors.store(psStats->u64CrcErrors, std::memory_order_relaxed);
+    m_u64MaxPayloadErrors.store(psStats->u64MaxPayloadErrors, std::memory_order_relaxed);
+    m_u64Resyncs.store(psStats->u64Resyncs, std::memory_order_relaxed);
+    m_u64SkippedBytes.store(psStats->u64SkippedBytes, std::memory_order_relaxed);
+    m_u64RecoveredFrames.store(psStats->u64RecoveredFrames, std::memory_order_relaxed);
+    m_u64RxTimeouts.store(psStats->u64Timeouts, std::memory_order_relaxed);
+}
+
+void cEngineMetrics::txQueueLevel(uint32_t u32Bytes) {
+    uint32_t u32Max = m_u32TxQueueHighWater.load(std::memory_order_relaxed);
+
+    while (u32Bytes > u32Max && !m_u32TxQueueHighWater.compare_exchange_weak(u32Max, u32Bytes, std::memory_order_relaxed))
+        ;
+}
+
+cTxLatencyTracker::cTxLatencyTracker() :
+    m_stamps(m_u8StampBuffer, TX_STAMP_BUFFER_LENGTH),
+    m_u32Queued(0),
+    m_u32Written(0),
+    m_bStampPending(false)
+{
+}
+
+void cTxLatencyTracker::reset(void) {
+    // bytes lost with the previous session must not shift the positions of the next one
+    m_stamps.flush();
+    m_u32Queued = 0;
+    m_u32Written = 0;
+    m_bStampPending = false;
+}
+
+bool cTxLatencyTracker::stamp(uint32_t u32FrameLen) {
+    if (m_stamps.freeBytes() < sizeof(sTxStamp_t))
+        return false;
+
+    sTxStamp_t sStamp;
+    sStamp.u32EndPos = m_u32Queued + u32FrameLen;
+    sStamp.u64QueuedNs = cEngineMetrics::nowNs();
+
+    m_stamps.push((const uint8_t *)&sStamp, sizeof(sStamp));
+
+    return true;
+}
+
+void cTxLatencyTracker::written(uint32_t u32Bytes, cEngineMetrics *metrics) {
+    m_u32Written += u32Bytes;
+
+    uint64_t u64NowNs = cEngineMetrics::nowNs();
+    for (;;) {
+        if (!m_bStampPending) {
+            if (m_stamps.usedBytes() < sizeof(m_sStamp))
+                break;
+
+            m_stamps.pop((uint8_t *)&m_sStamp, sizeof(m_sStamp));
+            m_bStampPending = true;
+        }
+
+        // the positions run freely, so compare the difference
+        if ((int32_t)(m_sStamp.u32EndPos - m_u32Written) > 0)
+            break;
+
+        metrics->txLatency(u64NowNs - m_sStamp.u64QueuedNs);
+        m_bStampPending = false;
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <memory>
+
+#include <stdint.h>
+
+#include "framedecoder.h"
+#include "utils/hdrhistogram.h"
+#include "utils/spscqueue.h"
+
+#define TX_STAMP_BUFFER_LENGTH  4096    // room for 256 frames waiting in a TX queue
+
+// Counters of the live session. Writers are the interface thread (RX, TX, decoder) and the GUI thread
+// (TX queue), the status panel reads them at any time; everything is a relaxed atomic, nothing blocks.
+class cEngineMetrics
+{
+public:
+    cEngineMetrics();
+
+    // at the start of a session, while no interface thread runs
+    void reset(void);
+
+    static uint64_t nowNs(void);
+
+    void rxBytes(uint32_t u32Bytes) { m_u64RxBytes.fetch_add(u32Bytes, std::memory_order_relaxed); }
+    void txBytes(uint32_t u32Bytes) { m_u64TxBytes.fetch_add(u32Bytes, std::memory_order_relaxed); }
+    void frame(uint8_t u8Addr, uint8_t u8Cmd) { m_pu64Frames[(u8Addr << 8) | u8Cmd].fetch_add(1, std::memory_order_relaxed); }
+    // copies the totals of the decoder, which keeps plain counters of its own
+    void decoderStats(const sDecoderStats_t *psStats);
+    void txQueueLevel(uint32_t u32Bytes);
+    void txLatency(uint64_t u64Ns) { m_txLatency.record(u64Ns); }
+
+    uint64_t rxBytes(void) const { return m_u64RxBytes.load(std::memory_order_relaxed); }
+    uint64_t txBytes(void) const { return m_u64TxBytes.load(std::memory_order_relaxed); }
+    uint64_t frames(uint8_t u8Addr, uint8_t u8Cmd) const { return m_pu64Frames[(u8Addr << 8) | u8Cmd].load(std::memory_order_relaxed); }
+    uint64_t frames(void) const { return m_u64Frames.load(std::memory_order_relaxed); }
+    uint64_t crcErrors(void) const { return m_u64CrcErrors.load(std::memory_order_relaxed); }
+    uint64_t maxPayloadErrors(void) const { return m_u64MaxPayloadErrors.load(std::memory_order_relaxed); }
+    uint64_t resyncs(void) const { return m_u64Resyncs.load(std::memory_order_relaxed); }
+    uint64_t skippedBytes(void) const { return m_u64SkippedBytes.load(std::memory_order_relaxed); }
+    uint64_t recoveredFrames(void) const { return m_u64RecoveredFrames.load(std::memory_order_relaxed); }
+    uint64_t rxTimeouts(void) const { return m_u64RxTimeouts.load(std::memory_order_relaxed); }
+    uint32_t txQueueHighWater(void) const { return m_u32TxQueueHighWater.load(std::memory_order_relaxed); }
+    // from txData() until the last byte of the frame is written to the device (driver, socket)
+    const cHdrHistogram &txLatency(void) const { return m_txLatency; }
+
+private:
+    std::atomic<uint64_t> m_u64RxBytes;
+    std::atomic<uint64_t> m_u64TxBytes;
+
+    // indexed by (addr << 8) | cmd
+    std::unique_ptr<std::atomic<uint64_t>[]> m_pu64Frames;
+
+    std::atomic<uint64_t> m_u64Frames;
+    std::atomic<uint64_t> m_u64CrcErrors;
+    std::atomic<uint64_t> m_u64MaxPayloadErrors;
+    std::atomic<uint64_t> m_u64Resyncs;
+    std::atomic<uint64_t> m_u64SkippedBytes;
+    std::atomic<uint64_t> m_u64RecoveredFrames;
+    std::atomic<uint64_t> m_u64RxTimeouts;
+
+    std::atomic<uint32_t> m_u32TxQueueHighWater;
+
+    cHdrHistogram m_txLatency;
+};
+
+// TX latency of one TX queue. Every queued frame gets a stamp: the queue position right after it and
+// the time it was queued. The frame is measured once the last byte at that position is written.
+// stamp() and queued() belong to the producer of the TX queue, written() to the thread writing it out.
+class cTxLatencyTracker
+{
+public:
+    cTxLatencyTracker();
+
+    // while neither side runs
+    void reset(void);
+
+    // before the frame goes into the TX queue, so its bytes are never written before the stamp is seen;
+    // false without room for the stamp (the frame is just not measured)
+    bool stamp(uint32_t u32FrameLen);
+    // after the frame is in the TX queue
+    void queued(uint32_t u32FrameLen) { m_u32Queued += u32FrameLen; }
+
+    // records the latency of every frame whose last byte is written now
+    void written(uint32_t u32Bytes, cEngineMetrics *metrics);
+
+private:
+    typedef struct {
+        uint32_t u32EndPos;
+        uint64_t u64QueuedNs;
+    } sTxStamp_t;
+
+    uint8_t m_u8StampBuffer[TX_STAMP_BUFFER_LENGTH];
+    cSpscByteQueue m_stamps;
+    uint32_t m_u32Queued;       // producer side
+    uint32_t m_u32Written;      // consumer side
+    sTxStamp_t m_sStamp;        // consumer side, popped but its frame is not written yet
+    bool m_bStampPending;
+};
+
+#endif // METRICS_H
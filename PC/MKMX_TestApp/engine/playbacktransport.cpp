@@ -0,0 +1,218 @@
+#include "playbacktransport.h"
+
+void initPlaybackControl(sPlaybackControl_t *psControl) {
+    psControl->u32Speed = 1;
+    psControl->bPaused = false;
+    psControl->i64SeekNs = -1;
+    psControl->u64PositionNs = 0;
+    psControl->u64DurationNs = 0;
+    psControl->bActive = false;
+}
+
+cPlaybackTransport::cPlaybackTransport(const QString &qsFileName, int iPortId, QObject *parent) :
+    cTransport(parent),
+    m_qsFileName(qsFileName),
+    m_iPortId(iPortId),
+    m_u8PortId(0),
+    m_psControl(&m_sOwnControl),
+    m_timer(this),
+    m_u64AnchorNs(0),
+    m_u32Speed(1),
+    m_bPaused(false),
+    m_bHasNext(false)
+{
+    initPlaybackControl(&m_sOwnControl);
+
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+
+    connect(&m_timer, &QTimer::timeout, this, &cPlaybackTransport::tick);
+}
+
+cPlaybackTransport::~cPlaybackTransport() {
+    close();
+}
+
+bool cPlaybackTransport::open(QString *pqsError) {
+    if (!m_reader.open(m_qsFileName, pqsError))
+        return false;
+
+    if (!selectPort(pqsError)) {
+        m_reader.close();
+        return false;
+    }
+
+    sPlaybackControl_t *psControl = m_psControl;
+    psControl->i64SeekNs = -1;
+    psControl->bPaused = false;
+    psControl->u64PositionNs = 0;
+    psControl->u64DurationNs = m_reader.durationNs();
+    psControl->bActive = true;
+
+    m_u32Speed = qMax(psControl->u32Speed.load(), 1u);
+    m_bPaused = false;
+    anchor(0);
+    fetchNext();
+
+    m_timer.start(0);
+
+    return true;
+}
+
+void cPlaybackTransport::close(void) {
+    m_timer.stop();
+    m_reader.close();
+
+    m_bHasNext = false;
+    m_baRx.clear();
+
+    m_psControl->bActive = false;
+}
+
+QString cPlaybackTransport::name(void) const {
+    if (m_iPortId < 0)
+        return "play:" + m_qsFileName;
+
+    return QString("play:%1#%2").arg(m_qsFileName).arg(m_iPortId);
+}
+
+bool cPlaybackTransport::selectPort(QString *pqsError) {
+    if (m_iPortId >= 0) {
+        m_u8PortId = (uint8_t)m_iPortId;
+        return true;
+    }
+
+    // the decoder of one interface must not see the bytes of several ports
+    int iPorts = 0;
+
+    const uint8_t *pu8RxPorts = m_reader.rxPorts();
+    if (pu8RxPorts != nullptr) {
+        for (int i = 0; i < 256; i++) {
+            if (pu8RxPorts[i >> 3] & (1u << (i & 7))) {
+                m_u8PortId = (uint8_t)i;
+                iPorts++;
+            }
+        }
+    } else {
+        // no port set in the file (not closed cleanly, or older than version 3): one pass over the records
+        bool bPorts[256] = { false };
+
+        sCaptureRecord_t sRecord;
+        while (m_reader.nextRecord(&sRecord)) {
+            if ((sRecord.u8Flags & (CAPTURE_FLAG_TX | CAPTURE_FLAGS_CONTROL)) || bPorts[sRecord.u8PortId])
+                continue;
+
+            bPorts[sRecord.u8PortId] = true;
+            m_u8PortId = sRecord.u8PortId;
+            iPorts++;
+        }
+        m_reader.rewind();
+    }
+
+    if (iPorts > 1) {
+        *pqsError = QString("%1 holds %2 ports, choose one with play:<file>#<port id>").arg(m_qsFileName).arg(iPorts);
+        return false;
+    }
+
+    return true;
+}
+
+QByteArray cPlaybackTransport::readAll(void) {
+    QByteArray baData;
+    baData.swap(m_baRx);
+
+    return baData;
+}
+
+uint64_t cPlaybackTransport::now(void) const {
+    return m_u64AnchorNs + (uint64_t)m_clock.nsecsElapsed() * m_u32Speed;
+}
+
+void cPlaybackTransport::anchor(uint64_t u64TimeNs) {
+    m_u64AnchorNs = u64TimeNs;
+    m_clock.start();
+}
+
+void cPlaybackTransport::fetchNext(void) {
+    // TX records are the engine's own traffic, it transmits again by itself; of the control records
+    // only the resets matter, tick() passes them on as discontinuities
+    while ((m_bHasNext = m_reader.nextRecord(&m_sNext)) &&
+           ((m_sNext.u8Flags & (CAPTURE_FLAG_TX | CAPTURE_FLAG_LINE)) || m_sNext.u8PortId != m_u8PortId))
+        ;
+}
+
+void cPlaybackTransport::tick(void) {
+    sPlaybackControl_t *psControl = m_psControl;
+
+    int64_t i64SeekNs = psControl->i64SeekNs.exchange(-1);
+    if (i64SeekNs >= 0) {
+        m_reader.seek(i64SeekNs);
+        fetchNext();
+        anchor(i64SeekNs);
+
+        psControl->u64PositionNs = i64SeekNs;
+
+        // whatever the decoder holds belongs to the old position
+        m_baRx.clear();
+        emit discontinuity();
+    }
+
+    uint32_t u32Speed = qMax(psControl->u32Speed.load(), 1u);
+
+    if (psControl->bPaused) {
+        // the clock stands still while paused: freeze the position once, a new speed applies from the resume
+        if (!m_bPaused) {
+            anchor(now());
+            m_bPaused = true;
+        }
+        m_u32Speed = u32Speed;
+
+        m_timer.start(PLAYBACK_MAX_TICK_INTERVAL);
+        return;
+    }
+
+    if (m_bPaused) {
+        // restart from the frozen position, the paused time does not count
+        anchor(m_u64AnchorNs);
+        m_bPaused = false;
+    }
+
+    if (u32Speed != m_u32Speed) {
+        anchor(now());
+        m_u32Speed = u32Speed;
+    }
+
+    uint64_t u64NowNs = now();
+    bool bDelivered = false;
+
+    while (m_bHasNext && m_sNext.u64TimeNs <= u64NowNs) {
+        if (m_sNext.u8Flags & CAPTURE_FLAG_RESET) {
+            // bytes before the reset still belong to the frame in progress
+            if (bDelivered)
+                emit readyRead();
+            bDelivered = false;
+
+            emit discontinuity();
+        } else {
+            m_baRx.append((const char *)m_sNext.pu8Data, m_sNext.u32Len);
+            bDelivered = true;
+        }
+
+        fetchNext();
+    }
+
+    if (bDelivered)
+        emit readyRead();
+
+    psControl->u64PositionNs = qMin(u64NowNs, psControl->u64DurationNs.load());
+
+    // at the end the playback idles, a seek may start it again;
+    // everything due is delivered, so wait at least 1 ms (rounded up) instead of spinning on a 0 ms timer
+    int iDelayMs = PLAYBACK_MAX_TICK_INTERVAL;
+    if (m_bHasNext) {
+        uint64_t u64WaitMs = ((m_sNext.u64TimeNs - u64NowNs) / m_u32Speed + 999999) / 1000000;
+        iDelayMs = (int)qBound<uint64_t>(1, u64WaitMs, PLAYBACK_MAX_TICK_INTERVAL);
+    }
+
+    m_timer.start(iDelayMs);
+}
@@ -0,0 +1,84 @@
+#ifndef PLAYBACKTRANSPORT_H
+#define PLAYBACKTRANSPORT_H
+
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include <atomic>
+
+#include "transport.h"
+#include "capturereader.h"
+
+// poll period of the control block while paused or when the next record is far away
+#define PLAYBACK_MAX_TICK_INTERVAL  50
+
+// Written by the GUI thread, read by the playback in the interface thread.
+// The owner (the engine) hands it to the transport with setControl().
+typedef struct sPlaybackControl {
+    std::atomic<uint32_t> u32Speed;         // 1, 10, 100, ... times the real time
+    std::atomic<bool> bPaused;
+    std::atomic<int64_t> i64SeekNs;         // requested position, -1 when none
+    std::atomic<uint64_t> u64PositionNs;    // reported back by the playback
+    std::atomic<uint64_t> u64DurationNs;
+    std::atomic<bool> bActive;
+} sPlaybackControl_t;
+
+void initPlaybackControl(sPlaybackControl_t *psControl);
+
+// Plays the RX records of a capture (capturefile.h) back with their original timing,
+// scaled by the requested speed. The engine sees a live device; transmitted data is dropped.
+// Port specification: "play:<capture file>" or "play:<capture file>#<port id>"; a capture of
+// several ports (reactor session) plays one of them and needs the port id.
+class cPlaybackTransport : public cTransport
+{
+    Q_OBJECT
+public:
+    // iPortId < 0: the only port of the capture
+    cPlaybackTransport(const QString &qsFileName, int iPortId, QObject *parent = nullptr);
+    ~cPlaybackTransport();
+
+    // call before open(); without it the playback runs at real time on a block of its own
+    void setControl(sPlaybackControl_t *psControl) { m_psControl = psControl; }
+
+    bool open(QString *pqsError);
+    void close(void);
+
+    QByteArray readAll(void);
+    bool write(const uint8_t *pu8Data, uint32_t u32Len) { Q_UNUSED(pu8Data); emit bytesWritten(u32Len); return true; }
+
+    QString name(void) const;
+
+private slots:
+    void tick(void);
+
+private:
+    QString m_qsFileName;
+    int m_iPortId;
+    cCaptureReader m_reader;
+
+    // port whose records are played
+    uint8_t m_u8PortId;
+
+    sPlaybackControl_t m_sOwnControl;
+    sPlaybackControl_t *m_psControl;
+
+    QTimer m_timer;
+    QByteArray m_baRx;
+
+    // capture time m_u64AnchorNs corresponds to the start of m_clock
+    QElapsedTimer m_clock;
+    uint64_t m_u64AnchorNs;
+    uint32_t m_u32Speed;
+    bool m_bPaused;
+
+    // first record not delivered yet
+    sCaptureRecord_t m_sNext;
+    bool m_bHasNext;
+
+    bool selectPort(QString *pqsError);
+    uint64_t now(void) const;
+    void anchor(uint64_t u64TimeNs);
+    void fetchNext(void);
+};
+
+#endif // PLAYBACKTRANSPORT_H
@@ -0,0 +1,173 @@
+#include "ptytransport.h"
+
+#include <QSocketNotifier>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define PTY_READ_CHUNK_LENGTH   4096
+
+static void makeRaw(int iFd) {
+    struct termios tio;
+
+    if (tcgetattr(iFd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(iFd, TCSANOW, &tio);
+    }
+}
+
+cPtyTransport::cPtyTransport(const QString &qsPath, QObject *parent) :
+    cTransport(parent),
+    m_qsPath(qsPath),
+    m_qsName(qsPath),
+    m_iFd(-1),
+    m_iSlaveFd(-1),
+    m_readNotifier(nullptr),
+    m_writeNotifier(nullptr)
+{
+}
+
+cPtyTransport::~cPtyTransport() {
+    close();
+}
+
+bool cPtyTransport::open(QString *pqsError) {
+    if (m_qsPath.isEmpty()) {
+        m_iFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+        if ((m_iFd < 0) || (grantpt(m_iFd) != 0) || (unlockpt(m_iFd) != 0)) {
+            *pqsError = tr("Can't create pseudo-terminal: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+            close();
+            return false;
+        }
+
+        m_qsName = QString::fromLocal8Bit(ptsname(m_iFd));
+        m_iSlaveFd = ::open(ptsname(m_iFd), O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (m_iSlaveFd >= 0)
+            makeRaw(m_iSlaveFd);
+    } else {
+        m_iFd = ::open(m_qsPath.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+        if (m_iFd < 0) {
+            *pqsError = tr("Can't open %1: %2").arg(m_qsPath, QString::fromLocal8Bit(strerror(errno)));
+            return false;
+        }
+    }
+
+    makeRaw(m_iFd);
+
+    m_readNotifier = new QSocketNotifier(m_iFd, QSocketNotifier::Read, this);
+    connect(m_readNotifier, &QSocketNotifier::activated, this, &cTransport::readyRead);
+
+    m_writeNotifier = new QSocketNotifier(m_iFd, QSocketNotifier::Write, this);
+    m_writeNotifier->setEnabled(false);
+    connect(m_writeNotifier, &QSocketNotifier::activated, this, [this]() {
+        writePending();
+    });
+
+    return true;
+}
+
+void cPtyTransport::close(void) {
+    delete m_readNotifier;
+    m_readNotifier = nullptr;
+    delete m_writeNotifier;
+    m_writeNotifier = nullptr;
+
+    if (m_iSlaveFd >= 0)
+        ::close(m_iSlaveFd);
+    m_iSlaveFd = -1;
+
+    if (m_iFd >= 0)
+        ::close(m_iFd);
+    m_iFd = -1;
+
+    m_baTxPending.clear();
+}
+
+QByteArray cPtyTransport::readAll(void) {
+    QByteArray baData;
+
+    for (;;) {
+        int iOldSize = baData.size();
+        baData.resize(iOldSize + PTY_READ_CHUNK_LENGTH);
+
+        ssize_t n = ::read(m_iFd, baData.data() + iOldSize, PTY_READ_CHUNK_LENGTH);
+        baData.resize(iOldSize + ((n > 0) ? n : 0));
+
+        if (n == PTY_READ_CHUNK_LENGTH)
+            continue;
+        if (n > 0)
+            break;
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        // EOF or EIO: the other end went away
+        if (m_readNotifier != nullptr)
+            m_readNotifier->setEnabled(false);
+        emit fatalError(tr("%1 closed by the other side").arg(m_qsName));
+        break;
+    }
+
+    return baData;
+}
+
+bool cPtyTransport::writePending(void) {
+    while (!m_baTxPending.isEmpty()) {
+        ssize_t n = ::write(m_iFd, m_baTxPending.constData(), m_baTxPending.size());
+
+        if (n > 0) {
+            m_baTxPending.remove(0, n);
+            emit bytesWritten(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            emit fatalError(tr("Write to %1 failed: %2").arg(m_qsName, QString::fromLocal8Bit(strerror(errno))));
+            m_baTxPending.clear();
+            return false;
+        }
+    }
+
+    // wait for the line to drain before writing the rest
+    if (m_writeNotifier != nullptr)
+        m_writeNotifier->setEnabled(!m_baTxPending.isEmpty());
+
+    return true;
+}
+
+bool cPtyTransport::write(const uint8_t *pu8Data, uint32_t u32Len) {
+    if (m_iFd < 0)
+        return false;
+
+    m_baTxPending.append((const char *)pu8Data, u32Len);
+
+    return writePending();
+}
+
+bool cPtyTransport::waitForBytesWritten(int iMsecs) {
+    while (!m_baTxPending.isEmpty()) {
+        struct pollfd sPoll;
+        sPoll.fd = m_iFd;
+        sPoll.events = POLLOUT;
+        sPoll.revents = 0;
+
+        if (poll(&sPoll, 1, iMsecs) <= 0)
+            return false;
+
+        if (!writePending())
+            return false;
+    }
+
+    return true;
+}
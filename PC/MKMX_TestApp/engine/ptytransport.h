@@ -0,0 +1,44 @@
+#ifndef PTYTRANSPORT_H
+#define PTYTRANSPORT_H
+
+#include "transport.h"
+
+class QSocketNotifier;
+
+// Linux pseudo-terminal (or any tty device node) driven through its file descriptor.
+// With an empty path a new pty pair is created and name() returns the slave path,
+// so a device simulator can be started on it.
+class cPtyTransport : public cTransport
+{
+    Q_OBJECT
+public:
+    cPtyTransport(const QString &qsPath, QObject *parent = nullptr);
+    ~cPtyTransport();
+
+    bool open(QString *pqsError);
+    void close(void);
+
+    QByteArray readAll(void);
+    bool write(const uint8_t *pu8Data, uint32_t u32Len);
+    bool waitForBytesWritten(int iMsecs);
+
+    QString name(void) const { return m_qsName; }
+
+private:
+    QString m_qsPath;
+    QString m_qsName;
+
+    int m_iFd;
+    // our own handle of the slave end of a pty we created, keeps the master from reporting EIO
+    // while no simulator is attached yet
+    int m_iSlaveFd;
+
+    QSocketNotifier *m_readNotifier;
+    QSocketNotifier *m_writeNotifier;
+
+    QByteArray m_baTxPending;
+
+    bool writePending(void);
+};
+
+#endif // PTYTRANSPORT_H
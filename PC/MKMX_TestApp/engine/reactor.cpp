@@ -0,0 +1,435 @@
+#include "reactor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "framebuilder.h"
+#include "capturewriter.h"
+#include "metrics.h"
+
+#include "utils/tracetools.h"
+
+#define REACTOR_WAKE_EVENT_ID   0xFFFFFFFFu
+#define REACTOR_MAX_EVENTS      64
+
+static bool baudToSpeed(int iBaudRate, speed_t *pSpeed) {
+    switch (iBaudRate) {
+        case 1200:      *pSpeed = B1200;    return true;
+        case 2400:      *pSpeed = B2400;    return true;
+        case 4800:      *pSpeed = B4800;    return true;
+        case 9600:      *pSpeed = B9600;    return true;
+        case 19200:     *pSpeed = B19200;   return true;
+        case 38400:     *pSpeed = B38400;   return true;
+        case 57600:     *pSpeed = B57600;   return true;
+        case 115200:    *pSpeed = B115200;  return true;
+        case 230400:    *pSpeed = B230400;  return true;
+        case 460800:    *pSpeed = B460800;  return true;
+        case 921600:    *pSpeed = B921600;  return true;
+        default:
+            return false;
+    }
+}
+
+cReactor::sReactorPort::sReactorPort() :
+    iFd(-1),
+    bOnline(false),
+    u64CharacterNs(0),
+    txQueue(u8TxBuffer, REACTOR_TX_BUFFER_LENGTH),
+    bTxPending(false),
+    u32StagedPos(0),
+    u32StagedLen(0),
+    bWaitingForWrite(false)
+{
+}
+
+cReactor::cReactor(QObject *parent) :
+    QThread(parent),
+    m_epollFd(-1),
+    m_wakeFd(-1),
+    m_stopRequest(false),
+    m_wakePending(false),
+    m_capture(nullptr),
+    m_metrics(nullptr),
+    m_u32InterByteTimeoutChars(0)
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0) {
+        m_qsError = tr("Can't create the epoll instance: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        return;
+    }
+
+    // without it stop() could not wake the thread up
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0) {
+        m_qsError = tr("Can't create the wake-up eventfd: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = REACTOR_WAKE_EVENT_ID;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev) != 0)
+        m_qsError = tr("Can't watch the wake-up eventfd: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+}
+
+cReactor::~cReactor() {
+    stop();
+
+    for (size_t i = 0; i < m_ports.size(); i++) {
+        if (m_ports[i]->iFd >= 0)
+            ::close(m_ports[i]->iFd);
+    }
+
+    if (m_wakeFd >= 0)
+        ::close(m_wakeFd);
+    if (m_epollFd >= 0)
+        ::close(m_epollFd);
+}
+
+int cReactor::addPort(const QString &qsPortName, int iBaudRate, QString *pqsError) {
+    QString qsDevice = qsPortName.startsWith('/') ? qsPortName : QString("/dev/") + qsPortName;
+
+    speed_t speed;
+    if (!baudToSpeed(iBaudRate, &speed)) {
+        *pqsError = tr("Unsupported baud rate %1").arg(iBaudRate);
+        return -1;
+    }
+
+    int iFd = ::open(qsDevice.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (iFd < 0) {
+        *pqsError = tr("Can't open %1: %2").arg(qsDevice, QString::fromLocal8Bit(strerror(errno)));
+        return -1;
+    }
+
+    // raw 8N1, no flow control
+    struct termios tio;
+    if (tcgetattr(iFd, &tio) != 0) {
+        *pqsError = tr("Can't read settings of %1: %2").arg(qsDevice, QString::fromLocal8Bit(strerror(errno)));
+        ::close(iFd);
+        return -1;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    if (tcsetattr(iFd, TCSANOW, &tio) != 0) {
+        *pqsError = tr("Can't configure %1: %2").arg(qsDevice, QString::fromLocal8Bit(strerror(errno)));
+        ::close(iFd);
+        return -1;
+    }
+
+    int iPortId = (int)m_ports.size();
+
+    std::unique_ptr<sReactorPort_t> port(new sReactorPort_t);
+    port->iFd = iFd;
+    port->qsName = qsPortName;
+    port->bOnline = true;
+    // start + 8 data + stop bits
+    port->u64CharacterNs = 10 * 1000000000ull / iBaudRate;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = iPortId;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, iFd, &ev) != 0) {
+        *pqsError = tr("Can't watch %1: %2").arg(qsDevice, QString::fromLocal8Bit(strerror(errno)));
+        ::close(iFd);
+        return -1;
+    }
+
+    m_ports.push_back(std::move(port));
+
+    return iPortId;
+}
+
+QString cReactor::portName(int iPortId) const {
+    if ((iPortId < 0) || (iPortId >= (int)m_ports.size()))
+        return QString();
+
+    return m_ports[iPortId]->qsName;
+}
+
+bool cReactor::isOnline(void) const {
+    for (size_t i = 0; i < m_ports.size(); i++) {
+        if (m_ports[i]->bOnline)
+            return true;
+    }
+
+    return false;
+}
+
+void cReactor::start(void) {
+    m_stopRequest = false;
+
+    QThread::start();
+}
+
+void cReactor::stop(void) {
+    if (!isRunning())
+        return;
+
+    m_stopRequest = true;
+    wakeUp();
+
+    wait();
+}
+
+void cReactor::wakeUp(void) {
+    if (!m_wakePending.exchange(true)) {
+        uint64_t u64One = 1;
+        ssize_t n = ::write(m_wakeFd, &u64One, sizeof(u64One));
+        Q_UNUSED(n);
+    }
+}
+
+bool cReactor::txData(int iPortId, uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint32_t u32Len) {
+    if ((iPortId < 0) || (iPortId >= (int)m_ports.size()))
+        return false;
+
+    sReactorPort_t *port = m_ports[iPortId].get();
+
+    if (!port->bOnline) {
+        TRACE_ERROR(eTraceIfaceTxOffline, u8Addr, u8Cmd, iPortId);
+        return false;
+    }
+
+    uint32_t u32FrameLen = FRAME_OVERHEAD_LENGTH + u32Len;
+
+    // the stamp goes first, like in cInterface::txData()
+    if (m_metrics != nullptr && u32Len <= MAX_TX_PAYLOAD_LENGTH && port->txQueue.freeBytes() >= u32FrameLen)
+        port->txLatency.stamp(u32FrameLen);
+
+    if (!buildFrame(&port->txQueue, u8Addr, u8Cmd, pu8Payload, u32Len)) {
+        TRACE_ERROR(eTraceIfaceTxNoSpace, u32Len + FRAME_OVERHEAD_LENGTH, port->txQueue.freeBytes(), iPortId);
+        return false;
+    }
+
+    TRACE_DEBUG(eTraceIfaceTxFrame, u8Addr, u8Cmd, u32Len);
+
+    port->txLatency.queued(u32FrameLen);
+
+    // the high water mark of all ports
+    if (m_metrics != nullptr)
+        m_metrics->txQueueLevel(port->txQueue.usedBytes());
+
+    port->bTxPending = true;
+    wakeUp();
+
+    return true;
+}
+
+void cReactor::readPort(int iPortId) {
+    sReactorPort_t *port = m_ports[iPortId].get();
+
+    for (;;) {
+        ssize_t n = ::read(port->iFd, m_u8RxChunk, sizeof(m_u8RxChunk));
+
+        if (n > 0) {
+            uint64_t u64RxNs = cEngineMetrics::nowNs();
+
+            TRACE_DEBUG(eTraceIfaceRxChunk, n, iPortId, 0);
+
+            if (m_capture != nullptr)
+                m_capture->record(0, iPortId, m_u8RxChunk, n);
+
+            if (m_metrics != nullptr)
+                m_metrics->rxBytes(n);
+
+            decodePort(iPortId, n, u64RxNs);
+
+            // a short read means the driver buffer is empty
+            if (n < (ssize_t)sizeof(m_u8RxChunk))
+                return;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            dropPort(iPortId, (n == 0) ? tr("Device closed") : QString::fromLocal8Bit(strerror(errno)));
+            return;
+        }
+    }
+}
+
+void cReactor::decodePort(int iPortId, uint32_t u32Len, uint64_t u64RxNs) {
+    sReactorPort_t *port = m_ports[iPortId].get();
+    cFrameDecoder *decoder = &port->decoder;
+
+    decoder->feed(m_u8RxChunk, u32Len, u64RxNs, port->u64CharacterNs, m_u32InterByteTimeoutChars,
+                  [this, iPortId, decoder](eDecoderResult_t eResult) {
+        switch (eResult) {
+        case eDecoderFrameReady:
+            emit frameReceived(iPortId, decoder->frame());
+            break;
+
+        case eDecoderCrcError:
+            TRACE_ERROR(eTraceEngineCrcError, decoder->frame()->u8DestAddr, decoder->frame()->u8Cmd, iPortId);
+            break;
+
+        case eDecoderMaxPayloadError:
+            TRACE_ERROR(eTraceEngineMaxPayloadError, decoder->frame()->u8DestAddr, decoder->frame()->u8Cmd, iPortId);
+            break;
+
+        case eDecoderTimeout:
+            TRACE_ERROR(eTraceEngineInterByteTimeout, decoder->frame()->u8DestAddr, decoder->frame()->u8Cmd, iPortId);
+            break;
+
+        case eDecoderNeedMoreData:
+            break;
+        }
+    });
+
+    // the metrics show the totals of all ports
+    if (m_metrics != nullptr) {
+        sDecoderStats_t sTotal;
+        memset(&sTotal, 0, sizeof(sTotal));
+
+        for (size_t p = 0; p < m_ports.size(); p++)
+            m_ports[p]->decoder.addStats(&sTotal);
+
+        m_metrics->decoderStats(&sTotal);
+    }
+}
+
+bool cReactor::flushPort(int iPortId) {
+    sReactorPort_t *port = m_ports[iPortId].get();
+    bool bWantWrite = false;
+
+    for (;;) {
+        if (port->u32StagedPos == port->u32StagedLen) {
+            port->u32StagedLen = port->txQueue.pop(port->u8TxStaging, sizeof(port->u8TxStaging));
+            port->u32StagedPos = 0;
+
+            if (port->u32StagedLen == 0)
+                break;
+        }
+
+        ssize_t n = ::write(port->iFd, &port->u8TxStaging[port->u32StagedPos], port->u32StagedLen - port->u32StagedPos);
+
+        if (n > 0) {
+            if (m_capture != nullptr)
+                m_capture->record(CAPTURE_FLAG_TX, iPortId, &port->u8TxStaging[port->u32StagedPos], n);
+
+            if (m_metrics != nullptr) {
+                m_metrics->txBytes(n);
+                port->txLatency.written(n, m_metrics);
+            }
+
+            port->u32StagedPos += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // driver buffer full, continue once epoll reports the port writable
+            bWantWrite = true;
+            break;
+        } else {
+            dropPort(iPortId, QString::fromLocal8Bit(strerror(errno)));
+            return false;
+        }
+    }
+
+    if (bWantWrite != port->bWaitingForWrite) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | (bWantWrite ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.u32 = iPortId;
+
+        // without EPOLLOUT the staged bytes would never be written
+        if (epoll_ctl(m_epollFd, EPOLL_CTL_MOD, port->iFd, &ev) < 0) {
+            dropPort(iPortId, QString::fromLocal8Bit(strerror(errno)));
+            return false;
+        }
+
+        port->bWaitingForWrite = bWantWrite;
+    }
+
+    return true;
+}
+
+void cReactor::dropPort(int iPortId, const QString &qsError) {
+    sReactorPort_t *port = m_ports[iPortId].get();
+
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, port->iFd, nullptr);
+    port->bOnline = false;
+
+    emit portError(iPortId, qsError);
+}
+
+void cReactor::run(void) {
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    TRACE_INFO(eTraceIfaceOpened, m_ports.size(), 0, 0);
+
+    // without a capture there is nothing to do periodically, so the thread sleeps until an event comes
+    int iTimeoutMs = (m_capture != nullptr) ? CAPTURE_HANDOVER_INTERVAL : -1;
+    uint64_t u64LastHandOverNs = cEngineMetrics::nowNs();
+
+    // a replay of the capture times out partial frames with the same character times
+    if (m_capture != nullptr) {
+        for (size_t p = 0; p < m_ports.size(); p++) {
+            uint32_t u32CharacterNs = (uint32_t)m_ports[p]->u64CharacterNs;
+            m_capture->record(CAPTURE_FLAG_LINE, (uint8_t)p, (const uint8_t *)&u32CharacterNs, sizeof(u32CharacterNs));
+        }
+    }
+
+    while (!m_stopRequest) {
+        int iCount = epoll_wait(m_epollFd, events, REACTOR_MAX_EVENTS, iTimeoutMs);
+
+        if (m_capture != nullptr && cEngineMetrics::nowNs() - u64LastHandOverNs >= CAPTURE_HANDOVER_INTERVAL * 1000000ull) {
+            m_capture->handOver();
+            u64LastHandOverNs = cEngineMetrics::nowNs();
+        }
+
+        if (iCount < 0) {
+            if (errno == EINTR)
+                continue;
+
+            break;
+        }
+
+        for (int i = 0; i < iCount; i++) {
+            uint32_t u32Id = events[i].data.u32;
+
+            if (u32Id == REACTOR_WAKE_EVENT_ID) {
+                uint64_t u64Value;
+                ssize_t n = ::read(m_wakeFd, &u64Value, sizeof(u64Value));
+                Q_UNUSED(n);
+
+                // clear before draining, so a frame queued meanwhile triggers another wake-up
+                m_wakePending = false;
+
+                for (size_t p = 0; p < m_ports.size(); p++) {
+                    if (m_ports[p]->bOnline && m_ports[p]->bTxPending.exchange(false))
+                        flushPort((int)p);
+                }
+                continue;
+            }
+
+            if (!m_ports[u32Id]->bOnline)
+                continue;
+
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                readPort((int)u32Id);
+
+            if (m_ports[u32Id]->bOnline && (events[i].events & EPOLLOUT))
+                flushPort((int)u32Id);
+        }
+    }
+
+    if (m_capture != nullptr)
+        m_capture->handOver();
+
+    TRACE_INFO(eTraceIfaceClosed, m_ports.size(), 0, 0);
+}
@@ -0,0 +1,111 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <QThread>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "framedecoder.h"
+#include "metrics.h"
+#include "utils/spscqueue.h"
+
+class cCaptureWriter;
+
+#define REACTOR_TX_BUFFER_LENGTH    1024
+#define REACTOR_RX_CHUNK_LENGTH     65536
+
+// Linux only: one I/O thread multiplexing many serial ports through epoll.
+// Every port keeps its own frame decoder and its own TX queue; TX requests wake the thread
+// through an eventfd, so there is no per-port thread and no polling timeout.
+// RX chunks and TX writes go to the capture and the metrics the same way as in cInterface,
+// the capture port id is the port id of the reactor.
+class cReactor : public QThread
+{
+    Q_OBJECT
+
+    void run(void);
+
+public:
+    cReactor(QObject *parent);
+    ~cReactor();
+
+    // false when the epoll or wake-up descriptor could not be set up, errorString() tells why
+    bool isValid(void) const { return m_qsError.isEmpty(); }
+    QString errorString(void) const { return m_qsError; }
+
+    // call before start(), returns the port id (index) or -1 on error
+    int addPort(const QString &qsPortName, int iBaudRate, QString *pqsError);
+    int portsCount(void) const { return (int)m_ports.size(); }
+    QString portName(int iPortId) const;
+    // true while at least one port was not dropped after an error
+    bool isOnline(void) const;
+
+    // set before start(), see cInterface
+    void setCapture(cCaptureWriter *capture) { m_capture = capture; }
+    void setMetrics(cEngineMetrics *metrics) { m_metrics = metrics; }
+    // a partial frame is dropped when a port was silent for this many character times (0: never)
+    void setInterByteTimeout(uint32_t u32Characters) { m_u32InterByteTimeoutChars = u32Characters; }
+
+    void start(void);
+    void stop(void);
+
+    // producer side of the per-port TX queues: call from one thread only (the GUI thread);
+    // false for a port dropped after an error
+    bool txData(int iPortId, uint8_t u8Addr, uint8_t u8Cmd, const uint8_t *pu8Payload, uint32_t u32Len);
+
+signals:
+    // emitted from the reactor thread, frame is valid only during the call (use Qt::DirectConnection)
+    void frameReceived(int iPortId, const sRxFrame_t *frame);
+    void portError(int iPortId, const QString &s);
+
+private:
+    typedef struct sReactorPort {
+        sReactorPort();
+
+        int iFd;
+        QString qsName;
+        // cleared by the reactor thread when the port is dropped, read by txData()
+        std::atomic<bool> bOnline;
+        uint64_t u64CharacterNs;
+
+        cFrameDecoder decoder;
+
+        uint8_t u8TxBuffer[REACTOR_TX_BUFFER_LENGTH];
+        cSpscByteQueue txQueue;
+        std::atomic<bool> bTxPending;
+
+        // bytes already popped from txQueue but not yet accepted by the driver
+        uint8_t u8TxStaging[REACTOR_TX_BUFFER_LENGTH];
+        uint32_t u32StagedPos;
+        uint32_t u32StagedLen;
+        bool bWaitingForWrite;
+
+        // closed when the driver accepts the last byte of a frame
+        cTxLatencyTracker txLatency;
+    } sReactorPort_t;
+
+    std::vector<std::unique_ptr<sReactorPort_t>> m_ports;
+
+    int m_epollFd;
+    int m_wakeFd;
+    std::atomic<bool> m_stopRequest;
+    std::atomic<bool> m_wakePending;
+    QString m_qsError;
+
+    cCaptureWriter *m_capture;
+    cEngineMetrics *m_metrics;
+    uint32_t m_u32InterByteTimeoutChars;
+
+    uint8_t m_u8RxChunk[REACTOR_RX_CHUNK_LENGTH];
+
+    void wakeUp(void);
+    void readPort(int iPortId);
+    void decodePort(int iPortId, uint32_t u32Len, uint64_t u64RxNs);
+    bool flushPort(int iPortId);
+    void dropPort(int iPortId, const QString &qsError);
+};
+
+#endif // REACTOR_H
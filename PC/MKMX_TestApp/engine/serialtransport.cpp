@@ -0,0 +1,77 @@
+#include "serialtransport.h"
+
+cSerialTransport::cSerialTransport(const QString &qsPortName, QObject *parent) :
+    cTransport(parent)
+{
+    m_serial.setPortName(qsPortName);
+    m_serial.setBaudRate(SERIAL_TRANSPORT_BAUD_RATE);
+
+    connect(&m_serial, &QSerialPort::readyRead, this, &cTransport::readyRead);
+    connect(&m_serial, &QSerialPort::bytesWritten, this, [this](qint64 i64Bytes) {
+        emit bytesWritten(i64Bytes);
+    });
+    connect(&m_serial, &QSerialPort::errorOccurred, this, [this](QSerialPort::SerialPortError errCode) {
+        if (errCode == QSerialPort::ResourceError)
+            emit fatalError(errorToString(errCode));
+    });
+}
+
+bool cSerialTransport::open(QString *pqsError) {
+    if (!m_serial.open(QIODevice::ReadWrite)) {
+        *pqsError = errorToString(m_serial.error());
+        return false;
+    }
+
+    return true;
+}
+
+void cSerialTransport::close(void) {
+    m_serial.close();
+}
+
+bool cSerialTransport::write(const uint8_t *pu8Data, uint32_t u32Len) {
+    // QSerialPort queues the data and writes it from the owning thread's event loop
+    return m_serial.write((const char *)pu8Data, u32Len) == (qint64)u32Len;
+}
+
+bool cSerialTransport::waitForBytesWritten(int iMsecs) {
+    if (m_serial.bytesToWrite() == 0)
+        return true;
+
+    return m_serial.waitForBytesWritten(iMsecs);
+}
+
+QString cSerialTransport::errorToString(QSerialPort::SerialPortError errCode) {
+    switch (errCode) {
+
+        case QSerialPort::DeviceNotFoundError:
+            return "Attempting to open an non-existing device";
+        case QSerialPort::PermissionError:
+            return "Attempting to open device which was already opened or current user does not have enough permission";
+        case QSerialPort::OpenError:
+            return "Attempting to open device which was already opened in this object";
+        case QSerialPort::ParityError:
+            return "Parity error detected by the hardware while reading data";
+        case QSerialPort::FramingError:
+            return "Framing error detected by the hardware while reading data";
+        case QSerialPort::BreakConditionError:
+            return "Break condition detected by the hardware on the input line";
+        case QSerialPort::WriteError:
+            return "An I/O error occurred while writing the data";
+        case QSerialPort::ReadError:
+            return "An I/O error occurred while reading the data";
+        case QSerialPort::ResourceError:
+            return "Resource becomes unavailable (the device was unexpectedly removed from the system?)";
+        case QSerialPort::UnsupportedOperationError:
+            return "The requested device operation is not supported or prohibited by the running operating system";
+        case QSerialPort::UnknownError:
+            return "An unidentified error occurred";
+        case QSerialPort::TimeoutError:
+            return "A timeout error occurred";
+        case QSerialPort::NotOpenError:
+            return "Operation can only be successfully performed if the device is open";
+        default:
+        case QSerialPort::NoError:
+            return "No error occurred";
+    }
+}
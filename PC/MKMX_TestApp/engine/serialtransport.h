@@ -0,0 +1,32 @@
+#ifndef SERIALTRANSPORT_H
+#define SERIALTRANSPORT_H
+
+#include <QSerialPort>
+
+#include "transport.h"
+
+#define SERIAL_TRANSPORT_BAUD_RATE  4800
+
+class cSerialTransport : public cTransport
+{
+    Q_OBJECT
+public:
+    cSerialTransport(const QString &qsPortName, QObject *parent = nullptr);
+
+    bool open(QString *pqsError);
+    void close(void);
+
+    QByteArray readAll(void) { return m_serial.readAll(); }
+    bool write(const uint8_t *pu8Data, uint32_t u32Len);
+    bool waitForBytesWritten(int iMsecs);
+
+    QString name(void) const { return m_serial.portName(); }
+    uint32_t baudRate(void) const { return m_serial.baudRate(); }
+
+    static QString errorToString(QSerialPort::SerialPortError errCode);
+
+private:
+    QSerialPort m_serial;
+};
+
+#endif // SERIALTRANSPORT_H
@@ -0,0 +1,46 @@
+#include "tcptransport.h"
+
+cTcpTransport::cTcpTransport(const QString &qsHost, quint16 u16Port, QObject *parent) :
+    cTransport(parent),
+    m_qsHost(qsHost),
+    m_u16Port(u16Port)
+{
+    connect(&m_socket, &QTcpSocket::readyRead, this, &cTransport::readyRead);
+    connect(&m_socket, &QTcpSocket::bytesWritten, this, [this](qint64 i64Bytes) {
+        emit bytesWritten(i64Bytes);
+    });
+    connect(&m_socket, &QTcpSocket::disconnected, this, [this]() {
+        emit fatalError(tr("Connection to %1 closed").arg(name()));
+    });
+}
+
+bool cTcpTransport::open(QString *pqsError) {
+    m_socket.connectToHost(m_qsHost, m_u16Port);
+
+    if (!m_socket.waitForConnected(TCP_TRANSPORT_CONNECT_TIMEOUT)) {
+        *pqsError = tr("Can't connect to %1: %2").arg(name(), m_socket.errorString());
+        return false;
+    }
+
+    // frames are small, do not let Nagle hold them back
+    m_socket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    return true;
+}
+
+void cTcpTransport::close(void) {
+    m_socket.blockSignals(true);
+    m_socket.close();
+    m_socket.blockSignals(false);
+}
+
+bool cTcpTransport::write(const uint8_t *pu8Data, uint32_t u32Len) {
+    return m_socket.write((const char *)pu8Data, u32Len) == (qint64)u32Len;
+}
+
+bool cTcpTransport::waitForBytesWritten(int iMsecs) {
+    if (m_socket.bytesToWrite() == 0)
+        return true;
+
+    return m_socket.waitForBytesWritten(iMsecs);
+}
@@ -0,0 +1,33 @@
+#ifndef TCPTRANSPORT_H
+#define TCPTRANSPORT_H
+
+#include <QTcpSocket>
+
+#include "transport.h"
+
+#define TCP_TRANSPORT_CONNECT_TIMEOUT   3000
+
+// raw TCP stream, e.g. ser2net in raw mode or a device simulator listening on localhost
+class cTcpTransport : public cTransport
+{
+    Q_OBJECT
+public:
+    cTcpTransport(const QString &qsHost, quint16 u16Port, QObject *parent = nullptr);
+
+    bool open(QString *pqsError);
+    void close(void);
+
+    QByteArray readAll(void) { return m_socket.readAll(); }
+    bool write(const uint8_t *pu8Data, uint32_t u32Len);
+    bool waitForBytesWritten(int iMsecs);
+
+    QString name(void) const { return QString("tcp:%1:%2").arg(m_qsHost).arg(m_u16Port); }
+
+private:
+    QString m_qsHost;
+    quint16 m_u16Port;
+
+    QTcpSocket m_socket;
+};
+
+#endif // TCPTRANSPORT_H
@@ -0,0 +1,59 @@
+#include "transport.h"
+
+#include "serialtransport.h"
+#include "tcptransport.h"
+#include "loopbacktransport.h"
+#include "playbacktransport.h"
+
+#ifdef MKMX_HAVE_PTY
+    #include "ptytransport.h"
+#endif
+
+cTransport *cTransport::create(const QString &qsSpec, QString *pqsError, QObject *parent) {
+    if (qsSpec.startsWith("loop:")) {
+        bool bOk;
+        uint32_t u32Address = qsSpec.mid(5).toUInt(&bOk, 0);
+
+        if (bOk && u32Address <= 0xFF)
+            return new cLoopbackTransport(new cLoopbackMkmxDevice((uint8_t)u32Address), parent);
+
+        return new cLoopbackTransport(nullptr, parent);
+    }
+
+    if (qsSpec.startsWith("play:")) {
+        QString qsFileName = qsSpec.mid(5);
+        int iHash = qsFileName.lastIndexOf('#');
+
+        // "#<port id>" only when it is a number, a file name may contain '#' as well
+        if (iHash >= 0) {
+            bool bOk;
+            uint32_t u32PortId = qsFileName.mid(iHash + 1).toUInt(&bOk, 0);
+
+            if (bOk && u32PortId <= 0xFF)
+                return new cPlaybackTransport(qsFileName.left(iHash), (int)u32PortId, parent);
+        }
+
+        return new cPlaybackTransport(qsFileName, -1, parent);
+    }
+
+    if (qsSpec.startsWith("tcp:")) {
+        QString qsAddress = qsSpec.mid(4);
+        int iColon = qsAddress.lastIndexOf(':');
+
+        bool bOk = false;
+        uint16_t u16Port = (iColon > 0) ? qsAddress.mid(iColon + 1).toUShort(&bOk) : 0;
+        if (!bOk || u16Port == 0) {
+            *pqsError = QString("%1 is not tcp:<host>:<port>").arg(qsSpec);
+            return nullptr;
+        }
+
+        return new cTcpTransport(qsAddress.left(iColon), u16Port, parent);
+    }
+
+#ifdef MKMX_HAVE_PTY
+    if (qsSpec.startsWith("pty:"))
+        return new cPtyTransport(qsSpec.mid(4), parent);
+#endif
+
+    return new cSerialTransport(qsSpec, parent);
+}
@@ -0,0 +1,57 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+
+#include <stdint.h>
+
+// Byte transport used by cInterface. Implementations live in the interface thread and
+// report incoming data with readyRead(), so the interface does not care what is underneath.
+//
+// Port specification accepted by create():
+//   "COM3", "ttyUSB0", ...     serial port (QSerialPort)
+//   "pty:/dev/pts/N"           existing pseudo-terminal or tty device (Linux)
+//   "pty:"                     new pseudo-terminal, the slave path is reported by name()
+//   "tcp:host:port"            TCP socket, e.g. ser2net or a simulator listening on localhost
+//   "loop:"                    in-process loopback into an echo device (see cLoopbackTransport)
+//   "loop:<address>"           in-process loopback into an MKMX slave at this address, e.g. "loop:0x42"
+//   "play:<file>"              timed playback of a capture file with a single port (see cPlaybackTransport)
+//   "play:<file>#<port id>"    timed playback of one port of a capture file, e.g. a reactor session
+class cTransport : public QObject
+{
+    Q_OBJECT
+public:
+    cTransport(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~cTransport() {}
+
+    // nullptr and *pqsError when the specification is malformed (e.g. "tcp:" without a port)
+    static cTransport *create(const QString &qsSpec, QString *pqsError, QObject *parent = nullptr);
+
+    virtual bool open(QString *pqsError) = 0;
+    virtual void close(void) = 0;
+
+    virtual QByteArray readAll(void) = 0;
+    // may only queue the data, bytesWritten() tells when it reached the device
+    virtual bool write(const uint8_t *pu8Data, uint32_t u32Len) = 0;
+
+    // blocks until pending TX data is written (used only when closing)
+    virtual bool waitForBytesWritten(int iMsecs) { Q_UNUSED(iMsecs); return true; }
+
+    virtual QString name(void) const = 0;
+
+    // line speed for the character timing, 0 when the bytes do not come at a known rate (TCP, pty, ...)
+    virtual uint32_t baudRate(void) const { return 0; }
+
+signals:
+    void readyRead(void);
+    // bytes passed from the queue of write() to the device (driver, socket, pty, ...), in write() order
+    void bytesWritten(quint64 u64Bytes);
+    // the transport is unusable (device removed, connection closed, ...)
+    void fatalError(const QString &s);
+    // the byte stream jumped (playback seek), bytes after it do not continue a partial frame
+    void discontinuity(void);
+};
+
+#endif // TRANSPORT_H
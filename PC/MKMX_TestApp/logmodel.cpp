@@ -0,0 +1,214 @@
+#include "logmodel.h"
+
+#include <QDateTime>
+
+#include <string.h>
+
+cLogModel::cLogModel(QObject *parent) :
+    QAbstractListModel(parent),
+    m_u64FirstLine(0),
+    m_u64Committed(0),
+    m_u64Lines(0),
+    m_i64BaseMs(0),
+    m_iMaximumLines(0),
+    m_bShowTimestamps(false)
+{
+}
+
+int cLogModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid())
+        return 0;
+
+    if (!m_baFilter.isEmpty())
+        return m_filtered.size();
+
+    return m_u64Committed - m_u64FirstLine;
+}
+
+const sLogRecord_t *cLogModel::record(uint64_t u64Line, const char **ppcText) const {
+    const sLogChunk_t *psChunk = m_chunks[(u64Line - m_u64FirstLine) / LOG_CHUNK_LINES].get();
+    const sLogRecord_t *psRecord = &psChunk->records[u64Line % LOG_CHUNK_LINES];
+
+    *ppcText = psChunk->text.data() + psRecord->u32TextOffset;
+    return psRecord;
+}
+
+QString cLogModel::rowText(int iRow) const {
+    return formatLine(lineOfRow(iRow));
+}
+
+QString cLogModel::formatLine(uint64_t u64Line) const {
+    const char *pcText;
+    const sLogRecord_t *psRecord = record(u64Line, &pcText);
+
+    QString qsLine;
+    if (m_bShowTimestamps)
+        qsLine = QDateTime::fromMSecsSinceEpoch(m_i64BaseMs + psRecord->u32TimeMs).toString("[ HH:mm:ss:zzz ] -> ");
+    if (psRecord->u8Flags & LOG_FLAG_FRAME)
+        qsLine += QString("<0x%1> ").arg(psRecord->u8Addr, 2, 16, QChar('0'));
+
+    return qsLine + QString::fromUtf8(pcText, psRecord->u16TextLen);
+}
+
+QVariant cLogModel::data(const QModelIndex &index, int role) const {
+    if (role != Qt::DisplayRole || !index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    return rowText(index.row());
+}
+
+void cLogModel::append(const QByteArray &baText) {
+    appendLine(0, 0, 0, baText);
+}
+
+void cLogModel::append(uint8_t u8Addr, uint8_t u8Cmd, const QByteArray &baText) {
+    appendLine(LOG_FLAG_FRAME, u8Addr, u8Cmd, baText);
+}
+
+void cLogModel::appendLine(uint8_t u8Flags, uint8_t u8Addr, uint8_t u8Cmd, const QByteArray &baText) {
+    int64_t i64NowMs = QDateTime::currentMSecsSinceEpoch();
+    if (m_u64Lines == m_u64FirstLine && m_chunks.empty())
+        m_i64BaseMs = i64NowMs;
+
+    if (m_chunks.empty() || m_chunks.back()->records.size() == LOG_CHUNK_LINES) {
+        m_chunks.emplace_back(new sLogChunk_t);
+        m_chunks.back()->records.reserve(LOG_CHUNK_LINES);
+    }
+
+    sLogChunk_t *psChunk = m_chunks.back().get();
+    uint32_t u32Len = qMin(baText.size(), 0xFFFF);
+
+    sLogRecord_t sRecord;
+    memset(&sRecord, 0, sizeof(sRecord));
+    sRecord.u32TimeMs = i64NowMs - m_i64BaseMs;
+    sRecord.u32TextOffset = psChunk->text.size();
+    sRecord.u16TextLen = u32Len;
+    sRecord.u8Flags = u8Flags;
+    sRecord.u8Addr = u8Addr;
+    sRecord.u8Cmd = u8Cmd;
+
+    psChunk->records.push_back(sRecord);
+    psChunk->text.insert(psChunk->text.end(), baText.constData(), baText.constData() + u32Len);
+
+    m_u64Lines++;
+}
+
+void cLogModel::dropFrontChunk(void) {
+    uint64_t u64ChunkEnd = m_u64FirstLine + LOG_CHUNK_LINES;
+    int iRows = 0;
+
+    // committed rows of the chunk are at the top of the view
+    if (m_baFilter.isEmpty()) {
+        iRows = qMin(u64ChunkEnd, m_u64Committed) - m_u64FirstLine;
+    } else {
+        while (iRows < (int)m_filtered.size() && m_filtered[iRows] < u64ChunkEnd)
+            iRows++;
+    }
+
+    if (iRows > 0)
+        beginRemoveRows(QModelIndex(), 0, iRows - 1);
+
+    m_chunks.pop_front();
+    m_u64FirstLine = u64ChunkEnd;
+    if (m_u64Committed < m_u64FirstLine)
+        m_u64Committed = m_u64FirstLine;
+    if (!m_baFilter.isEmpty())
+        m_filtered.erase(m_filtered.begin(), m_filtered.begin() + iRows);
+
+    if (iRows > 0)
+        endRemoveRows();
+}
+
+void cLogModel::commit(void) {
+    // the chunk being filled is never dropped
+    while (m_iMaximumLines > 0 && m_chunks.size() > 1 &&
+           m_u64Lines - m_u64FirstLine - LOG_CHUNK_LINES >= (uint64_t)m_iMaximumLines)
+        dropFrontChunk();
+
+    if (m_u64Committed == m_u64Lines)
+        return;
+
+    if (m_baFilter.isEmpty()) {
+        int iFirst = rowCount();
+
+        beginInsertRows(QModelIndex(), iFirst, iFirst + (m_u64Lines - m_u64Committed) - 1);
+        m_u64Committed = m_u64Lines;
+        endInsertRows();
+    } else {
+        std::vector<uint64_t> matched;
+        matchLines(QByteArrayMatcher(m_baFilter), m_u64Committed, m_u64Lines, &matched);
+
+        m_u64Committed = m_u64Lines;
+
+        if (!matched.empty()) {
+            int iFirst = rowCount();
+
+            beginInsertRows(QModelIndex(), iFirst, iFirst + matched.size() - 1);
+            m_filtered.insert(m_filtered.end(), matched.begin(), matched.end());
+            endInsertRows();
+        }
+    }
+}
+
+void cLogModel::clear(void) {
+    beginResetModel();
+
+    m_chunks.clear();
+    m_filtered.clear();
+    m_u64FirstLine = 0;
+    m_u64Committed = 0;
+    m_u64Lines = 0;
+
+    endResetModel();
+}
+
+void cLogModel::setShowTimestamps(bool bShow) {
+    m_bShowTimestamps = bShow;
+
+    // views ask again only for the rows they show
+    if (rowCount() > 0)
+        emit dataChanged(index(0), index(rowCount() - 1));
+}
+
+void cLogModel::matchLines(const QByteArrayMatcher &matcher, uint64_t u64From, uint64_t u64To, std::vector<uint64_t> *pLines) const {
+    for (uint64_t u64Line = u64From; u64Line < u64To; u64Line++) {
+        const char *pcText;
+        const sLogRecord_t *psRecord = record(u64Line, &pcText);
+
+        if (matcher.indexIn(pcText, psRecord->u16TextLen) >= 0)
+            pLines->push_back(u64Line);
+    }
+}
+
+void cLogModel::setFilter(const QString &qsText) {
+    beginResetModel();
+
+    m_baFilter = qsText.toUtf8();
+    m_filtered.clear();
+
+    if (!m_baFilter.isEmpty()) {
+        std::vector<uint64_t> matched;
+        matchLines(QByteArrayMatcher(m_baFilter), m_u64FirstLine, m_u64Committed, &matched);
+        m_filtered.assign(matched.begin(), matched.end());
+    }
+
+    endResetModel();
+}
+
+int cLogModel::find(const QString &qsText, int iFromRow) const {
+    QByteArrayMatcher matcher(qsText.toUtf8());
+    int iRows = rowCount();
+
+    if (qsText.isEmpty())
+        return -1;
+
+    for (int iRow = iFromRow + 1; iRow < iRows; iRow++) {
+        const char *pcText;
+        const sLogRecord_t *psRecord = record(lineOfRow(iRow), &pcText);
+
+        if (matcher.indexIn(pcText, psRecord->u16TextLen) >= 0)
+            return iRow;
+    }
+
+    return -1;
+}
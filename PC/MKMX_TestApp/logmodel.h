@@ -0,0 +1,95 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QByteArray>
+#include <QByteArrayMatcher>
+#include <QString>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+// lines per chunk, the oldest lines are dropped a whole chunk at a time
+#define LOG_CHUNK_LINES     4096
+
+#define LOG_FLAG_FRAME      0x01    // u8Addr and u8Cmd are valid
+
+typedef struct {
+    uint32_t u32TimeMs;         // since the first line
+    uint32_t u32TextOffset;     // into the text arena of the chunk
+    uint16_t u16TextLen;
+    uint8_t u8Flags;
+    uint8_t u8Addr;
+    uint8_t u8Cmd;
+    uint8_t u8Reserved[3];
+} sLogRecord_t;
+
+// Session log kept as compact records in chunked arenas, a row is formatted only when a view asks for it.
+// Appended lines become rows at commit(), so a view is told about a whole batch at once.
+// The filter and the search look at the raw text bytes without formatting anything.
+class cLogModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    cLogModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    void append(const QByteArray &baText);
+    void append(uint8_t u8Addr, uint8_t u8Cmd, const QByteArray &baText);
+    // publishes the appended lines and drops the oldest chunks above the limit
+    void commit(void);
+    bool hasPending(void) const { return m_u64Lines != m_u64Committed; }
+    void clear(void);
+
+    // 0: no limit; the log keeps at most one chunk more than this
+    void setMaximumLines(int iLines) { m_iMaximumLines = iLines; }
+
+    // only rows containing the text are shown, empty text shows everything
+    void setFilter(const QString &qsText);
+    // next row after iFromRow containing the text, -1 when there is none
+    int find(const QString &qsText, int iFromRow) const;
+
+    QString rowText(int iRow) const;
+
+    // every committed line regardless of the filter, e.g. to save the whole log
+    int lineCount(void) const { return m_u64Committed - m_u64FirstLine; }
+    QString lineText(int iLine) const { return formatLine(m_u64FirstLine + iLine); }
+
+public slots:
+    void setShowTimestamps(bool bShow);
+
+private:
+    typedef struct {
+        std::vector<sLogRecord_t> records;
+        std::vector<char> text;
+    } sLogChunk_t;
+
+    std::deque<std::unique_ptr<sLogChunk_t>> m_chunks;
+
+    // absolute line numbers: m_u64FirstLine is the first line of m_chunks.front(),
+    // lines below m_u64Committed are rows, the rest waits for commit()
+    uint64_t m_u64FirstLine;
+    uint64_t m_u64Committed;
+    uint64_t m_u64Lines;
+
+    int64_t m_i64BaseMs;
+    int m_iMaximumLines;
+    bool m_bShowTimestamps;
+
+    QByteArray m_baFilter;
+    std::deque<uint64_t> m_filtered;    // absolute line numbers shown while filtering
+
+    const sLogRecord_t *record(uint64_t u64Line, const char **ppcText) const;
+    QString formatLine(uint64_t u64Line) const;
+    uint64_t lineOfRow(int iRow) const { return m_baFilter.isEmpty() ? m_u64FirstLine + iRow : m_filtered[iRow]; }
+    void appendLine(uint8_t u8Flags, uint8_t u8Addr, uint8_t u8Cmd, const QByteArray &baText);
+    void matchLines(const QByteArrayMatcher &matcher, uint64_t u64From, uint64_t u64To, std::vector<uint64_t> *pLines) const;
+    void dropFrontChunk(void);
+};
+
+#endif // LOGMODEL_H
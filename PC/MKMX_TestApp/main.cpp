@@ -1,12 +1,237 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QScopedPointer>
+#include <QDateTime>
+#include <QElapsedTimer>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "engine/engine.h"
+#include "engine/framearchive.h"
+
+static int replayMain(const QString &qsFileName) {
+    cEngine engine;
+    sReplayStats_t sStats;
+    QString qsError;
+
+    if (!engine.replayCapture(qsFileName, &sStats, &qsError)) {
+        fprintf(stderr, "%s\n", qPrintable(qsError));
+        return 1;
+    }
+
+    const sDecoderStats_t *psDecoder = &sStats.sDecoder;
+    double dSeconds = (sStats.dSeconds > 0.0) ? sStats.dSeconds : 1e-9;
+
+    printf("replayed %llu records, %llu bytes in %.3f s (%.1f MB/s)%s\n",
+           (unsigned long long)sStats.u64Records, (unsigned long long)sStats.u64Bytes, sStats.dSeconds,
+           sStats.u64Bytes / dSeconds / 1e6, sStats.bComplete ? "" : ", capture ends with a damaged block");
+    printf("frames: %llu (%.0f frames/s)\n", (unsigned long long)psDecoder->u64Frames, psDecoder->u64Frames / dSeconds);
+    printf("crc errors: %llu, length errors: %llu\n",
+           (unsigned long long)psDecoder->u64CrcErrors, (unsigned long long)psDecoder->u64MaxPayloadErrors);
+    printf("resyncs: %llu (%llu bytes skipped)\n",
+           (unsigned long long)psDecoder->u64Resyncs, (unsigned long long)psDecoder->u64SkippedBytes);
+    printf("frames recovered from broken ones: %llu\n", (unsigned long long)psDecoder->u64RecoveredFrames);
+    printf("partial frames timed out: %llu\n", (unsigned long long)psDecoder->u64Timeouts);
+
+    return 0;
+}
+
+// "yyyy-MM-dd hh:mm[:ss]" or "hh:mm[:ss]" on the day the archive starts, local time
+static bool parseQueryTime(const QString &qsText, const QDate &startDate, int64_t *pi64TimeUs) {
+    QDateTime dateTime = QDateTime::fromString(qsText, "yyyy-MM-dd hh:mm:ss");
+    if (!dateTime.isValid())
+        dateTime = QDateTime::fromString(qsText, "yyyy-MM-dd hh:mm");
+    if (!dateTime.isValid()) {
+        QTime time = QTime::fromString(qsText, "hh:mm:ss");
+        if (!time.isValid())
+            time = QTime::fromString(qsText, "hh:mm");
+        // QDateTime() takes an invalid time for midnight
+        if (!time.isValid())
+            return false;
+        dateTime = QDateTime(startDate, time);
+    }
+
+    if (!dateTime.isValid())
+        return false;
+
+    *pi64TimeUs = dateTime.toMSecsSinceEpoch() * 1000;
+    return true;
+}
+
+// address or command: a single character ('k') or a number (0x42, 66)
+static bool parseQueryByte(const QString &qsText, int *piValue) {
+    if (qsText.isEmpty()) {
+        *piValue = ARCHIVE_ANY;
+        return true;
+    }
+
+    if (qsText.length() == 1 && !qsText.at(0).isDigit()) {
+        // toLatin1() gives 0 for anything else
+        if (qsText.at(0).unicode() > 0xFF)
+            return false;
+        *piValue = qsText.at(0).toLatin1();
+        return true;
+    }
+
+    // range checked before the cast, 4294967295 must not turn into -1 (ARCHIVE_ANY)
+    bool bOk;
+    uint uValue = qsText.toUInt(&bOk, 0);
+    if (!bOk || uValue > 0xFF)
+        return false;
+
+    *piValue = (int)uValue;
+    return true;
+}
+
+static int queryMain(const QString &qsFileName, const QString &qsAddr, const QString &qsCmd,
+                     const QString &qsFrom, const QString &qsTo) {
+    cFrameArchive archive;
+    QString qsError;
+
+    if (!archive.open(qsFileName, &qsError)) {
+        fprintf(stderr, "%s\n", qPrintable(qsError));
+        return 1;
+    }
+
+    QDate startDate = QDateTime::fromMSecsSinceEpoch(archive.startUs() / 1000).date();
+    int64_t i64FromUs = INT64_MIN;
+    int64_t i64ToUs = INT64_MAX;
+    int iAddr, iCmd;
+
+    if ((!qsFrom.isEmpty() && !parseQueryTime(qsFrom, startDate, &i64FromUs)) ||
+        (!qsTo.isEmpty() && !parseQueryTime(qsTo, startDate, &i64ToUs))) {
+        fprintf(stderr, "invalid time, use \"yyyy-MM-dd hh:mm[:ss]\" or \"hh:mm[:ss]\"\n");
+        return 1;
+    }
+
+    if (!parseQueryByte(qsAddr, &iAddr) || !parseQueryByte(qsCmd, &iCmd)) {
+        fprintf(stderr, "invalid address or command\n");
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::vector<uint32_t> ids;
+    archive.query(i64FromUs, i64ToUs, iAddr, iCmd, &ids);
+
+    double dMs = timer.nsecsElapsed() / 1e6;
+
+    for (uint32_t u32Id : ids) {
+        const sArchiveFrame_t *psFrame = archive.frame(u32Id);
+        QByteArray baPayload((const char *)(psFrame + 1), psFrame->u8Len);
+
+        printf("%s.%03d  port %u  addr 0x%02X  cmd 0x%02X  len %3u  %s\n",
+               qPrintable(QDateTime::fromMSecsSinceEpoch(psFrame->i64TimeUs / 1000).toString("yyyy-MM-dd hh:mm:ss")),
+               (int)(psFrame->i64TimeUs / 1000 % 1000), psFrame->u8PortId, psFrame->u8Addr, psFrame->u8Cmd, psFrame->u8Len,
+               baPayload.toHex().constData());
+    }
+
+    fprintf(stderr, "%zu of %u frames in %.3f ms%s\n", ids.size(), archive.framesCount(), dMs,
+            archive.hasStoredIndex() ? "" : " (archive was not closed, index rebuilt)");
+
+    return 0;
+}
+
+static int unpackLogMain(const QString &qsFileName) {
+    QFile output;
+    QString qsError;
+
+    output.open(stdout, QIODevice::WriteOnly);
+    if (!cLogSink::unpack(qsFileName, &output, &qsError)) {
+        fprintf(stderr, "%s\n", qPrintable(qsError));
+        return 1;
+    }
+
+    return 0;
+}
+
+// "--name" or "--name=value", the forms QCommandLineParser accepts for an option with a value
+static bool isOption(const char *pcArg, const char *pcName) {
+    size_t len = strlen(pcName);
+
+    return (strncmp(pcArg, pcName, len) == 0) && (pcArg[len] == '\0' || pcArg[len] == '=');
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    // the replay runs without any window, so it must not need a display either
+    bool bHeadless = false;
+    for (int i = 1; i < argc; i++) {
+        if (isOption(argv[i], "--replay") || isOption(argv[i], "--query") || isOption(argv[i], "--unpack-log"))
+            bHeadless = true;
+    }
+
+    QScopedPointer<QCoreApplication> app(bHeadless ? new QCoreApplication(argc, argv) : new QApplication(argc, argv));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption captureDirOption("capture-dir", "Capture raw traffic of every session into <dir>.", "dir");
+    parser.addOption(captureDirOption);
+    QCommandLineOption replayOption("replay", "Replay a capture through the decoder as fast as possible and print statistics.", "file");
+    parser.addOption(replayOption);
+    QCommandLineOption archiveDirOption("archive-dir", "Archive decoded frames of every session into <dir>.", "dir");
+    parser.addOption(archiveDirOption);
+    QCommandLineOption interByteTimeoutOption("inter-byte-timeout", "Drop a partial frame after <n> silent character times (0: never).", "n");
+    parser.addOption(interByteTimeoutOption);
+    QCommandLineOption queryOption("query", "Print frames of an archive, filtered by --addr, --cmd, --from and --to.", "file");
+    parser.addOption(queryOption);
+    QCommandLineOption addrOption("addr", "Query: frame address (0x42).", "addr");
+    parser.addOption(addrOption);
+    QCommandLineOption cmdOption("cmd", "Query: frame command (k or 0x6B).", "cmd");
+    parser.addOption(cmdOption);
+    QCommandLineOption fromOption("from", "Query: from time (hh:mm[:ss] or yyyy-MM-dd hh:mm[:ss]).", "time");
+    parser.addOption(fromOption);
+    QCommandLineOption toOption("to", "Query: to time, inclusive.", "time");
+    parser.addOption(toOption);
+    QCommandLineOption logDirOption("log-dir", "Stream the log of every session into <dir>.", "dir");
+    parser.addOption(logDirOption);
+    QCommandLineOption logRotateMbOption("log-rotate-mb", "Start the next log file after <n> MB (0: never).", "n");
+    parser.addOption(logRotateMbOption);
+    QCommandLineOption logRotateMinOption("log-rotate-min", "Start the next log file after <n> minutes (0: never).", "n");
+    parser.addOption(logRotateMinOption);
+    QCommandLineOption logBinaryOption("log-binary", "Write binary log records instead of text lines.");
+    parser.addOption(logBinaryOption);
+    QCommandLineOption logCompressOption("log-compress", "Compress the log in blocks (qCompress).");
+    parser.addOption(logCompressOption);
+    QCommandLineOption unpackLogOption("unpack-log", "Print a binary or compressed log as text.", "file");
+    parser.addOption(unpackLogOption);
+    parser.process(*app);
+
+    if (parser.isSet(replayOption))
+        return replayMain(parser.value(replayOption));
+
+    if (parser.isSet(unpackLogOption))
+        return unpackLogMain(parser.value(unpackLogOption));
+
+    if (parser.isSet(queryOption))
+        return queryMain(parser.value(queryOption), parser.value(addrOption), parser.value(cmdOption),
+                         parser.value(fromOption), parser.value(toOption));
 
     MainWindow w;
+    if (parser.isSet(captureDirOption))
+        w.setCaptureDirectory(parser.value(captureDirOption));
+    if (parser.isSet(archiveDirOption))
+        w.setArchiveDirectory(parser.value(archiveDirOption));
+    if (parser.isSet(interByteTimeoutOption))
+        w.setInterByteTimeout(parser.value(interByteTimeoutOption).toUInt());
+
+    // command line overrides the stored settings for this run only
+    sLogSinkConfig_t sLogSink = w.getLogSinkConfig();
+    if (parser.isSet(logDirOption))
+        sLogSink.qsDirectory = parser.value(logDirOption);
+    if (parser.isSet(logRotateMbOption))
+        sLogSink.u32RotateBytes = qMin(parser.value(logRotateMbOption).toUInt(), 4095u) << 20;
+    if (parser.isSet(logRotateMinOption))
+        sLogSink.u32RotateSeconds = parser.value(logRotateMinOption).toUInt() * 60;
+    if (parser.isSet(logBinaryOption))
+        sLogSink.bBinary = true;
+    if (parser.isSet(logCompressOption))
+        sLogSink.bCompress = true;
+    w.setLogSinkConfig(sLogSink);
     w.show();
 
-    return app.exec();
+    return app->exec();
 }
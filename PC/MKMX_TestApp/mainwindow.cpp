@@ -4,12 +4,15 @@
 #include "dataviewer.h"
 #include "version.h"
 
+#include "engine/framebuilder.h"
+
 #include <QtSerialPort/QSerialPortInfo>
 #include <QDesktopWidget>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QStandardPaths>
 #include <QSpinBox>
+#include <QComboBox>
 #include <QTableWidget>
 #include <QHeaderView>
 #include <QItemDelegate>
@@ -17,6 +20,14 @@
 #include <QRegExpValidator>
 #include <QDebug>
 #include <QTime>
+#include <QScrollBar>
+
+#include "logmodel.h"
+
+// log view refresh rate
+#define LOG_FLUSH_INTERVAL          33
+#define LOG_FILTER_DELAY            300
+#define LOG_DEFAULT_MAXIMUM_LINES   1000000
 
 class HexSpinBox : public QSpinBox {
 public:
@@ -101,6 +112,12 @@ MainWindow::MainWindow(QWidget *parent) :
                        QLatin1String(VER_COMPANYNAME_STR),
                        QLatin1String(VER_PRODUCTNAME_STR), this)),
     refreshStatusTimer(new QTimer(this)),
+    u64LastRxBytes(0),
+    u64LastTxBytes(0),
+    u64LastFrames(0),
+    logFlushTimer(new QTimer(this)),
+    logFilterTimer(new QTimer(this)),
+    logModel(new cLogModel(this)),
     errroMsgBox(nullptr),
     lastUsedIncommingDataPortName(""),
     lasyUsedTestFilename("")
@@ -120,9 +137,10 @@ MainWindow::MainWindow(QWidget *parent) :
 
     connect(ui->closeAppBtn, SIGNAL(clicked(bool)), this, SLOT(close()));
 
+    metricsTimer.start();
     refreshStatusSlot();
     connect(refreshStatusTimer, SIGNAL(timeout()), this, SLOT(refreshStatusSlot()));
-    refreshStatusTimer->start(1000);
+    refreshStatusTimer->start(250);
 
     connect(&engine, SIGNAL(incommingDataInterfaceBecomesOnline(QString)), this, SLOT(incommingDataInterfaceOpenedSlot(QString)));
     connect(&engine, SIGNAL(incommingDataInterfaceTriggersError(QString)), this, SLOT(incommingDataInterfaceErrorSlot(QString)));
@@ -130,9 +148,35 @@ MainWindow::MainWindow(QWidget *parent) :
 
     connect(&engine, SIGNAL(newDebugVariableText(QString)), this, SLOT(newDebugVariableTextSlot(QString)));
 
+    connect(&engine, SIGNAL(newDebugFrameText(int,int,QByteArray)), this, SLOT(newDebugFrameTextSlot(int,int,QByteArray)));
+
+    ui->debugWindow->setModel(logModel);
+    ui->debugWindow->setUniformItemSizes(true);
+    logModel->setShowTimestamps(ui->timestampMessages->isChecked());
+    connect(ui->timestampMessages, SIGNAL(toggled(bool)), logModel, SLOT(setShowTimestamps(bool)));
+
+    logFlushTimer->setSingleShot(true);
+    connect(logFlushTimer, SIGNAL(timeout()), this, SLOT(flushLogSlot()));
+    connect(ui->logMaximumLinesBox, SIGNAL(valueChanged(int)), this, SLOT(logMaximumLinesChangedSlot(int)));
+
+    // the filter scans the whole log, so wait until the typing stops
+    logFilterTimer->setSingleShot(true);
+    logFilterTimer->setInterval(LOG_FILTER_DELAY);
+    connect(ui->logFilterEdit, SIGNAL(textChanged(QString)), logFilterTimer, SLOT(start()));
+    connect(logFilterTimer, SIGNAL(timeout()), this, SLOT(logFilterSlot()));
+    connect(ui->logSearchEdit, SIGNAL(returnPressed()), this, SLOT(logSearchSlot()));
+
     ui->dataReadoutGB->setEnabled(false);
     ui->dataWriteGB->setEnabled(false);
 
+    connect(ui->playbackPauseBtn, SIGNAL(toggled(bool)), this, SLOT(playbackPauseSlot(bool)));
+    connect(ui->playbackSpeedBox, SIGNAL(currentIndexChanged(int)), this, SLOT(playbackSpeedSlot(int)));
+    connect(ui->playbackSlider, SIGNAL(sliderReleased()), this, SLOT(playbackSeekSlot()));
+
+    // the bus a frame is sent to, more than one in reactor mode only
+    cbTxPort = new QComboBox(this);
+    cbTxPort->setFixedWidth(80);
+
     hsbAddr = new HexSpinBox(true, this);
     hsbAddr->setFixedWidth(80);
     hsbCmd = new HexSpinBox(true, this);
@@ -149,6 +193,7 @@ MainWindow::MainWindow(QWidget *parent) :
     twPayload->setColumnCount(1);
     twPayload->horizontalHeader()->hide();
 
+    ui->frameDataLayout->addRow(new QLabel("Port:"), cbTxPort);
     ui->frameDataLayout->addRow(new QLabel("Adres:"), hsbAddr);
     ui->frameDataLayout->addRow(new QLabel("Komenda:"), hsbCmd);
     ui->frameDataLayout->addRow(new QLabel("Dłudość pola danych:"), hsbPayloadLen);
@@ -180,7 +225,7 @@ MainWindow::~MainWindow()
 }
 
 void MainWindow::clearLogSlot(void) {
-    ui->debugWindow->clear();
+    logModel->clear();
 }
 
 void MainWindow::saveLogToFile(void) {
@@ -198,11 +243,17 @@ void MainWindow::saveLogToFile(void) {
 
     if (!fileName.isEmpty()) {
         qDebug() << "fileName: " << fileName;
+        flushLogSlot();
+
         QFile file(fileName);
 
-        if (file.open(QIODevice::ReadWrite)) {
+        if (file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
             QTextStream stream(&file);
-            stream << ui->debugWindow->toPlainText();
+            // line by line, the log is never turned into one big string;
+            // the whole log, not only the rows left by the filter
+            for (int iLine = 0; iLine < logModel->lineCount(); iLine++)
+                stream << logModel->lineText(iLine) << '\n';
+            stream.flush();
             file.flush();
             file.close();
         }
@@ -213,22 +264,174 @@ void MainWindow::saveLogToFile(void) {
     }
 }
 
+void MainWindow::scheduleLogFlush(void) {
+    if (!logFlushTimer->isActive())
+        logFlushTimer->start(LOG_FLUSH_INTERVAL);
+}
+
+void MainWindow::flushLogSlot(void) {
+    logFlushTimer->stop();
+
+    if (!logModel->hasPending())
+        return;
+
+    // follow the end only when the user has not scrolled up
+    QScrollBar *scrollBar = ui->debugWindow->verticalScrollBar();
+    bool bAtEnd = (scrollBar->value() == scrollBar->maximum());
+
+    logModel->commit();
+
+    if (bAtEnd)
+        ui->debugWindow->scrollToBottom();
+}
+
+void MainWindow::logMaximumLinesChangedSlot(int iLines) {
+    // 0: no limit
+    logModel->setMaximumLines(iLines);
+}
+
+void MainWindow::logFilterSlot(void) {
+    logModel->setFilter(ui->logFilterEdit->text());
+    ui->debugWindow->scrollToBottom();
+}
+
+void MainWindow::logSearchSlot(void) {
+    int iFromRow = ui->debugWindow->currentIndex().isValid() ? ui->debugWindow->currentIndex().row() : -1;
+    int iRow = logModel->find(ui->logSearchEdit->text(), iFromRow);
+
+    // from the top again after the last match
+    if (iRow < 0 && iFromRow >= 0)
+        iRow = logModel->find(ui->logSearchEdit->text(), -1);
+
+    if (iRow >= 0) {
+        QModelIndex index = logModel->index(iRow);
+        ui->debugWindow->setCurrentIndex(index);
+        ui->debugWindow->scrollTo(index, QAbstractItemView::PositionAtCenter);
+    }
+}
+
 void MainWindow::newDebugVariableDataSlot(QStringList strLst) {
     for (int i = 0; i < strLst.length(); i++)
-        ui->debugWindow->appendPlainText(strLst.at(i));
+        logModel->append(strLst.at(i).toUtf8());
 
-    ui->debugWindow->appendPlainText("");
+    logModel->append(QByteArray());
+    scheduleLogFlush();
 }
 
 void MainWindow::newDebugVariableTextSlot(QString str) {
-    if (ui->timestampMessages->isChecked()) {
-        ui->debugWindow->appendPlainText(QTime::currentTime().toString("[ HH:mm:ss:zzz ] -> ") + str);
-    } else {
-        ui->debugWindow->appendPlainText(str);
+    logModel->append(str.toUtf8());
+    scheduleLogFlush();
+}
+
+void MainWindow::newDebugFrameTextSlot(int iAddr, int iCmd, QByteArray baText) {
+    logModel->append(iAddr, iCmd, baText);
+    scheduleLogFlush();
+}
+
+static QString playbackTimeToString(uint64_t u64TimeNs) {
+    uint64_t u64Seconds = u64TimeNs / 1000000000ull;
+
+    return QString("%1:%2:%3").arg(u64Seconds / 3600)
+                              .arg((u64Seconds / 60) % 60, 2, 10, QChar('0'))
+                              .arg(u64Seconds % 60, 2, 10, QChar('0'));
+}
+
+// counters start from zero with every session, so a smaller value than last time means a new session
+static double metricsRate(uint64_t u64Now, uint64_t *pu64Last, double dSeconds) {
+    uint64_t u64Delta = (u64Now >= *pu64Last) ? u64Now - *pu64Last : u64Now;
+    *pu64Last = u64Now;
+
+    return (dSeconds > 0) ? u64Delta / dSeconds : 0;
+}
+
+void MainWindow::refreshMetrics(void) {
+    const cEngineMetrics *metrics = engine.metrics();
+    double dSeconds = metricsTimer.restart() / 1000.0;
+
+    uint64_t u64Frames = metrics->frames();
+    double dFramesRate = metricsRate(u64Frames, &u64LastFrames, dSeconds);
+    double dRxRate = metricsRate(metrics->rxBytes(), &u64LastRxBytes, dSeconds);
+    double dTxRate = metricsRate(metrics->txBytes(), &u64LastTxBytes, dSeconds);
+
+    ui->framesInSessionLabel->setText(QString("%1 (%2/s)").arg(u64Frames).arg(dFramesRate, 0, 'f', 0));
+
+    // the three (addr, cmd) pairs seen most often
+    uint64_t u64Top[3] = { 0, 0, 0 };
+    int iTopKey[3] = { 0, 0, 0 };
+    for (int iKey = 0; iKey < 256 * 256; iKey++) {
+        uint64_t u64Count = metrics->frames(iKey >> 8, iKey & 0xFF);
+
+        for (int i = 0; i < 3; i++) {
+            if (u64Count > u64Top[i]) {
+                for (int j = 2; j > i; j--) {
+                    u64Top[j] = u64Top[j - 1];
+                    iTopKey[j] = iTopKey[j - 1];
+                }
+                u64Top[i] = u64Count;
+                iTopKey[i] = iKey;
+                break;
+            }
+        }
     }
+
+    QStringList qslTop;
+    for (int i = 0; i < 3 && u64Top[i] != 0; i++)
+        qslTop << QString("0x%1/0x%2: %3").arg(iTopKey[i] >> 8, 2, 16, QChar('0'))
+                                          .arg(iTopKey[i] & 0xFF, 2, 16, QChar('0'))
+                                          .arg(u64Top[i]);
+
+    const cHdrHistogram &txLatency = metrics->txLatency();
+
+    QStringList qslLines;
+    qslLines << QString("RX: %1 B (%2 B/s), TX: %3 B (%4 B/s)")
+                .arg(metrics->rxBytes()).arg(dRxRate, 0, 'f', 0)
+                .arg(metrics->txBytes()).arg(dTxRate, 0, 'f', 0);
+    qslLines << QString("Błędy CRC: %1, za długie: %2, resynchronizacje: %3, odrzucone bajty: %4, odzyskane ramki: %5, przerwane ramki: %6")
+                .arg(metrics->crcErrors()).arg(metrics->maxPayloadErrors())
+                .arg(metrics->resyncs()).arg(metrics->skippedBytes())
+                .arg(metrics->recoveredFrames()).arg(metrics->rxTimeouts());
+    qslLines << QString("Kolejka TX maks.: %1 B, opóźnienie TX p50/p99/maks.: %2/%3/%4 us")
+                .arg(metrics->txQueueHighWater())
+                .arg(txLatency.valueAtPercentile(50) / 1000)
+                .arg(txLatency.valueAtPercentile(99) / 1000)
+                .arg(txLatency.max() / 1000);
+    qslLines << QString("Najczęstsze ramki (adres/komenda): %1").arg(qslTop.join(", "));
+
+    ui->metricsLabel->setText(qslLines.join("\n"));
 }
 
 void MainWindow::refreshStatusSlot(void) {
+    refreshMetrics();
+
+    const sPlaybackControl_t *psPlayback = engine.playbackControl();
+
+    if (psPlayback->bActive) {
+        uint64_t u64PositionNs = psPlayback->u64PositionNs;
+        uint64_t u64DurationNs = psPlayback->u64DurationNs;
+
+        if (!ui->playbackSlider->isSliderDown() && u64DurationNs != 0)
+            ui->playbackSlider->setValue((int)(u64PositionNs * ui->playbackSlider->maximum() / u64DurationNs));
+
+        ui->playbackPositionLabel->setText(QString("%1 / %2").arg(playbackTimeToString(u64PositionNs),
+                                                                  playbackTimeToString(u64DurationNs)));
+    }
+}
+
+void MainWindow::playbackPauseSlot(bool bPaused) {
+    engine.playbackControl()->bPaused = bPaused;
+}
+
+void MainWindow::playbackSpeedSlot(int iIndex) {
+    static const uint32_t u32Speeds[] = { 1, 10, 100 };
+
+    if (iIndex >= 0 && iIndex < (int)(sizeof(u32Speeds) / sizeof(u32Speeds[0])))
+        engine.playbackControl()->u32Speed = u32Speeds[iIndex];
+}
+
+void MainWindow::playbackSeekSlot(void) {
+    sPlaybackControl_t *psPlayback = engine.playbackControl();
+
+    psPlayback->i64SeekNs = (int64_t)(psPlayback->u64DurationNs * ui->playbackSlider->value() / ui->playbackSlider->maximum());
 }
 
 void MainWindow::refreshBtnSlot(void) {
@@ -249,23 +452,24 @@ void MainWindow::alwaysOnTopToggledSlot(void) {
 void MainWindow::sendBtnSlot(void) {
     qDebug() << "send btn slot" << hsbPayloadLen->value();
 
-    QByteArray baData;
-    for (int i = 0; i < hsbPayloadLen->value(); i++) {
+    uint8_t u8Payload[MAX_TX_PAYLOAD_LENGTH];
+    int iPayloadLen = qMin(hsbPayloadLen->value(), MAX_TX_PAYLOAD_LENGTH);
+
+    for (int i = 0; i < iPayloadLen; i++) {
         bool bOk;
         uint8_t u8Val;
         QTableWidgetItem* item = twPayload->item(i, 0);
         if (item != nullptr) {
-            qDebug() << "nullptr";
             u8Val = item->text().toInt(&bOk, 16);
             if (!bOk)
                 u8Val = 0;
         } else {
             u8Val = 0;
         }
-        baData.append(u8Val);
+        u8Payload[i] = u8Val;
     }
 
-    engine.txData(hsbAddr->value(), hsbCmd->value(), baData);
+    engine.txData(cbTxPort->currentIndex(), hsbAddr->value(), hsbCmd->value(), u8Payload, iPayloadLen);
 }
 
 void MainWindow::resetCalibrationBtnSlot(void) {
@@ -274,7 +478,32 @@ void MainWindow::resetCalibrationBtnSlot(void) {
 
 void MainWindow::incommingDataInterfaceConnectBtnSlot(void) {
     if (!engine.isIncommingDataInterfaceConnected()) {
-        engine.openIncommingDataInterface(ui->incommingDataPortBox->currentText(), 10);
+        QString qsPortName = ui->incommingDataPortBox->currentText();
+
+        // playback without a file name: ask for the capture
+        if (qsPortName == "play:") {
+            QString fileName = QFileDialog::getOpenFileName(this, tr("Otwórz zapis transmisji..."), "",
+                                                            tr("Zapisy transmisji (*.mkcap)"));
+            if (fileName.isEmpty())
+                return;
+
+            qsPortName += fileName;
+            ui->incommingDataPortBox->addItem(qsPortName);
+            ui->incommingDataPortBox->setCurrentIndex(ui->incommingDataPortBox->count() - 1);
+        }
+
+        // reactor without a list of ports: every serial port on the list
+        if (qsPortName == "reactor:") {
+            QStringList qsSerialPorts;
+            for (int i = 0; i < ui->incommingDataPortBox->count(); i++) {
+                if (!ui->incommingDataPortBox->itemText(i).contains(':'))
+                    qsSerialPorts.append(ui->incommingDataPortBox->itemText(i));
+            }
+
+            qsPortName += qsSerialPorts.join(',');
+        }
+
+        engine.openIncommingDataInterface(qsPortName, 10);
     } else {
         engine.closeIncommingDataInterface();
     }
@@ -294,6 +523,13 @@ void MainWindow::refreshPortsList(const QString &lastIncommingPort) {
     }
 
     ui->incommingDataPortBox->addItems(portsList.values());
+    // non-serial transports, see engine/transport.h; pty: and tcp: specs can be typed in
+    ui->incommingDataPortBox->addItem("loop:");
+    ui->incommingDataPortBox->addItem("loop:0x01");
+    ui->incommingDataPortBox->addItem("play:");
+#ifdef MKMX_HAVE_REACTOR
+    ui->incommingDataPortBox->addItem("reactor:");
+#endif
 
     if (lastIncommingPort.isEmpty()) {
         //set previously selected port:
@@ -327,9 +563,16 @@ void MainWindow::incommingDataInterfaceOpenedSlot(const QString &pn) {
     ui->dataReadoutGB->setEnabled(true);
     ui->dataWriteGB->setEnabled(true);
 
+    cbTxPort->clear();
+    cbTxPort->addItems(engine.portNames());
+    cbTxPort->setEnabled(cbTxPort->count() > 1);
+
     ui->incommingDataRefreshBtn->setEnabled(false);
     ui->incommingDataPortBox->setEnabled(false);
 
+    ui->playbackGB->setEnabled(pn.startsWith("play:"));
+    ui->playbackPauseBtn->setChecked(false);
+
     //remember this selection for future sessions:
     lastUsedIncommingDataPortName = pn;
 }
@@ -367,6 +610,8 @@ void MainWindow::incommingDataInterfaceClosedSlot(void) {
 
     ui->incommingDataRefreshBtn->setEnabled(true);
     ui->incommingDataPortBox->setEnabled(true);
+
+    ui->playbackGB->setEnabled(false);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
@@ -402,6 +647,9 @@ void MainWindow::readSettings() {
 
     lastUsedIncommingDataPortName = globalSettings->value("lastUsedIncommingDataPortName", "").toString();
 
+    ui->logMaximumLinesBox->setValue(globalSettings->value("logMaximumLines", LOG_DEFAULT_MAXIMUM_LINES).toInt());
+    logModel->setMaximumLines(ui->logMaximumLinesBox->value());
+
     engine.readSettings(globalSettings);
 }
 
@@ -413,5 +661,7 @@ void MainWindow::writeSettings() {
 
     globalSettings->setValue("lastUsedIncommingDataPortName", lastUsedIncommingDataPortName);
 
+    globalSettings->setValue("logMaximumLines", ui->logMaximumLinesBox->value());
+
     engine.writeSettings(globalSettings);
 }
@@ -3,6 +3,8 @@
 
 #include <QMainWindow>
 #include <QSettings>
+#include <QStringList>
+#include <QElapsedTimer>
 
 #include "engine/engine.h"
 
@@ -12,7 +14,9 @@ class MainWindow;
 
 class HexSpinBox;
 class QTableWidget;
+class QComboBox;
 class QMessageBox;
+class cLogModel;
 
 class MainWindow : public QMainWindow
 {
@@ -22,6 +26,12 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    void setCaptureDirectory(const QString &qsDirectory) { engine.setCaptureDirectory(qsDirectory); }
+    void setArchiveDirectory(const QString &qsDirectory) { engine.setArchiveDirectory(qsDirectory); }
+    void setInterByteTimeout(uint32_t u32Characters) { engine.setInterByteTimeout(u32Characters); }
+    void setLogSinkConfig(const sLogSinkConfig_t &sConfig) { engine.setLogSinkConfig(sConfig); }
+    const sLogSinkConfig_t &getLogSinkConfig(void) const { return engine.getLogSinkConfig(); }
+
 protected:
     void closeEvent(QCloseEvent *evt);
 
@@ -31,6 +41,8 @@ private:
     void writeSettings();
     void readSettings();
 
+    void refreshMetrics(void);
+
 private slots:
     void refreshBtnSlot(void);
 
@@ -46,11 +58,21 @@ private slots:
 
     void newDebugVariableDataSlot(QStringList strLst);
     void newDebugVariableTextSlot(QString str);
+    void newDebugFrameTextSlot(int iAddr, int iCmd, QByteArray baText);
 
     void payloadLenChanged(int i);
 
     void refreshStatusSlot(void);
 
+    void flushLogSlot(void);
+    void logMaximumLinesChangedSlot(int iLines);
+    void logFilterSlot(void);
+    void logSearchSlot(void);
+
+    void playbackPauseSlot(bool bPaused);
+    void playbackSpeedSlot(int iIndex);
+    void playbackSeekSlot(void);
+
     void sendBtnSlot(void);
     void resetCalibrationBtnSlot(void);
 
@@ -59,6 +81,19 @@ private:
     QSettings *globalSettings;
     QTimer *refreshStatusTimer;
 
+    // previous counter values, for the rates shown by refreshMetrics()
+    QElapsedTimer metricsTimer;
+    uint64_t u64LastRxBytes;
+    uint64_t u64LastTxBytes;
+    uint64_t u64LastFrames;
+
+    // appended lines reach debugWindow in one batch per logFlushTimer period
+    QTimer *logFlushTimer;
+    QTimer *logFilterTimer;
+    cLogModel *logModel;
+    void scheduleLogFlush(void);
+
+    QComboBox* cbTxPort;
     HexSpinBox* hsbAddr;
     HexSpinBox* hsbCmd;
     HexSpinBox* hsbPayloadLen;
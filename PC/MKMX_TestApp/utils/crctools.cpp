@@ -1,31 +1,83 @@
 #include "crctools.h"
 
-#include "debugtools.h"
-
-uint8_t _crc8_ccitt_update(uint8_t inCrc, uint8_t inData) {
-    uint8_t   i;
-    uint8_t   data;
-    data = inCrc ^ inData;
-
-    for ( i = 0; i < 8; i++ ) {
-        if (( data & 0x80 ) != 0 ) {
-            data <<= 1;
-            data ^= 0x07;
-        } else {
-            data <<= 1;
-        }
+#include <utility>
+
+// one bit at a time, same as the original _crc8_ccitt_update loop
+static constexpr uint8_t crc8Shift(uint8_t u8Crc, int iBits) {
+    return (iBits == 0) ? u8Crc
+                        : crc8Shift((u8Crc & 0x80) ? (uint8_t)((u8Crc << 1) ^ CRC8_CCITT_POLY) : (uint8_t)(u8Crc << 1), iBits - 1);
+}
+
+// CRC of a single byte followed by iSlice zero bytes
+static constexpr uint8_t crc8Entry(size_t szByte, int iSlice) {
+    return crc8Shift((uint8_t)szByte, 8 * (iSlice + 1));
+}
+
+template <size_t... I>
+static constexpr sCrc8Tables_t makeCrc8Tables(std::index_sequence<I...>) {
+    return sCrc8Tables_t { {
+        { crc8Entry(I, 0)... }, { crc8Entry(I, 1)... }, { crc8Entry(I, 2)... }, { crc8Entry(I, 3)... },
+        { crc8Entry(I, 4)... }, { crc8Entry(I, 5)... }, { crc8Entry(I, 6)... }, { crc8Entry(I, 7)... }
+    } };
+}
+
+static constexpr sCrc8Tables_t sCrc8CcittTablesInit = makeCrc8Tables(std::make_index_sequence<256>());
+
+static_assert(sCrc8CcittTablesInit.u8Slice[0][0x01] == CRC8_CCITT_POLY, "CRC8 table generation broken");
+static_assert(sCrc8CcittTablesInit.u8Slice[0][0xFF] == 0xF3, "CRC8 table generation broken");
+
+const sCrc8Tables_t sCrc8CcittTables = sCrc8CcittTablesInit;
+
+uint8_t crc8CcittUpdateBlock(uint8_t inCrc, const uint8_t *pu8Data, size_t szLen) {
+    const uint8_t (*T)[256] = sCrc8CcittTables.u8Slice;
+    uint8_t crc = inCrc;
+
+    // slice-by-8: eight independent lookups per step instead of a dependency chain
+    while (szLen >= 8) {
+        crc = T[7][crc ^ pu8Data[0]] ^ T[6][pu8Data[1]] ^ T[5][pu8Data[2]] ^ T[4][pu8Data[3]] ^
+              T[3][pu8Data[4]] ^ T[2][pu8Data[5]] ^ T[1][pu8Data[6]] ^ T[0][pu8Data[7]];
+        pu8Data += 8;
+        szLen -= 8;
+    }
+
+    if (szLen >= 4) {
+        crc = T[3][crc ^ pu8Data[0]] ^ T[2][pu8Data[1]] ^ T[1][pu8Data[2]] ^ T[0][pu8Data[3]];
+        pu8Data += 4;
+        szLen -= 4;
     }
-    return data;
+
+    while (szLen--)
+        crc = T[0][crc ^ *pu8Data++];
+
+    return crc;
 }
 
-uint8_t computeCRC(uint8_t* pu8Data, uint16_t u16Len) {
-    uint8_t crc = 0;
-    uint16_t i;
+// copies szLen bytes and returns the CRC updated over them, in a single pass over the data
+uint8_t crc8CcittCopyBlock(uint8_t inCrc, uint8_t *pu8Dst, const uint8_t *pu8Src, size_t szLen) {
+    const uint8_t (*T)[256] = sCrc8CcittTables.u8Slice;
+    uint8_t crc = inCrc;
+
+    while (szLen >= 4) {
+        uint8_t b0 = pu8Src[0], b1 = pu8Src[1], b2 = pu8Src[2], b3 = pu8Src[3];
+        pu8Dst[0] = b0;
+        pu8Dst[1] = b1;
+        pu8Dst[2] = b2;
+        pu8Dst[3] = b3;
+        crc = T[3][crc ^ b0] ^ T[2][b1] ^ T[1][b2] ^ T[0][b3];
+        pu8Src += 4;
+        pu8Dst += 4;
+        szLen -= 4;
+    }
 
-    for (i = 0; i < u16Len; i++) {
-        qDebug() << u8ToString(pu8Data[i]);
-        crc = _crc8_ccitt_update(crc, pu8Data[i]);
+    while (szLen--) {
+        uint8_t b = *pu8Src++;
+        *pu8Dst++ = b;
+        crc = T[0][crc ^ b];
     }
 
     return crc;
 }
+
+uint8_t computeCRC(const uint8_t *pu8Data, uint16_t u16Len) {
+    return crc8CcittUpdateBlock(0, pu8Data, u16Len);
+}
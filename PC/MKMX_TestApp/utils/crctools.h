@@ -2,9 +2,23 @@
 #define CRCTOOLS_H
 
 #include <stdint.h>
+#include <stddef.h>
 
-uint8_t _crc8_ccitt_update(uint8_t inCrc, uint8_t inData);
-uint8_t computeCRC(uint8_t* pu8Data, uint16_t u16Len);
+#define CRC8_CCITT_POLY     0x07
 
-#endif // CRCTOOLS_H
+// u8Slice[0] is the classic byte-wise table, u8Slice[n] advances a byte through n more zero bytes
+typedef struct {
+    uint8_t u8Slice[8][256];
+} sCrc8Tables_t;
+
+extern const sCrc8Tables_t sCrc8CcittTables;
+
+static inline uint8_t _crc8_ccitt_update(uint8_t inCrc, uint8_t inData) {
+    return sCrc8CcittTables.u8Slice[0][inCrc ^ inData];
+}
 
+uint8_t crc8CcittUpdateBlock(uint8_t inCrc, const uint8_t *pu8Data, size_t szLen);
+uint8_t crc8CcittCopyBlock(uint8_t inCrc, uint8_t *pu8Dst, const uint8_t *pu8Src, size_t szLen);
+uint8_t computeCRC(const uint8_t *pu8Data, uint16_t u16Len);
+
+#endif // CRCTOOLS_H
@@ -0,0 +1,84 @@
+#include "hdrhistogram.h"
+
+#include <QtAlgorithms>
+
+#include <math.h>
+
+cHdrHistogram::cHdrHistogram() {
+    reset();
+}
+
+void cHdrHistogram::reset(void) {
+    for (uint32_t i = 0; i < HDR_BUCKETS; i++)
+        m_u64Counts[i].store(0, std::memory_order_relaxed);
+
+    m_u64Count.store(0, std::memory_order_relaxed);
+    m_u64Sum.store(0, std::memory_order_relaxed);
+    m_u64Max.store(0, std::memory_order_relaxed);
+}
+
+// the first 2 * HDR_SUB_BUCKETS buckets hold one value each, every following group of HDR_SUB_BUCKETS
+// buckets covers one power of two
+uint32_t cHdrHistogram::bucketOf(uint64_t u64Value) {
+    if (u64Value < 2 * HDR_SUB_BUCKETS)
+        return u64Value;
+
+    uint32_t u32Shift = (63 - qCountLeadingZeroBits((quint64)u64Value)) - HDR_SUB_BUCKET_BITS;
+    uint32_t u32Sub = (u64Value >> u32Shift) - HDR_SUB_BUCKETS;
+
+    return HDR_SUB_BUCKETS + u32Shift * HDR_SUB_BUCKETS + u32Sub;
+}
+
+uint64_t cHdrHistogram::highestValueOf(uint32_t u32Bucket) {
+    if (u32Bucket < 2 * HDR_SUB_BUCKETS)
+        return u32Bucket;
+
+    uint32_t u32Shift = (u32Bucket - HDR_SUB_BUCKETS) / HDR_SUB_BUCKETS;
+    uint64_t u64Sub = HDR_SUB_BUCKETS + (u32Bucket - HDR_SUB_BUCKETS) % HDR_SUB_BUCKETS;
+
+    return ((u64Sub + 1) << u32Shift) - 1;
+}
+
+void cHdrHistogram::record(uint64_t u64Value) {
+    m_u64Counts[bucketOf(u64Value)].fetch_add(1, std::memory_order_relaxed);
+    m_u64Sum.fetch_add(u64Value, std::memory_order_relaxed);
+
+    uint64_t u64Max = m_u64Max.load(std::memory_order_relaxed);
+    while (u64Value > u64Max && !m_u64Max.compare_exchange_weak(u64Max, u64Value, std::memory_order_relaxed))
+        ;
+
+    // last, so a reader never sees more values counted than there are in the buckets
+    m_u64Count.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t cHdrHistogram::mean(void) const {
+    uint64_t u64Count = count();
+    if (u64Count == 0)
+        return 0;
+
+    return m_u64Sum.load(std::memory_order_relaxed) / u64Count;
+}
+
+uint64_t cHdrHistogram::valueAtPercentile(double dPercentile) const {
+    uint64_t u64Count = m_u64Count.load(std::memory_order_acquire);
+    if (u64Count == 0)
+        return 0;
+
+    uint64_t u64Target = (uint64_t)ceil(dPercentile / 100.0 * u64Count);
+    if (u64Target < 1)
+        u64Target = 1;
+
+    uint64_t u64Seen = 0;
+    for (uint32_t i = 0; i < HDR_BUCKETS; i++) {
+        u64Seen += m_u64Counts[i].load(std::memory_order_relaxed);
+
+        if (u64Seen >= u64Target) {
+            uint64_t u64Value = highestValueOf(i);
+            uint64_t u64Max = max();
+
+            return (u64Value < u64Max) ? u64Value : u64Max;
+        }
+    }
+
+    return max();
+}
@@ -0,0 +1,42 @@
+#ifndef HDRHISTOGRAM_H
+#define HDRHISTOGRAM_H
+
+#include <atomic>
+
+#include <stdint.h>
+
+// values below 2 * HDR_SUB_BUCKETS are counted exactly, larger ones with a relative error below 1 / HDR_SUB_BUCKETS
+#define HDR_SUB_BUCKET_BITS     5
+#define HDR_SUB_BUCKETS         (1u << HDR_SUB_BUCKET_BITS)
+#define HDR_BUCKETS             (2 * HDR_SUB_BUCKETS + (64 - HDR_SUB_BUCKET_BITS - 1) * HDR_SUB_BUCKETS)
+
+// Log-linear (HDR style) histogram of 64-bit values over the whole range, without any configuration.
+// record() is lock-free and may be called from any thread, readers see a consistent enough snapshot
+// for a status display (counts are not frozen while they are summed).
+class cHdrHistogram
+{
+public:
+    cHdrHistogram();
+
+    void record(uint64_t u64Value);
+    // not synchronised with record(), values recorded meanwhile may survive
+    void reset(void);
+
+    uint64_t count(void) const { return m_u64Count.load(std::memory_order_relaxed); }
+    uint64_t max(void) const { return m_u64Max.load(std::memory_order_relaxed); }
+    uint64_t mean(void) const;
+
+    // highest value equivalent to the one below which dPercentile % of the recorded values are
+    uint64_t valueAtPercentile(double dPercentile) const;
+
+private:
+    std::atomic<uint64_t> m_u64Counts[HDR_BUCKETS];
+    std::atomic<uint64_t> m_u64Count;
+    std::atomic<uint64_t> m_u64Sum;
+    std::atomic<uint64_t> m_u64Max;
+
+    static uint32_t bucketOf(uint64_t u64Value);
+    static uint64_t highestValueOf(uint32_t u32Bucket);
+};
+
+#endif // HDRHISTOGRAM_H
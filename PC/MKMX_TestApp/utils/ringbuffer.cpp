@@ -1,19 +1,24 @@
 #include "ringbuffer.h"
 
-static inline uint16_t u16GetNextBuffIdx(uint16_t u16BufferIdx, uint16_t u16BUFFER_SIZE) {
-    uint16_t u16Temp = u16BufferIdx;
-    u16Temp++;
-
-    // See if buffer size is a power of two
-    if ((u16BUFFER_SIZE & (u16BUFFER_SIZE - 1)) == 0) {
+#include <string.h>
+
+// u32BufferIdx must be below 2 * buffer size
+static inline uint16_t u16WrapBuffIdx(const sRingBuffer_t *psBuffer, uint32_t u32BufferIdx) {
+#ifdef RINGBUFFER_POWER_OF_TWO_ONLY
+    return u32BufferIdx & (psBuffer->u16Size - 1);
+#else
+    if (psBuffer->u16Mask != 0) {
         // Use masking to optimize pointer wrapping to index 0
-        u16Temp &= (u16BUFFER_SIZE - 1);
+        return u32BufferIdx & psBuffer->u16Mask;
     } else {
         // Wrap index to 0 if it has exceeded buffer boundary
-        if (u16Temp == u16BUFFER_SIZE) u16Temp = 0;
+        return (u32BufferIdx >= psBuffer->u16Size) ? (u32BufferIdx - psBuffer->u16Size) : u32BufferIdx;
     }
+#endif
+}
 
-    return u16Temp;
+static inline uint16_t u16GetNextBuffIdx(const sRingBuffer_t *psBuffer, uint16_t u16BufferIdx) {
+    return u16WrapBuffIdx(psBuffer, (uint32_t)u16BufferIdx + 1);
 }
 
 void InitializeRingBuffer(sRingBuffer_t *psBuffer, uint8_t *pu8Buffer, uint16_t u16BuffSize, void (*vBuffOvf_func)(void)) {
@@ -23,6 +28,9 @@ void InitializeRingBuffer(sRingBuffer_t *psBuffer, uint8_t *pu8Buffer, uint16_t
     psBuffer->pu8Buffer = pu8Buffer;
     psBuffer->u16Size = u16BuffSize;
 
+    // See if buffer size is a power of two
+    psBuffer->u16Mask = ((u16BuffSize & (u16BuffSize - 1)) == 0) ? (u16BuffSize - 1) : 0;
+
     psBuffer->vOvfHandler = vBuffOvf_func;
 }
 
@@ -43,7 +51,7 @@ uint16_t NoOfFreeBytes(sRingBuffer_t *psBuffer) {
 
 bool IsFull(sRingBuffer_t *psBuffer) {
     // Calculate next pointer position
-    uint16_t index = u16GetNextBuffIdx(psBuffer->u16In, psBuffer->u16Size);
+    uint16_t index = u16GetNextBuffIdx(psBuffer, psBuffer->u16In);
 
     if (index == psBuffer->u16Out)
         return true;
@@ -60,7 +68,7 @@ bool IsEmpty(sRingBuffer_t *psBuffer) {
 
 bool PushByte(sRingBuffer_t *psBuffer, uint8_t u8Data) {
     // Calculate next pointer position
-    uint16_t index = u16GetNextBuffIdx(psBuffer->u16In, psBuffer->u16Size);
+    uint16_t index = u16GetNextBuffIdx(psBuffer, psBuffer->u16In);
 
     // Make sure there is space available in buffer
     if (index == psBuffer->u16Out) {
@@ -79,22 +87,30 @@ bool PushByte(sRingBuffer_t *psBuffer, uint8_t u8Data) {
     return true;
 }
 
-uint8_t PushData(sRingBuffer_t *psBuffer, const uint8_t* pu8Data, uint8_t u8NoBytesToSend) {
-    uint8_t bytes_buffered = 0;
-
-    while (u8NoBytesToSend) {
-        if (PushByte(psBuffer, *pu8Data)) {
-            pu8Data++;
-
-            // Next byte
-            bytes_buffered++;
-            u8NoBytesToSend--;
-        } else {
-            break;
-        }
-    }
+uint16_t PushData16(sRingBuffer_t *psBuffer, const uint8_t* pu8Data, uint16_t u16NoBytesToSend) {
+    uint16_t u16In = psBuffer->u16In;
+    uint16_t u16Free = NoOfFreeBytes(psBuffer);
+    uint16_t u16Len = (u16NoBytesToSend > u16Free) ? u16Free : u16NoBytesToSend;
+
+    // at most two copies: up to the end of the buffer and the wrapped rest
+    uint16_t u16First = psBuffer->u16Size - u16In;
+    if (u16First > u16Len)
+        u16First = u16Len;
+
+    memcpy(&psBuffer->pu8Buffer[u16In], pu8Data, u16First);
+    memcpy(&psBuffer->pu8Buffer[0], pu8Data + u16First, u16Len - u16First);
+
+    // Advance pointer
+    psBuffer->u16In = u16WrapBuffIdx(psBuffer, (uint32_t)u16In + u16Len);
 
-    return bytes_buffered;
+    if ((u16Len < u16NoBytesToSend) && (psBuffer->vOvfHandler != 0))
+        psBuffer->vOvfHandler();
+
+    return u16Len;
+}
+
+uint8_t PushData(sRingBuffer_t *psBuffer, const uint8_t* pu8Data, uint8_t u8NoBytesToSend) {
+    return (uint8_t)PushData16(psBuffer, pu8Data, u8NoBytesToSend);
 }
 
 bool PopByte(sRingBuffer_t *psBuffer, uint8_t* pu8Data) {
@@ -104,24 +120,29 @@ bool PopByte(sRingBuffer_t *psBuffer, uint8_t* pu8Data) {
     *pu8Data = psBuffer->pu8Buffer[psBuffer->u16Out];
 
     // Advance pointer
-    psBuffer->u16Out = u16GetNextBuffIdx(psBuffer->u16Out, psBuffer->u16Size);
+    psBuffer->u16Out = u16GetNextBuffIdx(psBuffer, psBuffer->u16Out);
 
     return true;
 }
 
-uint8_t PopData(sRingBuffer_t *psBuffer, uint8_t* pu8DataBuffer, uint8_t u8MaxDataBytes) {
-    uint8_t u8NoOfPoppedBytes = 0;
+uint16_t PopData16(sRingBuffer_t *psBuffer, uint8_t* pu8DataBuffer, uint16_t u16MaxDataBytes) {
+    uint16_t u16Out = psBuffer->u16Out;
+    uint16_t u16Used = NoOfUsedBytes(psBuffer);
+    uint16_t u16Len = (u16MaxDataBytes > u16Used) ? u16Used : u16MaxDataBytes;
 
-    while (u8NoOfPoppedBytes < u8MaxDataBytes) {
-        if (IsEmpty(psBuffer))
-            return u8NoOfPoppedBytes;
+    uint16_t u16First = psBuffer->u16Size - u16Out;
+    if (u16First > u16Len)
+        u16First = u16Len;
 
-        *(pu8DataBuffer + u8NoOfPoppedBytes) = psBuffer->pu8Buffer[psBuffer->u16Out];
-        u8NoOfPoppedBytes++;
+    memcpy(pu8DataBuffer, &psBuffer->pu8Buffer[u16Out], u16First);
+    memcpy(pu8DataBuffer + u16First, &psBuffer->pu8Buffer[0], u16Len - u16First);
 
-        // Advance pointer
-        psBuffer->u16Out = u16GetNextBuffIdx(psBuffer->u16Out, psBuffer->u16Size);
-    }
+    // Advance pointer
+    psBuffer->u16Out = u16WrapBuffIdx(psBuffer, (uint32_t)u16Out + u16Len);
 
-    return u8NoOfPoppedBytes;
+    return u16Len;
+}
+
+uint8_t PopData(sRingBuffer_t *psBuffer, uint8_t* pu8DataBuffer, uint8_t u8MaxDataBytes) {
+    return (uint8_t)PopData16(psBuffer, pu8DataBuffer, u8MaxDataBytes);
 }
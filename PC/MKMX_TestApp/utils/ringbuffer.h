@@ -3,11 +3,16 @@
 
 #include <stdint.h>
 
+// Define RINGBUFFER_POWER_OF_TWO_ONLY when every buffer size is a power of two,
+// index wrapping then compiles to a single mask without any run-time check.
+
 typedef struct {
     /// Transmit ring (circular) buffer
     uint8_t *pu8Buffer;
 
     uint16_t u16Size;
+    // u16Size - 1 when the size is a power of two, 0 otherwise (computed once at init)
+    uint16_t u16Mask;
 
     //in & out pointers
     volatile uint16_t u16Out;
@@ -29,8 +34,10 @@ bool IsEmpty(sRingBuffer_t *psBuffer);
 
 bool PushByte(sRingBuffer_t *psBuffer, uint8_t u8Data);
 uint8_t PushData(sRingBuffer_t *psBuffer, const uint8_t* pu8Data, uint8_t u8NoBytesToSend);
+uint16_t PushData16(sRingBuffer_t *psBuffer, const uint8_t* pu8Data, uint16_t u16NoBytesToSend);
 
 bool PopByte(sRingBuffer_t *psBuffer, uint8_t* pu8Data);
 uint8_t PopData(sRingBuffer_t *psBuffer, uint8_t* pu8DataBuffer, uint8_t u8MaxDataBytes);
+uint16_t PopData16(sRingBuffer_t *psBuffer, uint8_t* pu8DataBuffer, uint16_t u16MaxDataBytes);
 
 #endif //__RINGBUFFER_H__
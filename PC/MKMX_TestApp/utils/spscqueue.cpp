@@ -0,0 +1,99 @@
+#include "spscqueue.h"
+
+#include <string.h>
+
+cSpscByteQueue::cSpscByteQueue(uint8_t *pu8Buffer, uint32_t u32Size) :
+    m_pu8Buffer(pu8Buffer),
+    m_u32Mask(u32Size - 1),
+    m_u32Head(0),
+    m_u32Tail(0)
+{
+}
+
+uint32_t cSpscByteQueue::usedBytes(void) const {
+    uint32_t u32Tail = m_u32Tail.load(std::memory_order_acquire);
+    uint32_t u32Head = m_u32Head.load(std::memory_order_acquire);
+    uint32_t u32Used = u32Head - u32Tail;
+
+    // a third thread may see a tail older than the head it reads next
+    return (u32Used > size()) ? size() : u32Used;
+}
+
+uint32_t cSpscByteQueue::freeBytes(void) const {
+    return size() - usedBytes();
+}
+
+uint32_t cSpscByteQueue::push(const uint8_t *pu8Data, uint32_t u32Len) {
+    uint32_t u32Head = m_u32Head.load(std::memory_order_relaxed);
+    uint32_t u32Tail = m_u32Tail.load(std::memory_order_acquire);
+
+    uint32_t u32Free = size() - (u32Head - u32Tail);
+    if (u32Len > u32Free)
+        u32Len = u32Free;
+
+    uint32_t u32Idx = u32Head & m_u32Mask;
+    uint32_t u32First = size() - u32Idx;
+    if (u32First > u32Len)
+        u32First = u32Len;
+
+    memcpy(&m_pu8Buffer[u32Idx], pu8Data, u32First);
+    memcpy(&m_pu8Buffer[0], pu8Data + u32First, u32Len - u32First);
+
+    // publish the data to the consumer
+    m_u32Head.store(u32Head + u32Len, std::memory_order_release);
+
+    return u32Len;
+}
+
+bool cSpscByteQueue::reserve(uint32_t u32Len, sSpscRegion_t *psRegion) {
+    uint32_t u32Head = m_u32Head.load(std::memory_order_relaxed);
+    uint32_t u32Tail = m_u32Tail.load(std::memory_order_acquire);
+
+    if (u32Len > size() - (u32Head - u32Tail))
+        return false;
+
+    uint32_t u32Idx = u32Head & m_u32Mask;
+    uint32_t u32First = size() - u32Idx;
+    if (u32First > u32Len)
+        u32First = u32Len;
+
+    psRegion->pu8Seg[0] = &m_pu8Buffer[u32Idx];
+    psRegion->u32SegLen[0] = u32First;
+    psRegion->pu8Seg[1] = &m_pu8Buffer[0];
+    psRegion->u32SegLen[1] = u32Len - u32First;
+
+    return true;
+}
+
+void cSpscByteQueue::commit(uint32_t u32Len) {
+    uint32_t u32Head = m_u32Head.load(std::memory_order_relaxed);
+
+    // publish the data to the consumer
+    m_u32Head.store(u32Head + u32Len, std::memory_order_release);
+}
+
+uint32_t cSpscByteQueue::pop(uint8_t *pu8Data, uint32_t u32MaxLen) {
+    uint32_t u32Tail = m_u32Tail.load(std::memory_order_relaxed);
+    uint32_t u32Head = m_u32Head.load(std::memory_order_acquire);
+
+    uint32_t u32Len = u32Head - u32Tail;
+    if (u32Len > u32MaxLen)
+        u32Len = u32MaxLen;
+
+    uint32_t u32Idx = u32Tail & m_u32Mask;
+    uint32_t u32First = size() - u32Idx;
+    if (u32First > u32Len)
+        u32First = u32Len;
+
+    memcpy(pu8Data, &m_pu8Buffer[u32Idx], u32First);
+    memcpy(pu8Data + u32First, &m_pu8Buffer[0], u32Len - u32First);
+
+    // hand the space back to the producer
+    m_u32Tail.store(u32Tail + u32Len, std::memory_order_release);
+
+    return u32Len;
+}
+
+void cSpscByteQueue::flush(void) {
+    m_u32Tail.store(m_u32Head.load(std::memory_order_acquire), std::memory_order_release);
+}
@@ -0,0 +1,49 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+
+#include <stdint.h>
+
+// up to two contiguous parts of the queue buffer (the second one is used only when the region wraps)
+typedef struct {
+    uint8_t *pu8Seg[2];
+    uint32_t u32SegLen[2];
+} sSpscRegion_t;
+
+// Lock-free single-producer/single-consumer byte queue.
+// Head is written only by the producer thread, tail only by the consumer thread; both indices
+// run freely and are masked on access, so the buffer size must be a power of two and the whole
+// buffer is usable. Data is moved with at most two memcpy calls per transfer.
+class cSpscByteQueue
+{
+public:
+    cSpscByteQueue(uint8_t *pu8Buffer, uint32_t u32Size);
+
+    // any thread (the result is a snapshot, never above size())
+    uint32_t usedBytes(void) const;
+    uint32_t freeBytes(void) const;
+    uint32_t size(void) const { return m_u32Mask + 1; }
+
+    // producer side
+    uint32_t push(const uint8_t *pu8Data, uint32_t u32Len);
+
+    // producer side, zero-copy: reserve exactly u32Len bytes (all or nothing), fill them in place
+    // and publish with commit(); nothing is visible to the consumer before commit()
+    bool reserve(uint32_t u32Len, sSpscRegion_t *psRegion);
+    void commit(uint32_t u32Len);
+
+    // consumer side
+    uint32_t pop(uint8_t *pu8Data, uint32_t u32MaxLen);
+    void flush(void);
+
+private:
+    uint8_t *m_pu8Buffer;
+    uint32_t m_u32Mask;
+
+    // separate cache lines, so producer and consumer do not bounce each other's line
+    alignas(64) std::atomic<uint32_t> m_u32Head;
+    alignas(64) std::atomic<uint32_t> m_u32Tail;
+};
+
+#endif // SPSCQUEUE_H
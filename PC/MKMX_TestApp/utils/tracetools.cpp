@@ -0,0 +1,169 @@
+#include "tracetools.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "debugtools.h"
+
+static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+
+// u32Seq is n while record n is being written into the slot and n + 1 once it is complete,
+// so traceDump() can tell a valid copy from a torn one without stopping the owning thread
+typedef struct {
+    std::atomic<uint32_t> u32Seq;
+    sTraceRecord_t sRecord;
+} sTraceSlot_t;
+
+typedef struct {
+    // written only by the owning thread, read by traceDump()
+    std::atomic<uint32_t> u32Head;
+    sTraceSlot_t sSlots[TRACE_RING_SIZE];
+} sTraceRing_t;
+
+static const char *pcTraceEventNames[eTraceEventsCount] = {
+    "IFACE opened",
+    "IFACE closed",
+    "IFACE rx chunk      len",
+    "IFACE tx frame      addr/cmd/len",
+    "IFACE tx no space   len/free",
+    "IFACE tx offline    addr/cmd",
+    "ENGINE frame        addr/cmd/len",
+    "ENGINE crc error    addr/cmd/crc",
+    "ENGINE max payload  addr/cmd/len",
+    "ENGINE rx timeout   addr/cmd/len"
+};
+
+static std::mutex traceRingsMutex;
+// every ring ever allocated, its position names the thread in the dump
+static std::vector<sTraceRing_t *> traceRings;
+// rings of finished threads
+static std::vector<sTraceRing_t *> traceFreeRings;
+
+// rings are never freed, so records of finished threads can still be dumped; a reused ring continues
+// at its head and keeps the old records until the new thread overwrites them
+static sTraceRing_t *traceAttachThread(void) {
+    std::lock_guard<std::mutex> locker(traceRingsMutex);
+
+    if (!traceFreeRings.empty()) {
+        sTraceRing_t *ring = traceFreeRings.back();
+        traceFreeRings.pop_back();
+        return ring;
+    }
+
+    sTraceRing_t *ring = new sTraceRing_t;
+    ring->u32Head.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < TRACE_RING_SIZE; i++)
+        ring->sSlots[i].u32Seq.store(0, std::memory_order_relaxed);
+
+    traceRings.push_back(ring);
+
+    return ring;
+}
+
+static void traceDetachThread(sTraceRing_t *ring) {
+    std::lock_guard<std::mutex> locker(traceRingsMutex);
+    traceFreeRings.push_back(ring);
+}
+
+// thread_local owner of the ring, returns it when the thread ends
+class cTraceRingOwner
+{
+public:
+    cTraceRingOwner() : m_ring(traceAttachThread()) {}
+    ~cTraceRingOwner() { traceDetachThread(m_ring); }
+
+    sTraceRing_t *ring(void) const { return m_ring; }
+
+private:
+    sTraceRing_t *m_ring;
+};
+
+void traceRecord(uint8_t u8Level, eTraceEvent_t eEvent, uint32_t u32Arg0, uint32_t u32Arg1, uint32_t u32Arg2) {
+    static thread_local cTraceRingOwner owner;
+    sTraceRing_t *ring = owner.ring();
+
+    uint32_t u32Head = ring->u32Head.load(std::memory_order_relaxed);
+    sTraceSlot_t *slot = &ring->sSlots[u32Head & (TRACE_RING_SIZE - 1)];
+    sTraceRecord_t *record = &slot->sRecord;
+
+    // the slot is invalid before any of its fields change
+    slot->u32Seq.store(u32Head, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record->u64TimestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch()).count();
+    record->u16Event = eEvent;
+    record->u8Level = u8Level;
+    record->u32Arg[0] = u32Arg0;
+    record->u32Arg[1] = u32Arg1;
+    record->u32Arg[2] = u32Arg2;
+
+    slot->u32Seq.store(u32Head + 1, std::memory_order_release);
+    ring->u32Head.store(u32Head + 1, std::memory_order_release);
+}
+
+QStringList traceDump(void) {
+    // record and the position of its ring
+    std::vector<std::pair<sTraceRecord_t, uint32_t>> records;
+
+    {
+        std::lock_guard<std::mutex> locker(traceRingsMutex);
+
+        for (uint32_t u32Ring = 0; u32Ring < traceRings.size(); u32Ring++) {
+            sTraceRing_t *ring = traceRings[u32Ring];
+            uint32_t u32Head = ring->u32Head.load(std::memory_order_acquire);
+            // the oldest slot is the next one to be written, it may be in flight already
+            uint32_t u32Count = (u32Head < TRACE_RING_SIZE) ? u32Head : TRACE_RING_SIZE - 1;
+
+            for (uint32_t i = u32Head - u32Count; i != u32Head; i++) {
+                const sTraceSlot_t *slot = &ring->sSlots[i & (TRACE_RING_SIZE - 1)];
+
+                // skip records the owning thread overwrote while we were copying
+                uint32_t u32Seq = slot->u32Seq.load(std::memory_order_acquire);
+                if (u32Seq != i + 1)
+                    continue;
+
+                sTraceRecord_t record = slot->sRecord;
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot->u32Seq.load(std::memory_order_relaxed) != u32Seq)
+                    continue;
+
+                records.push_back(std::make_pair(record, u32Ring));
+            }
+        }
+    }
+
+    std::stable_sort(records.begin(), records.end(), [](const std::pair<sTraceRecord_t, uint32_t> &a,
+                                                        const std::pair<sTraceRecord_t, uint32_t> &b) {
+        return a.first.u64TimestampNs < b.first.u64TimestampNs;
+    });
+
+    QStringList lines;
+    for (const auto &entry : records) {
+        const sTraceRecord_t &record = entry.first;
+        const char *pcName = (record.u16Event < eTraceEventsCount) ? pcTraceEventNames[record.u16Event] : "?";
+
+        lines.append(QString("[%1 us] T%2 L%3 %4: %5 %6 %7")
+                     .arg(record.u64TimestampNs / 1000)
+                     .arg(entry.second)
+                     .arg(record.u8Level)
+                     .arg(pcName)
+                     .arg(u32ToString(record.u32Arg[0]), u32ToString(record.u32Arg[1]), u32ToString(record.u32Arg[2])));
+    }
+
+    return lines;
+}
+
+void traceDumpToDebug(void) {
+    const QStringList lines = traceDump();
+
+    for (const QString &line : lines)
+        qDebug().noquote() << line;
+}
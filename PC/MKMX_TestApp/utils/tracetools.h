@@ -0,0 +1,70 @@
+#ifndef TRACETOOLS_H
+#define TRACETOOLS_H
+
+#include <QStringList>
+
+#include <stdint.h>
+
+// Compile-time trace levels, select with DEFINES += TRACE_LEVEL=n in the .pro file.
+// Calls above the selected level expand to nothing (arguments are not evaluated).
+#define TRACE_LEVEL_NONE    0
+#define TRACE_LEVEL_ERROR   1
+#define TRACE_LEVEL_INFO    2
+#define TRACE_LEVEL_DEBUG   3
+
+#ifndef TRACE_LEVEL
+    #define TRACE_LEVEL     TRACE_LEVEL_NONE
+#endif
+
+// records kept per thread, oldest ones are overwritten (must be a power of two);
+// the ring of a finished thread goes to the next new one
+#define TRACE_RING_SIZE     4096
+
+typedef enum {
+    eTraceIfaceOpened = 0,
+    eTraceIfaceClosed,
+    eTraceIfaceRxChunk,
+    eTraceIfaceTxFrame,
+    eTraceIfaceTxNoSpace,
+    eTraceIfaceTxOffline,
+    eTraceEngineFrame,
+    eTraceEngineCrcError,
+    eTraceEngineMaxPayloadError,
+    eTraceEngineInterByteTimeout,
+
+    eTraceEventsCount
+} eTraceEvent_t;
+
+// fixed-size binary record, formatted only when dumped; the dump names the ring it was found in
+// (T<n>, threads that did not run at the same time may share one)
+typedef struct {
+    uint64_t u64TimestampNs;
+    uint16_t u16Event;
+    uint8_t u8Level;
+    uint32_t u32Arg[3];
+} sTraceRecord_t;
+
+void traceRecord(uint8_t u8Level, eTraceEvent_t eEvent, uint32_t u32Arg0, uint32_t u32Arg1, uint32_t u32Arg2);
+
+QStringList traceDump(void);
+void traceDumpToDebug(void);
+
+#if TRACE_LEVEL >= TRACE_LEVEL_ERROR
+    #define TRACE_ERROR(ev, a0, a1, a2)     traceRecord(TRACE_LEVEL_ERROR, (ev), (a0), (a1), (a2))
+#else
+    #define TRACE_ERROR(ev, a0, a1, a2)     do {} while (0)
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_INFO
+    #define TRACE_INFO(ev, a0, a1, a2)      traceRecord(TRACE_LEVEL_INFO, (ev), (a0), (a1), (a2))
+#else
+    #define TRACE_INFO(ev, a0, a1, a2)      do {} while (0)
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+    #define TRACE_DEBUG(ev, a0, a1, a2)     traceRecord(TRACE_LEVEL_DEBUG, (ev), (a0), (a1), (a2))
+#else
+    #define TRACE_DEBUG(ev, a0, a1, a2)     do {} while (0)
+#endif
+
+#endif // TRACETOOLS_H